@@ -5,6 +5,7 @@
 #include <linux/kernel.h>
 #include <linux/list.h>
 #include <linux/printk.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/version.h>
@@ -16,6 +17,7 @@
 #include "kernel_compat.h"
 #include "allowlist.h"
 #include "manager.h"
+#include "event_ring.h"
 
 #define FILE_MAGIC 0x7f4b5355 // ' KSU', u32
 #define FILE_FORMAT_VERSION 3 // u32
@@ -323,6 +325,9 @@ struct root_profile *ksu_get_root_profile(uid_t uid)
 		p = list_entry(pos, struct perm_data, list);
 		if (uid == p->profile.current_uid && p->profile.allow_su) {
 			if (!p->profile.rp_config.use_default) {
+				ksu_event_record(KSU_EVENT_PROFILE_HIT, uid,
+						 task_tgid_nr(current),
+						 p->profile.rp_config.profile.uid);
 				return &p->profile.rp_config.profile;
 			}
 		}
@@ -602,3 +607,7 @@ void ksu_temp_revoke_root_once(uid_t uid)
     pr_info("pending_root: UID=%d removed and persist updated\n", uid);
 }
 #endif
+
+#ifdef CONFIG_KSU_KUNIT_TEST
+#include "tests/allowlist_test.c"
+#endif
@@ -83,6 +83,12 @@ static int ksu_sha256(const unsigned char *data, unsigned int datalen,
 }
 
 
+// Short reads mean a truncated or lying apk, never trust what is left in buf
+static bool apk_read(struct file *fp, void *buf, size_t len, loff_t *pos)
+{
+	return ksu_kernel_read_compat(fp, buf, len, pos) == len;
+}
+
 static struct dynamic_sign_key dynamic_sign = DYNAMIC_SIGN_DEFAULT_CONFIG;
 
 static bool check_dynamic_sign(struct file *fp, u32 size4, loff_t *pos, int *matched_index)
@@ -105,7 +111,8 @@ static bool check_dynamic_sign(struct file *fp, u32 size4, loff_t *pos, int *mat
 		return false;
 	}
 	
-	ksu_kernel_read_compat(fp, cert, size4, pos);
+	if (!apk_read(fp, cert, size4, pos))
+		return false;
 	
 	unsigned char digest[SHA256_DIGEST_SIZE];
 	if (ksu_sha256(cert, size4, digest) < 0) {
@@ -135,19 +142,22 @@ static bool check_block(struct file *fp, u32 *size4, loff_t *pos, u32 *offset, i
 	struct apk_sign_key sign_key;
 	bool signature_valid = false;
 
-	ksu_kernel_read_compat(fp, size4, 0x4, pos); // signer-sequence length
-	ksu_kernel_read_compat(fp, size4, 0x4, pos); // signer length
-	ksu_kernel_read_compat(fp, size4, 0x4, pos); // signed data length
+	if (!apk_read(fp, size4, 0x4, pos) || // signer-sequence length
+	    !apk_read(fp, size4, 0x4, pos) || // signer length
+	    !apk_read(fp, size4, 0x4, pos)) // signed data length
+		return false;
 
 	*offset += 0x4 * 3;
 
-	ksu_kernel_read_compat(fp, size4, 0x4, pos); // digests-sequence length
+	if (!apk_read(fp, size4, 0x4, pos)) // digests-sequence length
+		return false;
 
 	*pos += *size4;
 	*offset += 0x4 + *size4;
 
-	ksu_kernel_read_compat(fp, size4, 0x4, pos); // certificates length
-	ksu_kernel_read_compat(fp, size4, 0x4, pos); // certificate length
+	if (!apk_read(fp, size4, 0x4, pos) || // certificates length
+	    !apk_read(fp, size4, 0x4, pos)) // certificate length
+		return false;
 	*offset += 0x4 * 2;
 
 	if (ksu_is_dynamic_manager_enabled()) {
@@ -172,7 +182,8 @@ static bool check_block(struct file *fp, u32 *size4, loff_t *pos, u32 *offset, i
 			pr_info("cert length overlimit\n");
 			return false;
 		}
-		ksu_kernel_read_compat(fp, cert, *size4, pos);
+		if (!apk_read(fp, cert, *size4, pos))
+			return false;
 		unsigned char digest[SHA256_DIGEST_SIZE];
 		if (IS_ERR(ksu_sha256(cert, *size4, digest))) {
 			pr_info("sha256 error\n");
@@ -259,6 +270,7 @@ static __always_inline bool check_v2_signature(char *path, bool check_multi_mana
 	bool v3_signing_exist = false;
 	bool v3_1_signing_exist = false;
 	int matched_index = -1;
+	loff_t file_size;
 	int i;
 	struct file *fp = ksu_filp_open_compat(path, O_RDONLY, 0);
 	if (IS_ERR(fp)) {
@@ -275,37 +287,48 @@ static __always_inline bool check_v2_signature(char *path, bool check_multi_mana
 	// disable inotify for this file
 	fp->f_mode |= FMODE_NONOTIFY;
 
+	file_size = i_size_read(file_inode(fp));
+
 	// https://en.wikipedia.org/wiki/Zip_(file_format)#End_of_central_directory_record_(EOCD)
 	for (i = 0;; ++i) {
 		unsigned short n;
-		pos = generic_file_llseek(fp, -i - 2, SEEK_END);
-		ksu_kernel_read_compat(fp, &n, 2, &pos);
+		if (i == 0x10000 || i + 22 > file_size) {
+			pr_info("error: cannot find eocd\n");
+			goto clean;
+		}
+		pos = file_size - i - 2;
+		if (!apk_read(fp, &n, 2, &pos))
+			goto clean;
 		if (n == i) {
 			pos -= 22;
-			ksu_kernel_read_compat(fp, &size4, 4, &pos);
+			if (!apk_read(fp, &size4, 4, &pos))
+				goto clean;
 			if ((size4 ^ 0xcafebabeu) == 0xccfbf1eeu) {
 				break;
 			}
 		}
-		if (i == 0xffff) {
-			pr_info("error: cannot find eocd\n");
-			goto clean;
-		}
 	}
 
 	pos += 12;
 	// offset
-	ksu_kernel_read_compat(fp, &size4, 0x4, &pos);
+	if (!apk_read(fp, &size4, 0x4, &pos))
+		goto clean;
+	if (size4 < 0x18 || size4 > file_size)
+		goto clean;
 	pos = size4 - 0x18;
 
-	ksu_kernel_read_compat(fp, &size8, 0x8, &pos);
-	ksu_kernel_read_compat(fp, buffer, 0x10, &pos);
+	if (!apk_read(fp, &size8, 0x8, &pos) ||
+	    !apk_read(fp, buffer, 0x10, &pos))
+		goto clean;
 	if (strcmp((char *)buffer, "APK Sig Block 42")) {
 		goto clean;
 	}
 
+	if (size8 < 0x18 || size8 > size4 - 0x8)
+		goto clean;
 	pos = size4 - (size8 + 0x8);
-	ksu_kernel_read_compat(fp, &size_of_block, 0x8, &pos);
+	if (!apk_read(fp, &size_of_block, 0x8, &pos))
+		goto clean;
 	if (size_of_block != size8) {
 		goto clean;
 	}
@@ -314,12 +337,16 @@ static __always_inline bool check_v2_signature(char *path, bool check_multi_mana
 	while (loop_count++ < 10) {
 		uint32_t id;
 		uint32_t offset;
-		ksu_kernel_read_compat(fp, &size8, 0x8,
-				       &pos); // sequence length
+		if (!apk_read(fp, &size8, 0x8, &pos)) // sequence length
+			goto invalid;
 		if (size8 == size_of_block) {
 			break;
 		}
-		ksu_kernel_read_compat(fp, &id, 0x4, &pos); // id
+		// every pair holds at least its id, and must not reach past the block
+		if (size8 < 0x4 || size8 > size_of_block)
+			goto invalid;
+		if (!apk_read(fp, &id, 0x4, &pos)) // id
+			goto invalid;
 		offset = 4;
 		if (id == 0x7109871au) {
 			v2_signing_blocks++;
@@ -338,6 +365,8 @@ static __always_inline bool check_v2_signature(char *path, bool check_multi_mana
 			pr_info("Unknown id: 0x%08x\n", id);
 #endif
 		}
+		if (offset > size8)
+			goto invalid;
 		pos += (size8 - offset);
 	}
 
@@ -357,6 +386,10 @@ static __always_inline bool check_v2_signature(char *path, bool check_multi_mana
 			return false;
 		}
 	}
+	goto clean;
+
+invalid:
+	v2_signing_valid = false;
 clean:
 	filp_close(fp, 0);
 
@@ -419,4 +452,8 @@ bool is_manager_apk(char *path)
 bool is_dynamic_manager_apk(char *path, int *signature_index)
 {
     return check_v2_signature(path, true, signature_index);
-}
\ No newline at end of file
+}
+
+#ifdef CONFIG_KSU_KUNIT_TEST
+#include "tests/apk_sign_test.c"
+#endif
@@ -47,6 +47,8 @@
 #include "throne_comm.h"
 #include "kernel_compat.h"
 #include "dynamic_manager.h"
+#include "event_ring.h"
+#include "mount_ns.h"
 
 #ifdef CONFIG_KSU_MANUAL_SU
 #include "manual_su.h"
@@ -159,6 +161,9 @@ void escape_to_root(void)
 
 	struct root_profile *profile = ksu_get_root_profile(cred->uid.val);
 
+	ksu_event_record(KSU_EVENT_SU_GRANT, cred->uid.val,
+			 task_tgid_nr(current), profile->uid);
+
 	cred->uid.val = profile->uid;
 	cred->suid.val = profile->uid;
 	cred->euid.val = profile->uid;
@@ -196,6 +201,8 @@ void escape_to_root(void)
 	spin_unlock_irq(&current->sighand->siglock);
 
 	setup_selinux(profile->selinux_domain);
+
+	ksu_setup_mount_ns(profile->namespaces);
 }
 
 #ifdef CONFIG_KSU_MANUAL_SU
@@ -255,6 +262,9 @@ void escape_to_root_for_cmd_su(uid_t target_uid, pid_t target_pid)
 
 	struct root_profile *profile = ksu_get_root_profile(target_uid);
 
+	ksu_event_record(KSU_EVENT_SU_GRANT, target_uid, target_pid,
+			 profile->uid);
+
 	newcreds->uid.val = profile->uid;
 	newcreds->suid.val = profile->uid;
 	newcreds->euid.val = profile->uid;
@@ -473,6 +483,9 @@ skip_check:
 			if (copy_to_user(result, &reply_ok, sizeof(reply_ok))) {
 				pr_err("grant_root: prctl reply error\n");
 			}
+		} else {
+			ksu_event_record(KSU_EVENT_SU_DENY, current_uid().val,
+					 task_tgid_nr(current), 0);
 		}
 		return 0;
 	}
@@ -823,6 +836,40 @@ skip_check:
 		return 0;
 	}
 
+	if (arg2 == CMD_GET_EVENT_RING_FD) {
+		if (!from_root && !from_manager) {
+			return 0;
+		}
+
+		int fd = ksu_event_ring_get_fd();
+		if (fd < 0) {
+			pr_err("event_ring: get fd failed: %d\n", fd);
+			return 0;
+		}
+		if (copy_to_user((void __user *)arg3, &fd, sizeof(fd))) {
+			pr_err("event_ring: copy fd failed\n");
+			return 0;
+		}
+		if (copy_to_user(result, &reply_ok, sizeof(reply_ok))) {
+			pr_err("event_ring: prctl reply error\n");
+		}
+		return 0;
+	}
+
+	if (arg2 == CMD_ENTER_GLOBAL_MNT_NS) {
+		if (!from_root) {
+			return 0;
+		}
+
+		// applied when this prctl returns to userspace, so the reply
+		// only says it was queued; ksud checks where it ended up
+		ksu_setup_mount_ns(KSU_NS_GLOBAL);
+		if (copy_to_user(result, &reply_ok, sizeof(reply_ok))) {
+			pr_err("mount_ns: prctl reply error\n");
+		}
+		return 0;
+	}
+
 	// UID Scanner control command
 	if (arg2 == CMD_ENABLE_UID_SCANNER) {
 		if (arg3 == 0) {
@@ -968,6 +1015,8 @@ int ksu_handle_setuid(struct cred *new, const struct cred *old)
 	}
 
 	if (!ksu_uid_should_umount(new_uid.val)) {
+		ksu_event_record(KSU_EVENT_UMOUNT, new_uid.val,
+				 task_tgid_nr(current), 0);
 		return 0;
 	} else {
 #ifdef CONFIG_KSU_DEBUG
@@ -1001,6 +1050,9 @@ int ksu_handle_setuid(struct cred *new, const struct cred *old)
 	// try umount ksu temp path
 	try_umount("/debug_ramdisk", false, MNT_DETACH);
 
+	ksu_event_record(KSU_EVENT_UMOUNT, new_uid.val, task_tgid_nr(current),
+			 1);
+
 	return 0;
 }
 
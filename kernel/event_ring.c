@@ -0,0 +1,206 @@
+#include <linux/anon_inodes.h>
+#include <linux/cpumask.h>
+#include <linux/fs.h>
+#include <linux/irqflags.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/timekeeping.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+
+#include "event_ring.h"
+#include "klog.h" // IWYU pragma: keep
+
+#define RING_STRIDE (KSU_EVENT_RING_PAGES * PAGE_SIZE)
+#define RING_ENTRIES (RING_STRIDE / sizeof(struct ksu_event))
+#define MAX_RING_CPUS                                                          \
+	((PAGE_SIZE - sizeof(struct ksu_event_ring_header)) / sizeof(__u64))
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 16, 0)
+typedef unsigned int __poll_t;
+#define EPOLLIN POLLIN
+#define EPOLLRDNORM POLLRDNORM
+#endif
+
+static void *ring_buf __read_mostly;
+static DECLARE_WAIT_QUEUE_HEAD(ring_wait);
+
+static inline struct ksu_event_ring_header *ring_header(void)
+{
+	return ring_buf;
+}
+
+static inline struct ksu_event *cpu_ring(void *buf, int cpu)
+{
+	return buf + PAGE_SIZE + cpu * RING_STRIDE;
+}
+
+static inline u64 ring_now(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 3, 0)
+	return ktime_get_boottime_ns();
+#else
+	return ktime_get_boot_ns();
+#endif
+}
+
+// Each cpu ring has exactly one producer: the cpu itself with irqs off,
+// so publishing only needs ordering, never a lock or an atomic rmw.
+void ksu_event_record(u32 type, uid_t uid, pid_t pid, u32 data)
+{
+	struct ksu_event_ring_header *hdr;
+	struct ksu_event *ev;
+	unsigned long flags;
+	u64 pos;
+	int cpu;
+
+	// irqs off doubles as the rcu read side against ksu_event_ring_exit
+	local_irq_save(flags);
+	hdr = READ_ONCE(ring_buf);
+	if (unlikely(!hdr)) {
+		local_irq_restore(flags);
+		return;
+	}
+
+	cpu = smp_processor_id();
+	pos = hdr->head[cpu];
+	ev = &cpu_ring(hdr, cpu)[pos & (RING_ENTRIES - 1)];
+
+	WRITE_ONCE(ev->seq, 0);
+	smp_wmb();
+	ev->timestamp = ring_now();
+	ev->type = type;
+	ev->uid = uid;
+	ev->pid = pid;
+	ev->data = data;
+	smp_wmb();
+	WRITE_ONCE(ev->seq, pos + 1);
+	smp_store_release(&hdr->head[cpu], pos + 1);
+	local_irq_restore(flags);
+
+	if (wq_has_sleeper(&ring_wait))
+		wake_up_interruptible(&ring_wait);
+}
+
+static u64 ring_total(void)
+{
+	struct ksu_event_ring_header *hdr = ring_header();
+	u64 total = 0;
+	int cpu;
+
+	for (cpu = 0; cpu < hdr->nr_cpus; cpu++)
+		total += smp_load_acquire(&hdr->head[cpu]);
+
+	return total;
+}
+
+// The events themselves are read through the mapping; read() only returns
+// the total event count and marks everything up to it as seen for poll().
+static ssize_t ring_read(struct file *file, char __user *buf, size_t count,
+			 loff_t *ppos)
+{
+	u64 total = ring_total();
+
+	if (count < sizeof(total))
+		return -EINVAL;
+
+	if (copy_to_user(buf, &total, sizeof(total)))
+		return -EFAULT;
+
+	*ppos = total;
+	return sizeof(total);
+}
+
+static __poll_t ring_poll(struct file *file, poll_table *wait)
+{
+	poll_wait(file, &ring_wait, wait);
+
+	if (ring_total() != (u64)file->f_pos)
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
+static int ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+
+	return remap_vmalloc_range(vma, ring_buf, vma->vm_pgoff);
+}
+
+static const struct file_operations ring_fops = {
+	.owner = THIS_MODULE,
+	.read = ring_read,
+	.poll = ring_poll,
+	.mmap = ring_mmap,
+	.llseek = noop_llseek,
+};
+
+int ksu_event_ring_get_fd(void)
+{
+	if (!ring_buf)
+		return -ENODEV;
+
+	return anon_inode_getfd("[ksu_events]", &ring_fops, NULL,
+				O_RDONLY | O_CLOEXEC);
+}
+
+int ksu_event_ring_init(void)
+{
+	struct ksu_event_ring_header *hdr;
+	unsigned int nr_cpus = nr_cpu_ids;
+	size_t ring_size;
+
+	BUILD_BUG_ON(sizeof(struct ksu_event) != 32);
+	BUILD_BUG_ON(RING_ENTRIES & (RING_ENTRIES - 1));
+
+	if (nr_cpus > MAX_RING_CPUS) {
+		pr_err("event_ring: too many cpus: %u\n", nr_cpus);
+		return -EINVAL;
+	}
+
+	ring_size = PAGE_SIZE + nr_cpus * RING_STRIDE;
+	hdr = vmalloc_user(ring_size);
+	if (!hdr) {
+		pr_err("event_ring: alloc %zu bytes failed\n", ring_size);
+		return -ENOMEM;
+	}
+
+	hdr->magic = KSU_EVENT_RING_MAGIC;
+	hdr->version = KSU_EVENT_RING_VERSION;
+	hdr->nr_cpus = nr_cpus;
+	hdr->ring_entries = RING_ENTRIES;
+	hdr->event_size = sizeof(struct ksu_event);
+	hdr->ring_offset = PAGE_SIZE;
+	hdr->ring_stride = RING_STRIDE;
+
+	smp_store_release(&ring_buf, hdr);
+	pr_info("event_ring: %u cpus, %lu events per cpu\n", nr_cpus,
+		(unsigned long)RING_ENTRIES);
+	return 0;
+}
+
+void ksu_event_ring_exit(void)
+{
+	void *buf = ring_buf;
+
+	WRITE_ONCE(ring_buf, NULL);
+	synchronize_rcu();
+	// mappings keep their own page references
+	vfree(buf);
+}
+
+#ifdef CONFIG_KSU_KUNIT_TEST
+#include "tests/event_ring_test.c"
+#endif
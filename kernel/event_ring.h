@@ -0,0 +1,70 @@
+#ifndef __KSU_H_EVENT_RING
+#define __KSU_H_EVENT_RING
+
+#include <linux/types.h>
+
+#define KSU_EVENT_RING_MAGIC 0x4b534556 // 'KSEV', u32
+#define KSU_EVENT_RING_VERSION 1
+// pages per cpu ring, must be a power of two
+#define KSU_EVENT_RING_PAGES 2
+
+#define KSU_EVENT_SU_GRANT 1
+#define KSU_EVENT_SU_DENY 2
+#define KSU_EVENT_PROFILE_HIT 3
+#define KSU_EVENT_UMOUNT 4
+
+// Fixed-size record, shared with userspace through mmap.
+// A slot is valid only if seq equals its position + 1 both before and after
+// it has been copied out, otherwise the producer overwrote it meanwhile.
+struct ksu_event {
+	__u64 seq;
+	__u64 timestamp; // CLOCK_BOOTTIME, ns
+	__u32 type;
+	__u32 uid;
+	__u32 pid;
+	__u32 data; // target uid for grants and profile hits, 1 if umounted
+};
+
+// First page of the mapping, followed by nr_cpus rings of ring_stride bytes.
+// head[cpu] counts the events ever written to that cpu's ring.
+struct ksu_event_ring_header {
+	__u32 magic;
+	__u32 version;
+	__u32 nr_cpus;
+	__u32 ring_entries;
+	__u32 event_size;
+	__u32 ring_offset;
+	__u32 ring_stride;
+	__u32 reserved;
+	__u64 head[];
+};
+
+#ifdef CONFIG_KSU_EVENT_RING
+int ksu_event_ring_init(void);
+
+void ksu_event_ring_exit(void);
+
+void ksu_event_record(u32 type, uid_t uid, pid_t pid, u32 data);
+
+int ksu_event_ring_get_fd(void);
+#else
+static inline int ksu_event_ring_init(void)
+{
+	return 0;
+}
+
+static inline void ksu_event_ring_exit(void)
+{
+}
+
+static inline void ksu_event_record(u32 type, uid_t uid, pid_t pid, u32 data)
+{
+}
+
+static inline int ksu_event_ring_get_fd(void)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+#endif
@@ -154,6 +154,52 @@ noinline NO_OPTIMIZE void sukisu_kpm_version(void __user *out, unsigned int buff
 }
 EXPORT_SYMBOL(sukisu_kpm_version);
 
+static int sukisu_kpm_load_batch(struct sukisu_kpm_load_entry __user *entries,
+                unsigned int count)
+{
+    char kernel_load_path[256];
+    char kernel_args_buffer[256];
+    struct sukisu_kpm_load_entry entry;
+    unsigned int i;
+    int loaded = 0;
+
+    if (count == 0 || count > SUKISU_KPM_LOAD_BATCH_MAX)
+        return -EINVAL;
+
+    for (i = 0; i < count; i++) {
+        int res = -EINVAL;
+
+        if (copy_from_user(&entry, &entries[i], sizeof(entry)))
+            return -EFAULT;
+
+        memset(kernel_load_path, 0, sizeof(kernel_load_path));
+        memset(kernel_args_buffer, 0, sizeof(kernel_args_buffer));
+
+        if (entry.path == 0 ||
+            strncpy_from_user(kernel_load_path,
+                    (const char __user *)(uintptr_t)entry.path, 255) <= 0) {
+            if (copy_to_user(&entries[i].result, &res, sizeof(res)))
+                return -EFAULT;
+            continue;
+        }
+
+        if (entry.args != 0)
+            strncpy_from_user(kernel_args_buffer,
+                    (const char __user *)(uintptr_t)entry.args, 255);
+
+        sukisu_kpm_load_module_path((const char *)&kernel_load_path,
+                        (const char *)&kernel_args_buffer, NULL,
+                        (void __user *)&entries[i].result);
+
+        if (get_user(res, &entries[i].result))
+            return -EFAULT;
+        if (res >= 0)
+            loaded++;
+    }
+
+    return loaded;
+}
+
 noinline int sukisu_handle_kpm(unsigned long arg2, unsigned long arg3, unsigned long arg4,
                 unsigned long arg5)
 {
@@ -199,6 +245,17 @@ noinline int sukisu_handle_kpm(unsigned long arg2, unsigned long arg3, unsigned
         sukisu_kpm_control((char __user *)arg3, (char __user *)arg4, (void __user *)arg5);
     } else if (arg2 == SUKISU_KPM_VERSION) {
         sukisu_kpm_version((char __user *)arg3, (unsigned int)arg4, (void __user *)arg5);
+    } else if (arg2 == SUKISU_KPM_LOAD_BATCH) {
+        int res;
+
+        if (arg3 == 0)
+            return -1;
+
+        res = sukisu_kpm_load_batch((struct sukisu_kpm_load_entry __user *)arg3,
+                        (unsigned int)arg4);
+
+        if (copy_to_user((void __user *)arg5, &res, sizeof(res)))
+            printk("KPM: Copy to user failed.");
     }
     
     return 0;
@@ -1,6 +1,8 @@
 #ifndef __SUKISU_KPM_H
 #define __SUKISU_KPM_H
 
+#include <linux/types.h>
+
 extern int sukisu_handle_kpm(unsigned long arg2, unsigned long arg3, unsigned long arg4,
                 unsigned long arg5);
 extern int sukisu_is_kpm_control_code(unsigned long arg2);
@@ -55,4 +57,20 @@ extern int sukisu_is_kpm_control_code(unsigned long arg2);
  */
 #define SUKISU_KPM_VERSION 34
 
+/*
+ * prctl(xxx, 35, struct sukisu_kpm_load_entry[], count)
+ * every entry receives its own load result
+ * success return number of loaded modules, error return -N
+ */
+#define SUKISU_KPM_LOAD_BATCH 35
+
+#define SUKISU_KPM_LOAD_BATCH_MAX 64
+
+struct sukisu_kpm_load_entry {
+    __u64 path; /* const char __user * */
+    __u64 args; /* const char __user *, 0 for none */
+    __s32 result;
+    __u32 reserved;
+};
+
 #endif
@@ -7,8 +7,10 @@
 #include "allowlist.h"
 #include "arch.h"
 #include "core_hook.h"
+#include "event_ring.h"
 #include "klog.h" // IWYU pragma: keep
 #include "ksu.h"
+#include "mount_ns.h"
 #include "throne_tracker.h"
 
 static struct workqueue_struct *ksu_workqueue;
@@ -44,6 +46,8 @@ int __init kernelsu_init(void)
 
 	ksu_core_init();
 
+	ksu_event_ring_init();
+
 	ksu_workqueue = alloc_ordered_workqueue("kernelsu_work_queue", 0);
 
 	ksu_allowlist_init();
@@ -86,6 +90,10 @@ void kernelsu_exit(void)
 #endif
 
 	ksu_core_exit();
+
+	ksu_event_ring_exit();
+
+	ksu_mount_ns_exit();
 }
 
 module_init(kernelsu_init);
@@ -36,6 +36,8 @@
 #define CMD_DYNAMIC_MANAGER 103
 #define CMD_GET_MANAGERS 104
 #define CMD_ENABLE_UID_SCANNER 105
+#define CMD_GET_EVENT_RING_FD 106
+#define CMD_ENTER_GLOBAL_MNT_NS 107
 
 #define EVENT_POST_FS_DATA 1
 #define EVENT_BOOT_COMPLETED 2
@@ -18,6 +18,7 @@
 #include "klog.h" // IWYU pragma: keep
 #include "ksud.h"
 #include "kernel_compat.h"
+#include "mount_ns.h"
 #include "selinux/selinux.h"
 
 
@@ -79,6 +80,8 @@ void on_post_fs_data(void)
 	ksu_devpts_sid = ksu_get_devpts_sid();
 	pr_info("devpts sid: %d\n", ksu_devpts_sid);
 
+	ksu_mount_ns_init();
+
 	// End of boot state
     is_boot_phase = false;
 }
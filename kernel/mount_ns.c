@@ -0,0 +1,214 @@
+#include <linux/fdtable.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/mount.h>
+#include <linux/namei.h>
+#include <linux/sched.h>
+#include <linux/sched/task.h>
+#include <linux/slab.h>
+#include <linux/syscalls.h>
+#include <linux/task_work.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+
+#include "arch.h"
+#include "kernel_compat.h"
+#include "klog.h" // IWYU pragma: keep
+#include "mount_ns.h"
+
+// init's mount namespace, held open from post-fs-data on so root shells
+// never have to look it up in procfs. Holding the file also keeps the
+// namespace valid across init re-execs.
+static struct file *global_mnt_ns __read_mostly;
+
+struct mount_ns_work {
+	struct callback_head cb;
+	int32_t ns;
+};
+
+#ifdef CONFIG_ARCH_HAS_SYSCALL_WRAPPER
+asmlinkage long SYS_SETNS_FN(const struct pt_regs *regs);
+
+static long ksu_sys_setns(int fd, int nstype)
+{
+	struct pt_regs regs;
+
+	memset(&regs, 0, sizeof(regs));
+	PT_REGS_PARM1(&regs) = fd;
+	PT_REGS_PARM2(&regs) = nstype;
+	return SYS_SETNS_FN(&regs);
+}
+#else
+static long ksu_sys_setns(int fd, int nstype)
+{
+	return sys_setns(fd, nstype);
+}
+#endif
+
+static long ksu_sys_unshare(unsigned long flags)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 17, 0)
+	return ksys_unshare(flags);
+#else
+	return sys_unshare(flags);
+#endif
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+// fs/internal.h, not in a public header
+extern int path_mount(const char *dev_name, struct path *path,
+		      const char *type_page, unsigned long flags,
+		      void *data_page);
+#endif
+
+// The unshared namespace copies the shared propagation of the app that
+// called su. Make it a slave of that so mounts from outside still show up
+// but the shell's own mounts stay in it.
+static long ksu_make_rslave_root(void)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	struct path root;
+	long ret = kern_path("/", 0, &root);
+
+	if (ret)
+		return ret;
+	ret = path_mount(NULL, &root, NULL, MS_SLAVE | MS_REC, NULL);
+	path_put(&root);
+	return ret;
+#else
+	mm_segment_t old_fs = get_fs();
+	long ret;
+
+	set_fs(KERNEL_DS);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 17, 0)
+	ret = ksys_mount(NULL, (char __user *)"/", NULL, MS_SLAVE | MS_REC,
+			 NULL);
+#else
+	ret = sys_mount(NULL, (char __user *)"/", NULL, MS_SLAVE | MS_REC,
+			NULL);
+#endif
+	set_fs(old_fs);
+	return ret;
+#endif
+}
+
+static void ksu_close_fd(int fd)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+	close_fd(fd);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(4, 17, 0)
+	ksys_close(fd);
+#else
+	sys_close(fd);
+#endif
+}
+
+static struct file *open_global_mnt_ns(void)
+{
+	struct file *fp = READ_ONCE(global_mnt_ns);
+
+	if (fp) {
+		get_file(fp);
+		return fp;
+	}
+	// before post-fs-data: fall back to a lookup for this one shell
+	return ksu_filp_open_compat("/proc/1/ns/mnt", O_RDONLY, 0);
+}
+
+static void enter_global_mnt_ns(void)
+{
+	struct file *fp = open_global_mnt_ns();
+	int fd;
+	long ret;
+
+	if (IS_ERR(fp)) {
+		pr_err("mount_ns: open global mnt ns failed: %ld\n",
+		       PTR_ERR(fp));
+		return;
+	}
+
+	// setns only takes an fd, lend it one for the duration of the call
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0) {
+		fput(fp);
+		pr_err("mount_ns: no fd for global mnt ns: %d\n", fd);
+		return;
+	}
+	fd_install(fd, fp);
+	ret = ksu_sys_setns(fd, CLONE_NEWNS);
+	ksu_close_fd(fd);
+	if (ret)
+		pr_warn("mount_ns: setns global failed: %ld\n", ret);
+}
+
+static void mount_ns_callback(struct callback_head *cb)
+{
+	struct mount_ns_work *work = container_of(cb, struct mount_ns_work, cb);
+	long ret;
+
+	switch (work->ns) {
+	case KSU_NS_GLOBAL:
+		enter_global_mnt_ns();
+		break;
+	case KSU_NS_INDIVIDUAL:
+		ret = ksu_sys_unshare(CLONE_NEWNS);
+		if (ret) {
+			pr_warn("mount_ns: unshare failed: %ld\n", ret);
+			break;
+		}
+		ret = ksu_make_rslave_root();
+		if (ret)
+			pr_warn("mount_ns: make / rslave failed: %ld\n", ret);
+		break;
+	}
+	kfree(work);
+}
+
+void ksu_setup_mount_ns(int32_t ns)
+{
+	struct mount_ns_work *work;
+
+	if (ns != KSU_NS_GLOBAL && ns != KSU_NS_INDIVIDUAL)
+		return;
+
+	work = kmalloc(sizeof(*work), GFP_ATOMIC);
+	if (!work) {
+		pr_err("mount_ns: alloc work failed\n");
+		return;
+	}
+	init_task_work(&work->cb, mount_ns_callback);
+	work->ns = ns;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+	if (task_work_add(current, &work->cb, TWA_RESUME)) {
+#else
+	if (task_work_add(current, &work->cb, true)) {
+#endif
+		kfree(work);
+		pr_warn("mount_ns: task_work_add failed\n");
+	}
+}
+
+void ksu_mount_ns_init(void)
+{
+	struct file *fp;
+
+	if (global_mnt_ns)
+		return;
+
+	fp = ksu_filp_open_compat("/proc/1/ns/mnt", O_RDONLY, 0);
+	if (IS_ERR(fp)) {
+		pr_err("mount_ns: pin global mnt ns failed: %ld\n",
+		       PTR_ERR(fp));
+		return;
+	}
+	WRITE_ONCE(global_mnt_ns, fp);
+	pr_info("mount_ns: global mnt ns pinned\n");
+}
+
+void ksu_mount_ns_exit(void)
+{
+	struct file *fp = xchg(&global_mnt_ns, NULL);
+
+	if (fp)
+		fput(fp);
+}
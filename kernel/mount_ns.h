@@ -0,0 +1,19 @@
+#ifndef __KSU_H_MOUNT_NS
+#define __KSU_H_MOUNT_NS
+
+#include <linux/types.h>
+
+// root_profile.namespaces, same order as Natives.Profile.Namespace
+#define KSU_NS_INHERITED 0
+#define KSU_NS_GLOBAL 1
+#define KSU_NS_INDIVIDUAL 2
+
+// Pin init's mount namespace, called once at post-fs-data.
+void ksu_mount_ns_init(void);
+void ksu_mount_ns_exit(void);
+
+// Move current into the namespace picked by a root profile. The switch
+// happens on the way back to userspace, where setns/unshare are legal.
+void ksu_setup_mount_ns(int32_t ns);
+
+#endif
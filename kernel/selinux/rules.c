@@ -1,6 +1,10 @@
+#include <linux/kernel.h>
 #include <linux/uaccess.h>
 #include <linux/types.h>
 #include <linux/version.h>
+#include <linux/rcupdate.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include "../klog.h" // IWYU pragma: keep
 #include "selinux.h"
@@ -14,8 +18,16 @@
 #define KERNEL_SU_DOMAIN "su"
 #define KERNEL_SU_FILE "ksu_file"
 #define KERNEL_EXEC_TYPE "ksu_exec"
+#define KERNEL_SU_SOCKET "ksud_socket"
 #define ALL NULL
 
+// domains the manager app may run in, missing ones are skipped
+static const char *ksu_manager_domains[] = {
+	"untrusted_app_all",
+	"untrusted_app",
+	"untrusted_app_25",
+};
+
 static struct policydb *get_policydb(void)
 {
 	struct policydb *db;
@@ -26,9 +38,68 @@ static struct policydb *get_policydb(void)
 
 static DEFINE_MUTEX(ksu_rules);
 
+// Our rules are inserted into the live te_avtab, which is never resized, so
+// after a large batch the hash chains every AVC miss walks get long. Rebuild
+// the table with one to two nodes per bucket, and publish it the
+// way security_set_bools() publishes boolean changes: through a copy of
+// selinux_policy, so readers always see a consistent htable/mask pair.
+static void ksu_avtab_rehash_work_fn(struct work_struct *work)
+{
+	struct selinux_policy *oldpolicy, *newpolicy;
+	struct avtab newtab;
+
+	mutex_lock(&ksu_rules);
+	mutex_lock(&selinux_state.policy_mutex);
+
+	oldpolicy = rcu_dereference_protected(
+		selinux_state.policy,
+		lockdep_is_held(&selinux_state.policy_mutex));
+	if (!oldpolicy ||
+	    !ksu_avtab_need_rehash(&oldpolicy->policydb.te_avtab))
+		goto out;
+
+	ksu_avtab_stats(&oldpolicy->policydb.te_avtab, "before rehash");
+
+	newpolicy = kmemdup(oldpolicy, sizeof(*newpolicy), GFP_KERNEL);
+	if (!newpolicy) {
+		pr_err("avtab rehash: alloc policy failed\n");
+		goto out;
+	}
+
+	if (ksu_avtab_rebuild(&newtab, &oldpolicy->policydb.te_avtab)) {
+		pr_err("avtab rehash: rebuild failed\n");
+		kfree(newpolicy);
+		goto out;
+	}
+	newpolicy->policydb.te_avtab = newtab;
+
+	rcu_assign_pointer(selinux_state.policy, newpolicy);
+	synchronize_rcu();
+
+	// everything but te_avtab is shared with newpolicy
+	avtab_destroy(&oldpolicy->policydb.te_avtab);
+	kfree(oldpolicy);
+
+	ksu_avtab_stats(&newpolicy->policydb.te_avtab, "after rehash");
+
+out:
+	mutex_unlock(&selinux_state.policy_mutex);
+	mutex_unlock(&ksu_rules);
+}
+
+static DECLARE_WORK(ksu_avtab_rehash_work, ksu_avtab_rehash_work_fn);
+
+// may be called from atomic context, the rebuild itself is deferred
+static void ksu_avtab_maybe_rehash(struct policydb *db)
+{
+	if (ksu_avtab_can_grow(&db->te_avtab))
+		schedule_work(&ksu_avtab_rehash_work);
+}
+
 void apply_kernelsu_rules()
 {
 	struct policydb *db;
+	int i;
 
 	if (!getenforce()) {
 		pr_info("SELinux permissive or disabled, apply rules!\n");
@@ -38,6 +109,8 @@ void apply_kernelsu_rules()
 
 	db = get_policydb();
 
+	ksu_avtab_stats(&db->te_avtab, "before ksu rules");
+
 	ksu_permissive(db, KERNEL_SU_DOMAIN);
 	ksu_typeattribute(db, KERNEL_SU_DOMAIN, "mlstrustedsubject");
 	ksu_typeattribute(db, KERNEL_SU_DOMAIN, "netdomain");
@@ -48,6 +121,10 @@ void apply_kernelsu_rules()
 	ksu_typeattribute(db, KERNEL_SU_FILE, "mlstrustedobject");
 	ksu_allow(db, ALL, KERNEL_SU_FILE, ALL, ALL);
 
+	// The ksud daemon labels its rpc socket with this, so the manager
+	// can be let in there and nowhere else in su
+	ksu_type(db, KERNEL_SU_SOCKET, "mlstrustedobject");
+
 	// allow all!
 	ksu_allow(db, KERNEL_SU_DOMAIN, ALL, ALL, ALL);
 
@@ -84,6 +161,17 @@ void apply_kernelsu_rules()
 	ksu_allow(db, "init", "adb_data_file", "file", ALL);
 	ksu_allow(db, "init", "adb_data_file", "dir", ALL); // #1289
 	ksu_allow(db, "init", KERNEL_SU_DOMAIN, ALL, ALL);
+	// the manager talks to the ksud daemon, which checks the peer uid and
+	// context too, and reads WebUI files through the fds it hands out;
+	// untrusted_app_all only exists since Android 9
+	for (i = 0; i < ARRAY_SIZE(ksu_manager_domains); i++) {
+		ksu_allow(db, ksu_manager_domains[i], KERNEL_SU_SOCKET,
+			  "unix_stream_socket", "connectto");
+		ksu_allow(db, ksu_manager_domains[i], "adb_data_file", "file",
+			  "read");
+		ksu_allow(db, ksu_manager_domains[i], "adb_data_file", "file",
+			  "getattr");
+	}
 	// we need to umount modules in zygote
 	ksu_allow(db, "zygote", "adb_data_file", "dir", "search");
 
@@ -130,6 +218,9 @@ void apply_kernelsu_rules()
 	// https://android-review.googlesource.com/c/platform/system/logging/+/3725346
 	ksu_dontaudit(db, "untrusted_app", KERNEL_SU_DOMAIN, "dir", "getattr");
 
+	ksu_avtab_stats(&db->te_avtab, "after ksu rules");
+	ksu_avtab_maybe_rehash(db);
+
 	mutex_unlock(&ksu_rules);
 }
 
@@ -535,6 +626,7 @@ int handle_sepolicy(unsigned long arg3, void __user *arg4)
 	}
 
 exit:
+	ksu_avtab_maybe_rehash(db);
 	mutex_unlock(&ksu_rules);
 
 	// only allow and xallow needs to reset avc cache, but we cannot do that because
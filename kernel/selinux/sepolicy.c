@@ -1,4 +1,5 @@
 #include <linux/gfp.h>
+#include <linux/kernel.h>
 #include <linux/printk.h>
 #include <linux/slab.h>
 #include <linux/version.h>
@@ -251,7 +252,16 @@ static void add_rule_raw(struct policydb *db, struct type_datum *src,
 		key.target_class = cls->value;
 		key.specified = effect;
 
-		struct avtab_node *node = get_avtab_node(db, &key, NULL);
+		struct avtab_node *node;
+		if (strip_av(effect, invert)) {
+			// stripping from a rule that does not exist is a no-op, don't
+			// grow the avtab with empty nodes (wildcards hit every type here)
+			node = avtab_search_node(&db->te_avtab, &key);
+			if (!node)
+				return;
+		} else {
+			node = get_avtab_node(db, &key, NULL);
+		}
 		if (invert) {
 			if (perm)
 				node->datum.u.data &=
@@ -743,6 +753,107 @@ static bool add_typeattribute(struct policydb *db, const char *type,
 	return true;
 }
 
+#ifndef MAX_AVTAB_HASH_BUCKETS
+#define MAX_AVTAB_HASH_BUCKETS (1 << 16)
+#endif
+
+// rebuild te_avtab once a lookup may walk this many nodes
+#define KSU_AVTAB_MAX_CHAIN 16
+// avtab_alloc() leaves 4 to 8 nodes per bucket for nrules, a rebuild asks for
+// this many times the element count to get 1 to 2
+#define KSU_AVTAB_REBUILD_SCALE 4
+
+// the bucket count avtab_alloc() picks for nrules
+static u32 ksu_avtab_slots(u32 nrules)
+{
+	u32 shift = 0;
+
+	if (!nrules)
+		return 0;
+	while (nrules) {
+		nrules >>= 1;
+		shift++;
+	}
+	if (shift > 2)
+		shift -= 2;
+	return min_t(u32, 1U << shift, MAX_AVTAB_HASH_BUCKETS);
+}
+
+static u32 ksu_avtab_max_chain(struct avtab *h, u32 *used, u64 *sum_chain2)
+{
+	u32 i, max_chain = 0;
+	struct avtab_node *cur;
+
+	for (i = 0; i < h->nslot; i++) {
+		u32 chain = 0;
+		for (cur = h->htable[i]; cur; cur = cur->next)
+			chain++;
+		if (chain) {
+			(*used)++;
+			*sum_chain2 += (u64)chain * chain;
+			if (chain > max_chain)
+				max_chain = chain;
+		}
+	}
+	return max_chain;
+}
+
+void ksu_avtab_stats(struct avtab *h, const char *tag)
+{
+	u32 used = 0, max_chain;
+	u64 sum_chain2 = 0;
+
+	if (!h->htable)
+		return;
+
+	max_chain = ksu_avtab_max_chain(h, &used, &sum_chain2);
+	pr_info("avtab %s: %u entries, %u/%u buckets used, longest chain %u, sum of chain length^2 %llu\n",
+		tag, h->nel, used, h->nslot, max_chain, sum_chain2);
+}
+
+// Cheap enough for atomic context: whether a rebuild would get more buckets.
+bool ksu_avtab_can_grow(struct avtab *h)
+{
+	return h->htable && h->nslot < MAX_AVTAB_HASH_BUCKETS &&
+	       ksu_avtab_slots(h->nel * KSU_AVTAB_REBUILD_SCALE) > h->nslot;
+}
+
+// Walks the whole table, call it from process context.
+bool ksu_avtab_need_rehash(struct avtab *h)
+{
+	u32 used = 0;
+	u64 sum_chain2 = 0;
+
+	return ksu_avtab_can_grow(h) &&
+	       ksu_avtab_max_chain(h, &used, &sum_chain2) >=
+		       KSU_AVTAB_MAX_CHAIN;
+}
+
+int ksu_avtab_rebuild(struct avtab *new, struct avtab *orig)
+{
+	struct avtab_node *cur;
+	u32 i;
+	int ret;
+
+	avtab_init(new);
+	ret = avtab_alloc(new, orig->nel * KSU_AVTAB_REBUILD_SCALE);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < orig->nslot; i++) {
+		for (cur = orig->htable[i]; cur; cur = cur->next) {
+			// copies the datum, including xperms
+			if (!avtab_insert_nonunique(new, &cur->key,
+						    &cur->datum)) {
+				avtab_destroy(new);
+				return -ENOMEM;
+			}
+		}
+	}
+
+	return 0;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 // Operation on types
@@ -851,3 +962,7 @@ bool ksu_genfscon(struct policydb *db, const char *fs_name, const char *path,
 {
 	return add_genfscon(db, fs_name, path, ctx);
 }
+
+#ifdef CONFIG_KSU_KUNIT_TEST
+#include "../tests/sepolicy_test.c"
+#endif
@@ -43,4 +43,10 @@ bool ksu_type_member(struct policydb *db, const char *src, const char *tgt,
 bool ksu_genfscon(struct policydb *db, const char *fs_name, const char *path,
 		  const char *ctx);
 
+// Hash table maintenance for bulk insertion
+void ksu_avtab_stats(struct avtab *h, const char *tag);
+bool ksu_avtab_can_grow(struct avtab *h);
+bool ksu_avtab_need_rehash(struct avtab *h);
+int ksu_avtab_rebuild(struct avtab *new, struct avtab *orig);
+
 #endif
@@ -15,6 +15,7 @@
 #include "arch.h"
 #include "klog.h" // IWYU pragma: keep
 #include "ksud.h"
+#include "event_ring.h"
 #include "kernel_compat.h"
 
 #define SU_PATH "/system/bin/su"
@@ -152,8 +153,11 @@ int ksu_handle_execveat_sucompat(int *fd, struct filename **filename_ptr,
 	if (likely(memcmp(filename->name, su, sizeof(su))))
 		return 0;
 
-	if (!ksu_is_allow_uid(current_uid().val))
+	if (!ksu_is_allow_uid(current_uid().val)) {
+		ksu_event_record(KSU_EVENT_SU_DENY, current_uid().val,
+				 task_tgid_nr(current), 0);
 		return 0;
+	}
 
 	pr_info("do_execveat_common su found\n");
 	memcpy((void *)filename->name, sh, sizeof(sh));
@@ -184,8 +188,11 @@ int ksu_handle_execve_sucompat(int *fd, const char __user **filename_user,
 	if (likely(memcmp(path, su, sizeof(su))))
 		return 0;
 
-	if (!ksu_is_allow_uid(current_uid().val))
+	if (!ksu_is_allow_uid(current_uid().val)) {
+		ksu_event_record(KSU_EVENT_SU_DENY, current_uid().val,
+				 task_tgid_nr(current), 0);
 		return 0;
+	}
 
 	pr_info("sys_execve su found\n");
 	*filename_user = ksud_user_path();
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0
+// Included from allowlist.c when CONFIG_KSU_KUNIT_TEST is set.
+
+#include "ksu_test.h"
+
+// app uids no real package uses while the suite runs
+#define TEST_UID_BASE 10500
+#define TEST_UID_HIGH (BITMAP_UID_MAX + 1000)
+
+static void test_fill_profile(struct app_profile *profile, uid_t uid,
+			      bool allow)
+{
+	memset(profile, 0, sizeof(*profile));
+	profile->version = KSU_APP_PROFILE_VER;
+	profile->allow_su = allow;
+	profile->current_uid = uid;
+	snprintf(profile->key, sizeof(profile->key), "ksu.test.u%u", uid);
+	strcpy(profile->rp_config.profile.selinux_domain,
+	       KSU_DEFAULT_SELINUX_DOMAIN);
+}
+
+static bool test_set(uid_t uid, bool allow)
+{
+	struct app_profile profile;
+
+	test_fill_profile(&profile, uid, allow);
+	return ksu_set_app_profile(&profile, false);
+}
+
+static bool test_keep_uid(uid_t uid, char *package, void *data)
+{
+	uid_t *range = data;
+
+	return uid < range[0] || uid >= range[1];
+}
+
+// drop every profile in [from, to)
+static void test_prune_range(uid_t from, uid_t to)
+{
+	uid_t range[2] = { from, to };
+
+	ksu_prune_allowlist(test_keep_uid, range);
+}
+
+static void ksu_test_is_allow_uid(struct kunit *test)
+{
+	KUNIT_ASSERT_TRUE(test, test_set(TEST_UID_BASE, true));
+	KUNIT_EXPECT_TRUE(test, __ksu_is_allow_uid(TEST_UID_BASE));
+	KUNIT_EXPECT_FALSE(test, __ksu_is_allow_uid(TEST_UID_BASE + 1));
+
+	KUNIT_ASSERT_TRUE(test, test_set(TEST_UID_BASE, false));
+	KUNIT_EXPECT_FALSE(test, __ksu_is_allow_uid(TEST_UID_BASE));
+
+	// uids past the bitmap live in allow_list_arr
+	KUNIT_ASSERT_TRUE(test, test_set(TEST_UID_HIGH, true));
+	KUNIT_EXPECT_TRUE(test, __ksu_is_allow_uid(TEST_UID_HIGH));
+	KUNIT_ASSERT_TRUE(test, test_set(TEST_UID_HIGH, false));
+	KUNIT_EXPECT_FALSE(test, __ksu_is_allow_uid(TEST_UID_HIGH));
+
+	// system uids never get su, whatever the list says
+	KUNIT_EXPECT_FALSE(test, __ksu_is_allow_uid(1001));
+
+	test_prune_range(TEST_UID_BASE, TEST_UID_BASE + 1);
+	test_prune_range(TEST_UID_HIGH, TEST_UID_HIGH + 1);
+}
+
+static void ksu_test_profile_roundtrip(struct kunit *test)
+{
+	struct app_profile in, out = { .current_uid = TEST_UID_BASE };
+
+	test_fill_profile(&in, TEST_UID_BASE, true);
+	in.rp_config.use_default = false;
+	in.rp_config.profile.uid = 2000;
+	in.rp_config.profile.gid = 2000;
+	in.rp_config.profile.groups_count = 1;
+	in.rp_config.profile.groups[0] = 3003;
+	KUNIT_ASSERT_TRUE(test, ksu_set_app_profile(&in, false));
+
+	KUNIT_ASSERT_TRUE(test, ksu_get_app_profile(&out));
+	KUNIT_EXPECT_STREQ(test, out.key, in.key);
+	KUNIT_EXPECT_EQ(test, out.rp_config.profile.uid, 2000);
+	KUNIT_EXPECT_EQ(test, out.rp_config.profile.groups[0], 3003);
+	KUNIT_EXPECT_EQ(test, ksu_get_root_profile(TEST_UID_BASE)->gid, 2000);
+
+	// an empty domain is refused
+	in.rp_config.profile.selinux_domain[0] = '\0';
+	KUNIT_EXPECT_FALSE(test, ksu_set_app_profile(&in, false));
+
+	test_prune_range(TEST_UID_BASE, TEST_UID_BASE + 1);
+	out.current_uid = TEST_UID_BASE;
+	KUNIT_EXPECT_FALSE(test, ksu_get_app_profile(&out));
+}
+
+static void ksu_test_prune(struct kunit *test)
+{
+	uid_t uid;
+
+	for (uid = TEST_UID_BASE; uid < TEST_UID_BASE + 16; uid++)
+		KUNIT_ASSERT_TRUE(test, test_set(uid, true));
+
+	// prune the lower half only
+	test_prune_range(TEST_UID_BASE, TEST_UID_BASE + 8);
+	for (uid = TEST_UID_BASE; uid < TEST_UID_BASE + 8; uid++)
+		KUNIT_EXPECT_FALSE(test, __ksu_is_allow_uid(uid));
+	for (; uid < TEST_UID_BASE + 16; uid++)
+		KUNIT_EXPECT_TRUE(test, __ksu_is_allow_uid(uid));
+
+	test_prune_range(TEST_UID_BASE, TEST_UID_BASE + 16);
+	for (uid = TEST_UID_BASE; uid < TEST_UID_BASE + 16; uid++)
+		KUNIT_EXPECT_FALSE(test, __ksu_is_allow_uid(uid));
+}
+
+// set, get and check n profiles, timing each
+static void test_bench_profiles(struct kunit *test, int n)
+{
+	struct app_profile profile;
+	char name[32];
+	uid_t uid;
+
+	snprintf(name, sizeof(name), "set_app_profile/%d", n);
+	uid = TEST_UID_BASE;
+	KSU_BENCH(test, name, n, test_set(uid++, true));
+
+	// the last profile sits at the tail of the list, the worst case
+	snprintf(name, sizeof(name), "get_app_profile/%d", n);
+	KSU_BENCH(test, name, 1000, {
+		profile.current_uid = TEST_UID_BASE + n - 1;
+		ksu_get_app_profile(&profile);
+	});
+
+	snprintf(name, sizeof(name), "is_allow_uid/%d", n);
+	uid = TEST_UID_BASE;
+	KSU_BENCH(test, name, 100000,
+		  __ksu_is_allow_uid(TEST_UID_BASE + (uid++ % n)));
+
+	snprintf(name, sizeof(name), "uid_should_umount/%d", n);
+	KSU_BENCH(test, name, 1000, ksu_uid_should_umount(TEST_UID_BASE + n));
+
+	snprintf(name, sizeof(name), "prune_allowlist/%d", n);
+	KSU_BENCH(test, name, 1,
+		  test_prune_range(TEST_UID_BASE, TEST_UID_BASE + n));
+}
+
+static void ksu_test_bench(struct kunit *test)
+{
+	test_bench_profiles(test, 10);
+	test_bench_profiles(test, 100);
+	test_bench_profiles(test, 1000);
+}
+
+static struct kunit_case ksu_allowlist_test_cases[] = {
+	KUNIT_CASE(ksu_test_is_allow_uid),
+	KUNIT_CASE(ksu_test_profile_roundtrip),
+	KUNIT_CASE(ksu_test_prune),
+	KUNIT_CASE(ksu_test_bench),
+	{}
+};
+
+static struct kunit_suite ksu_allowlist_test_suite = {
+	.name = "ksu_allowlist",
+	.test_cases = ksu_allowlist_test_cases,
+};
+
+kunit_test_suites(&ksu_allowlist_test_suite);
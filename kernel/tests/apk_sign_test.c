@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-2.0
+// Included from apk_sign.c when CONFIG_KSU_KUNIT_TEST is set.
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+
+#include "ksu_test.h"
+
+// fixtures are written to the rootfs the kunit kernel boots with
+#define TEST_APK_PATH "/ksu_apk_sign_test.apk"
+#define TEST_CERT_SIZE 0x100
+#define TEST_APK_MAX 4096
+
+#define TEST_ZIP_LOCAL_MAGIC 0x04034b50u
+#define TEST_ZIP_EOCD_MAGIC 0x06054b50u
+#define TEST_V2_BLOCK_ID 0x7109871au
+#define TEST_V3_BLOCK_ID 0xf05368c0u
+
+struct test_apk_opts {
+	int v2_blocks;
+	bool v3_block;
+	bool v1_manifest;
+};
+
+struct test_apk_ctx {
+	struct dynamic_manager_user_config saved;
+	bool had_config;
+	u8 cert[TEST_CERT_SIZE];
+	char cert_hash[SHA256_DIGEST_SIZE * 2 + 1];
+	u8 *buf;
+};
+
+static u8 *test_put(u8 *p, const void *data, size_t len)
+{
+	memcpy(p, data, len);
+	return p + len;
+}
+
+static u8 *test_put_u16(u8 *p, u16 v)
+{
+	put_unaligned_le16(v, p);
+	return p + 2;
+}
+
+static u8 *test_put_u32(u8 *p, u32 v)
+{
+	put_unaligned_le32(v, p);
+	return p + 4;
+}
+
+static u8 *test_put_u64(u8 *p, u64 v)
+{
+	put_unaligned_le64(v, p);
+	return p + 8;
+}
+
+// Lay out [local header] signing block, empty central directory, EOCD.
+// Returns the apk size, the central directory offset goes to *cd_out.
+static size_t test_build_apk(struct test_apk_ctx *ctx,
+			     const struct test_apk_opts *opts, u32 *cd_out)
+{
+	const char manifest[] = "META-INF/MANIFEST.MF";
+	u8 *p = ctx->buf, *block;
+	u64 size8;
+	u32 cd;
+	int i;
+
+	if (opts->v1_manifest) {
+		p = test_put_u32(p, TEST_ZIP_LOCAL_MAGIC);
+		memset(p, 0, 26);
+		put_unaligned_le16(sizeof(manifest) - 1, p + 22);
+		p += 26;
+		p = test_put(p, manifest, sizeof(manifest) - 1);
+	}
+
+	block = p;
+	p += 8; // size of block, filled in below
+	for (i = 0; i < opts->v2_blocks; i++) {
+		p = test_put_u64(p, 4 + 4 * 3 + 4 + 4 * 2 + TEST_CERT_SIZE);
+		p = test_put_u32(p, TEST_V2_BLOCK_ID);
+		p = test_put_u32(p, 0); // signer-sequence length
+		p = test_put_u32(p, 0); // signer length
+		p = test_put_u32(p, 0); // signed data length
+		p = test_put_u32(p, 0); // digests-sequence length
+		p = test_put_u32(p, 4 + TEST_CERT_SIZE); // certificates length
+		p = test_put_u32(p, TEST_CERT_SIZE); // certificate length
+		p = test_put(p, ctx->cert, TEST_CERT_SIZE);
+	}
+	if (opts->v3_block) {
+		p = test_put_u64(p, 8);
+		p = test_put_u32(p, TEST_V3_BLOCK_ID);
+		p = test_put_u32(p, 0);
+	}
+	size8 = (p - block - 8) + 8 + 16;
+	put_unaligned_le64(size8, block);
+	p = test_put_u64(p, size8);
+	p = test_put(p, "APK Sig Block 42", 16);
+
+	cd = p - ctx->buf;
+	p = test_put_u32(p, TEST_ZIP_EOCD_MAGIC);
+	memset(p, 0, 8); // disk numbers and entry counts
+	p += 8;
+	p = test_put_u32(p, 0); // central directory size
+	p = test_put_u32(p, cd);
+	p = test_put_u16(p, 0); // comment length
+
+	if (cd_out)
+		*cd_out = cd;
+	return p - ctx->buf;
+}
+
+static void test_write_apk(struct kunit *test, const void *buf, size_t len)
+{
+	struct file *fp;
+	loff_t pos = 0;
+
+	fp = ksu_filp_open_compat(TEST_APK_PATH, O_WRONLY | O_CREAT | O_TRUNC,
+				  0644);
+	KUNIT_ASSERT_FALSE_MSG(test, IS_ERR(fp), "open %s: %ld", TEST_APK_PATH,
+			       PTR_ERR(fp));
+	KUNIT_EXPECT_EQ(test, ksu_kernel_write_compat(fp, buf, len, &pos),
+			(ssize_t)len);
+	filp_close(fp, 0);
+}
+
+static bool test_check(int *index)
+{
+	*index = -1;
+	return check_v2_signature(TEST_APK_PATH, true, index);
+}
+
+static void test_set_dynamic(struct kunit *test, unsigned int size,
+			     const char *hash)
+{
+	struct dynamic_manager_user_config config = {
+		.operation = DYNAMIC_MANAGER_OP_SET,
+		.size = size,
+	};
+
+	strscpy(config.hash, hash, sizeof(config.hash));
+	KUNIT_ASSERT_EQ(test, ksu_handle_dynamic_manager(&config), 0);
+}
+
+static int apk_sign_test_init(struct kunit *test)
+{
+	struct test_apk_ctx *ctx;
+	u8 digest[SHA256_DIGEST_SIZE];
+	int i;
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx);
+	ctx->buf = kunit_kzalloc(test, TEST_APK_MAX, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx->buf);
+
+	// a synthetic certificate, trusted through the dynamic manager
+	for (i = 0; i < TEST_CERT_SIZE; i++)
+		ctx->cert[i] = i * 7 + 3;
+	KUNIT_ASSERT_EQ(test, ksu_sha256(ctx->cert, TEST_CERT_SIZE, digest),
+			0);
+	bin2hex(ctx->cert_hash, digest, SHA256_DIGEST_SIZE);
+
+	ctx->saved.operation = DYNAMIC_MANAGER_OP_GET;
+	ctx->had_config = !ksu_handle_dynamic_manager(&ctx->saved);
+	test_set_dynamic(test, TEST_CERT_SIZE, ctx->cert_hash);
+
+	test->priv = ctx;
+	return 0;
+}
+
+static void apk_sign_test_exit(struct kunit *test)
+{
+	struct test_apk_ctx *ctx = test->priv;
+
+	if (ctx->had_config) {
+		ctx->saved.operation = DYNAMIC_MANAGER_OP_SET;
+	} else {
+		ctx->saved.operation = DYNAMIC_MANAGER_OP_CLEAR;
+	}
+	ksu_handle_dynamic_manager(&ctx->saved);
+}
+
+static void ksu_test_apk_valid(struct kunit *test)
+{
+	struct test_apk_ctx *ctx = test->priv;
+	struct test_apk_opts opts = { .v2_blocks = 1 };
+	int index;
+
+	test_write_apk(test, ctx->buf, test_build_apk(ctx, &opts, NULL));
+	KUNIT_EXPECT_TRUE(test, test_check(&index));
+	KUNIT_EXPECT_EQ(test, index, DYNAMIC_SIGN_INDEX);
+	KUNIT_EXPECT_TRUE(test, is_manager_apk(TEST_APK_PATH));
+}
+
+static void ksu_test_apk_hash_mismatch(struct kunit *test)
+{
+	struct test_apk_ctx *ctx = test->priv;
+	struct test_apk_opts opts = { .v2_blocks = 1 };
+	char hash[sizeof(ctx->cert_hash)];
+	int index;
+
+	test_write_apk(test, ctx->buf, test_build_apk(ctx, &opts, NULL));
+
+	strscpy(hash, ctx->cert_hash, sizeof(hash));
+	hash[0] = hash[0] == '0' ? '1' : '0';
+	test_set_dynamic(test, TEST_CERT_SIZE, hash);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+
+	// right hash, wrong size
+	test_set_dynamic(test, TEST_CERT_SIZE + 1, ctx->cert_hash);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+}
+
+static void ksu_test_apk_malformed(struct kunit *test)
+{
+	struct test_apk_ctx *ctx = test->priv;
+	struct test_apk_opts opts = { .v2_blocks = 1 };
+	size_t len;
+	u32 cd;
+	int index;
+
+	len = test_build_apk(ctx, &opts, &cd);
+
+	// truncated, the EOCD is gone
+	test_write_apk(test, ctx->buf, len / 2);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+
+	// too short to hold an EOCD at all
+	test_write_apk(test, ctx->buf, 8);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+
+	// no EOCD magic
+	put_unaligned_le32(0, ctx->buf + cd);
+	test_write_apk(test, ctx->buf, len);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+	put_unaligned_le32(TEST_ZIP_EOCD_MAGIC, ctx->buf + cd);
+
+	// central directory offset past the end of the file
+	put_unaligned_le32(len + 0x100, ctx->buf + cd + 16);
+	test_write_apk(test, ctx->buf, len);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+
+	// central directory offset below the signing block footer
+	put_unaligned_le32(0x10, ctx->buf + cd + 16);
+	test_write_apk(test, ctx->buf, len);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+	put_unaligned_le32(cd, ctx->buf + cd + 16);
+
+	// signing block size pointing before the start of the file
+	put_unaligned_le64(cd + 0x100, ctx->buf + cd - 24);
+	test_write_apk(test, ctx->buf, len);
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+}
+
+static void ksu_test_apk_schemes(struct kunit *test)
+{
+	struct test_apk_ctx *ctx = test->priv;
+	struct test_apk_opts v3 = { .v2_blocks = 1, .v3_block = true };
+	struct test_apk_opts v2_twice = { .v2_blocks = 2 };
+	struct test_apk_opts v1 = { .v2_blocks = 1, .v1_manifest = true };
+	struct test_apk_opts none = { 0 };
+	int index;
+
+	test_write_apk(test, ctx->buf, test_build_apk(ctx, &v3, NULL));
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+
+	test_write_apk(test, ctx->buf, test_build_apk(ctx, &v2_twice, NULL));
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+
+	test_write_apk(test, ctx->buf, test_build_apk(ctx, &v1, NULL));
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+
+	test_write_apk(test, ctx->buf, test_build_apk(ctx, &none, NULL));
+	KUNIT_EXPECT_FALSE(test, test_check(&index));
+}
+
+// Runs once per apk the throne tracker finds in /data/app.
+static void ksu_test_apk_bench(struct kunit *test)
+{
+	struct test_apk_ctx *ctx = test->priv;
+	struct test_apk_opts opts = { .v2_blocks = 1 };
+	int index;
+
+	test_write_apk(test, ctx->buf, test_build_apk(ctx, &opts, NULL));
+	KSU_BENCH(test, "check_v2_signature/match", 1000, test_check(&index));
+
+	// unknown certificate size, rejected before hashing
+	test_set_dynamic(test, TEST_CERT_SIZE + 1, ctx->cert_hash);
+	KSU_BENCH(test, "check_v2_signature/reject", 1000, test_check(&index));
+}
+
+static struct kunit_case ksu_apk_sign_test_cases[] = {
+	KUNIT_CASE(ksu_test_apk_valid),
+	KUNIT_CASE(ksu_test_apk_hash_mismatch),
+	KUNIT_CASE(ksu_test_apk_malformed),
+	KUNIT_CASE(ksu_test_apk_schemes),
+	KUNIT_CASE(ksu_test_apk_bench),
+	{}
+};
+
+static struct kunit_suite ksu_apk_sign_test_suite = {
+	.name = "ksu_apk_sign",
+	.init = apk_sign_test_init,
+	.exit = apk_sign_test_exit,
+	.test_cases = ksu_apk_sign_test_cases,
+};
+
+kunit_test_suites(&ksu_apk_sign_test_suite);
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0
+// Included from event_ring.c when CONFIG_KSU_KUNIT_TEST is set.
+
+#include "ksu_test.h"
+
+static int event_ring_test_init(struct kunit *test)
+{
+	// ksu_event_ring_init normally ran at boot, make sure of it
+	if (!READ_ONCE(ring_buf))
+		KUNIT_ASSERT_EQ(test, ksu_event_ring_init(), 0);
+	return 0;
+}
+
+static void ksu_test_event_record(struct kunit *test)
+{
+	struct ksu_event_ring_header *hdr = ring_header();
+	struct ksu_event *ev;
+	u64 before, pos;
+	int cpu;
+
+	// stay on one cpu so the record lands in the ring we look at
+	cpu = get_cpu();
+	before = smp_load_acquire(&hdr->head[cpu]);
+	ksu_event_record(KSU_EVENT_SU_GRANT, 10123, 4567, 0);
+	pos = smp_load_acquire(&hdr->head[cpu]);
+	put_cpu();
+
+	KUNIT_ASSERT_EQ(test, pos, before + 1);
+	ev = &cpu_ring(hdr, cpu)[before & (RING_ENTRIES - 1)];
+	KUNIT_EXPECT_EQ(test, ev->seq, pos);
+	KUNIT_EXPECT_EQ(test, ev->type, (u32)KSU_EVENT_SU_GRANT);
+	KUNIT_EXPECT_EQ(test, ev->uid, (u32)10123);
+	KUNIT_EXPECT_EQ(test, ev->pid, (u32)4567);
+	KUNIT_EXPECT_EQ(test, ev->data, (u32)0);
+}
+
+static void ksu_test_event_wrap(struct kunit *test)
+{
+	struct ksu_event_ring_header *hdr = ring_header();
+	struct ksu_event *ev;
+	u64 before, i;
+	int cpu;
+
+	cpu = get_cpu();
+	before = smp_load_acquire(&hdr->head[cpu]);
+	for (i = 0; i < RING_ENTRIES + 1; i++)
+		ksu_event_record(KSU_EVENT_UMOUNT, 10123, 4567, (u32)i);
+	put_cpu();
+
+	// the oldest slot was overwritten with the newest record
+	ev = &cpu_ring(hdr, cpu)[before & (RING_ENTRIES - 1)];
+	KUNIT_EXPECT_EQ(test, ev->seq, before + RING_ENTRIES + 1);
+	KUNIT_EXPECT_EQ(test, ev->data, (u32)RING_ENTRIES);
+}
+
+// The cost added to every su grant, denial and umount hook.
+static void ksu_test_event_bench(struct kunit *test)
+{
+	void *buf;
+
+	KSU_BENCH(test, "event_record", 1000000,
+		  ksu_event_record(KSU_EVENT_PROFILE_HIT, 10123, 4567, 0));
+
+	// with the ring gone the hooks pay one load and a branch
+	buf = xchg(&ring_buf, NULL);
+	KSU_BENCH(test, "event_record/disabled", 1000000,
+		  ksu_event_record(KSU_EVENT_PROFILE_HIT, 10123, 4567, 0));
+	smp_store_release(&ring_buf, buf);
+}
+
+static struct kunit_case ksu_event_ring_test_cases[] = {
+	KUNIT_CASE(ksu_test_event_record),
+	KUNIT_CASE(ksu_test_event_wrap),
+	KUNIT_CASE(ksu_test_event_bench),
+	{}
+};
+
+static struct kunit_suite ksu_event_ring_test_suite = {
+	.name = "ksu_event_ring",
+	.init = event_ring_test_init,
+	.test_cases = ksu_event_ring_test_cases,
+};
+
+kunit_test_suites(&ksu_event_ring_test_suite);
@@ -0,0 +1,178 @@
+// Host timings for the parsers the throne tracker runs on every package
+// scan, in the same format as the KUnit bench lines. With -w DIR it
+// writes the seed corpora for the fuzz targets instead.
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include "../../throne_tracker.c"
+#include "fixture.h"
+
+#define BENCH(name, iters, body)                                               \
+	do {                                                                   \
+		u64 __iters = (iters), __i, __start;                           \
+		__start = bench_now();                                         \
+		for (__i = 0; __i < __iters; __i++) {                          \
+			body;                                                  \
+		}                                                              \
+		printf("bench %s: %llu ns/op over %llu runs\n", name,          \
+		       (unsigned long long)((bench_now() - __start) / __iters), \
+		       (unsigned long long)__iters);                           \
+	} while (0)
+
+static u64 bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void free_uid_list(struct list_head *uid_list)
+{
+	struct uid_data *d, *n;
+
+	list_for_each_entry_safe (d, n, uid_list, list) {
+		list_del(&d->list);
+		free(d);
+	}
+}
+
+static size_t make_uid_list(char *buf, size_t cap, int n)
+{
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		len += snprintf(buf + len, cap - len, "%d com.example.pkg%d\n",
+				10000 + i, i);
+	return len;
+}
+
+static void bench_apk_sign(void)
+{
+	struct fixture_apk_opts opts = { .v2_blocks = 1 };
+	static u8 apk[FIXTURE_APK_MAX];
+	size_t len = fixture_build_apk(apk, &opts);
+	int index;
+
+	shim_set_file(FIXTURE_APK_PATH, apk, len);
+	fixture_trust_cert();
+	if (!is_dynamic_manager_apk(FIXTURE_APK_PATH, &index) ||
+	    index != DYNAMIC_SIGN_INDEX) {
+		fprintf(stderr, "fixture apk was not accepted\n");
+		exit(1);
+	}
+	BENCH("check_v2_signature/match", 100000,
+	      is_dynamic_manager_apk(FIXTURE_APK_PATH, &index));
+
+	// no key of this certificate size, rejected before hashing
+	shim_set_dynamic_manager(0, NULL);
+	BENCH("check_v2_signature/reject", 100000,
+	      is_manager_apk(FIXTURE_APK_PATH));
+}
+
+static void bench_uid_list(void)
+{
+	static const int sizes[] = { 100, 1000, 5000 };
+	char name[64], *src, *buf;
+	size_t cap, len;
+	int i, n;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		n = sizes[i];
+		cap = n * 32 + 1;
+		src = malloc(cap);
+		buf = malloc(cap);
+		if (!src || !buf)
+			abort();
+		len = make_uid_list(src, cap, n);
+
+		snprintf(name, sizeof(name), "uid_from_um_buf/%d", n);
+		BENCH(name, 1000, {
+			LIST_HEAD(uid_list);
+
+			memcpy(buf, src, len + 1);
+			if (uid_from_um_buf(buf, &uid_list) != n)
+				abort();
+			free_uid_list(&uid_list);
+		});
+		free(src);
+		free(buf);
+	}
+}
+
+static void bench_apk_path(void)
+{
+	char pkg[KSU_MAX_PACKAGE_NAME];
+
+	BENCH("get_pkg_from_apk_path", 1000000,
+	      get_pkg_from_apk_path(pkg, FIXTURE_APK_PATH));
+}
+
+static void write_seed(const char *dir, const char *target, const char *name,
+		       const void *data, size_t len)
+{
+	char path[4096];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, target);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/%s/%s", dir, target, name);
+	f = fopen(path, "wb");
+	if (!f || fwrite(data, 1, len, f) != len) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+}
+
+static void write_seeds(const char *dir)
+{
+	static const struct {
+		const char *name;
+		struct fixture_apk_opts opts;
+	} apks[] = {
+		{ "v2.apk", { .v2_blocks = 1 } },
+		{ "v2_twice.apk", { .v2_blocks = 2 } },
+		{ "v2_v3.apk", { .v2_blocks = 1, .v3_block = true } },
+		{ "v1_v2.apk", { .v2_blocks = 1, .v1_manifest = true } },
+	};
+	static const char *paths[] = {
+		FIXTURE_APK_PATH,
+		"/data/app/me.weishu.kernelsu-1/base.apk",
+		"/data/app/com.a/base-1.apk",
+	};
+	static u8 apk[FIXTURE_APK_MAX];
+	char list[256], name[32];
+	int i;
+
+	mkdir(dir, 0755);
+	for (i = 0; i < ARRAY_SIZE(apks); i++)
+		write_seed(dir, "apk_sign", apks[i].name, apk,
+			   fixture_build_apk(apk, &apks[i].opts));
+	for (i = 0; i < ARRAY_SIZE(paths); i++) {
+		snprintf(name, sizeof(name), "path%d", i);
+		write_seed(dir, "apk_path", name, paths[i], strlen(paths[i]));
+	}
+	write_seed(dir, "uid_list", "list", list,
+		   make_uid_list(list, sizeof(list), 4));
+}
+
+int main(int argc, char **argv)
+{
+	shim_verbose = getenv("KSU_SHIM_VERBOSE");
+	if (argc == 3 && !strcmp(argv[1], "-w")) {
+		write_seeds(argv[2]);
+		return 0;
+	}
+	if (argc != 1) {
+		fprintf(stderr, "usage: %s [-w corpus_dir]\n", argv[0]);
+		return 1;
+	}
+
+	bench_apk_sign();
+	bench_uid_list();
+	bench_apk_path();
+	return 0;
+}
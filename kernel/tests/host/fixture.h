@@ -0,0 +1,100 @@
+#ifndef __KSU_H_HOST_FIXTURE
+#define __KSU_H_HOST_FIXTURE
+
+// A minimal v2-signed apk: [local header] signing block, empty central
+// directory, EOCD. Same layout as the KUnit fixtures in apk_sign_test.c.
+
+#define FIXTURE_APK_PATH "/data/app/~~fixture==/com.sukisu.ultra-1==/base.apk"
+#define FIXTURE_CERT_SIZE 0x100
+#define FIXTURE_APK_MAX 4096
+
+struct fixture_apk_opts {
+	int v2_blocks;
+	bool v3_block;
+	bool v1_manifest;
+};
+
+static u8 *fixture_put(u8 *p, const void *data, size_t len)
+{
+	memcpy(p, data, len);
+	return p + len;
+}
+
+static u8 *fixture_put_le(u8 *p, u64 v, int bytes)
+{
+	int i;
+
+	for (i = 0; i < bytes; i++)
+		*p++ = v >> (i * 8);
+	return p;
+}
+
+static void fixture_cert(u8 *cert)
+{
+	int i;
+
+	for (i = 0; i < FIXTURE_CERT_SIZE; i++)
+		cert[i] = i * 7 + 3;
+}
+
+// Trust the fixture certificate through the dynamic manager.
+static void fixture_trust_cert(void)
+{
+	u8 cert[FIXTURE_CERT_SIZE];
+	char hash[SHA256_DIGEST_SIZE * 2 + 1];
+
+	fixture_cert(cert);
+	shim_sha256_hex(cert, sizeof(cert), hash);
+	shim_set_dynamic_manager(FIXTURE_CERT_SIZE, hash);
+}
+
+static size_t fixture_build_apk(u8 *buf, const struct fixture_apk_opts *opts)
+{
+	const char manifest[] = "META-INF/MANIFEST.MF";
+	u8 cert[FIXTURE_CERT_SIZE];
+	u8 *p = buf, *block;
+	u64 size8;
+	u32 cd;
+	int i;
+
+	fixture_cert(cert);
+	if (opts->v1_manifest) {
+		p = fixture_put_le(p, 0x04034b50, 4);
+		memset(p, 0, 26);
+		fixture_put_le(p + 22, sizeof(manifest) - 1, 2);
+		p += 26;
+		p = fixture_put(p, manifest, sizeof(manifest) - 1);
+	}
+
+	block = p;
+	p += 8;
+	for (i = 0; i < opts->v2_blocks; i++) {
+		p = fixture_put_le(p, 4 + 4 * 3 + 4 + 4 * 2 + FIXTURE_CERT_SIZE,
+				   8);
+		p = fixture_put_le(p, 0x7109871a, 4);
+		memset(p, 0, 4 * 4); // signer, signed data and digests lengths
+		p += 4 * 4;
+		p = fixture_put_le(p, 4 + FIXTURE_CERT_SIZE, 4);
+		p = fixture_put_le(p, FIXTURE_CERT_SIZE, 4);
+		p = fixture_put(p, cert, FIXTURE_CERT_SIZE);
+	}
+	if (opts->v3_block) {
+		p = fixture_put_le(p, 8, 8);
+		p = fixture_put_le(p, 0xf05368c0, 4);
+		p = fixture_put_le(p, 0, 4);
+	}
+	size8 = (p - block - 8) + 8 + 16;
+	fixture_put_le(block, size8, 8);
+	p = fixture_put_le(p, size8, 8);
+	p = fixture_put(p, "APK Sig Block 42", 16);
+
+	cd = p - buf;
+	p = fixture_put_le(p, 0x06054b50, 4);
+	p = fixture_put_le(p, 0, 8); // disk numbers and entry counts
+	p = fixture_put_le(p, 0, 4); // central directory size
+	p = fixture_put_le(p, cd, 4);
+	p = fixture_put_le(p, 0, 2);
+	return p - buf;
+}
+
+#endif
@@ -0,0 +1,26 @@
+// libFuzzer target: get_pkg_from_apk_path on arbitrary paths.
+
+#include "../../throne_tracker.c"
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t size)
+{
+	char pkg[KSU_MAX_PACKAGE_NAME];
+	char *path;
+
+	path = malloc(size + 1);
+	if (!path)
+		return 0;
+	memcpy(path, data, size);
+	path[size] = '\0';
+
+	if (!get_pkg_from_apk_path(pkg, path)) {
+		size_t len = strnlen(pkg, sizeof(pkg));
+
+		// a non-empty name, taken from between the last two slashes
+		if (!len || len == sizeof(pkg) || strchr(pkg, '/') ||
+		    !strstr(path, pkg))
+			abort();
+	}
+	free(path);
+	return 0;
+}
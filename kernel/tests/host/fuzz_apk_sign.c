@@ -0,0 +1,23 @@
+// libFuzzer target: the v2 signature parser behind is_manager_apk and
+// is_dynamic_manager_apk, fed arbitrary apk images.
+
+#include "apk_sign.h"
+#include "dynamic_manager.h"
+#include "fixture.h"
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t size)
+{
+	int index = -1;
+
+	shim_set_file(FIXTURE_APK_PATH, data, size);
+
+	// with the dynamic manager on, certificates of its size get hashed
+	fixture_trust_cert();
+	is_dynamic_manager_apk(FIXTURE_APK_PATH, &index);
+	if (index != -1 && index != 0 && index != DYNAMIC_SIGN_INDEX)
+		abort();
+
+	shim_set_dynamic_manager(0, NULL);
+	is_manager_apk(FIXTURE_APK_PATH);
+	return 0;
+}
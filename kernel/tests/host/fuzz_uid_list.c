@@ -0,0 +1,33 @@
+// libFuzzer target: the /data/misc/user_uid/uid_list tokenizer.
+
+#include "../../throne_tracker.c"
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t size)
+{
+	struct uid_data *d, *n;
+	LIST_HEAD(uid_list);
+	char *buf;
+	int cnt = 0;
+
+	buf = malloc(size + 1);
+	if (!buf)
+		return 0;
+	memcpy(buf, data, size);
+	buf[size] = '\0';
+
+	if (uid_from_um_buf(buf, &uid_list) < 0)
+		abort();
+
+	list_for_each_entry_safe (d, n, &uid_list, list) {
+		size_t len = strnlen(d->package, KSU_MAX_PACKAGE_NAME);
+
+		if (!len || len == KSU_MAX_PACKAGE_NAME)
+			abort();
+		list_del(&d->list);
+		free(d);
+		cnt++;
+	}
+	(void)cnt;
+	free(buf);
+	return 0;
+}
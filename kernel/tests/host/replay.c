@@ -0,0 +1,79 @@
+// Stand-in for the libFuzzer driver when building with gcc: run every
+// file named on the command line, or found in a named directory, through
+// LLVMFuzzerTestOneInput once. Sanitizer builds then double as
+// regression tests over the corpus.
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+int LLVMFuzzerTestOneInput(const u8 *data, size_t size);
+
+static int replay_file(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	u8 *data = NULL;
+	size_t size = 0, cap = 0, n;
+
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+	do {
+		if (size == cap) {
+			cap = cap ? cap * 2 : 4096;
+			data = realloc(data, cap);
+			if (!data)
+				abort();
+		}
+		n = fread(data + size, 1, cap - size, f);
+		size += n;
+	} while (n);
+	fclose(f);
+
+	LLVMFuzzerTestOneInput(data, size);
+	free(data);
+	return 0;
+}
+
+static int replay(const char *path, int *runs)
+{
+	struct dirent *ent;
+	struct stat st;
+	char child[4096];
+	DIR *dir;
+	int ret = 0;
+
+	if (stat(path, &st)) {
+		perror(path);
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		++*runs;
+		return replay_file(path);
+	}
+
+	dir = opendir(path);
+	if (!dir) {
+		perror(path);
+		return -1;
+	}
+	while ((ent = readdir(dir))) {
+		if (ent->d_name[0] == '.')
+			continue;
+		snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+		ret |= replay(child, runs);
+	}
+	closedir(dir);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int i, runs = 0, ret = 0;
+
+	shim_verbose = getenv("KSU_SHIM_VERBOSE");
+	for (i = 1; i < argc; i++)
+		ret |= replay(argv[i], &runs);
+	fprintf(stderr, "%s: %d inputs\n", argv[0], runs);
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+#ifndef __KSU_H_HOST_SHIM
+#define __KSU_H_HOST_SHIM
+
+// Just enough of the kernel API for apk_sign.c and throne_tracker.c to
+// build as host code. Forced into every translation unit with -include,
+// the <linux/...> headers they name are empty files generated by the
+// Makefile.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define LINUX_VERSION_CODE KERNEL_VERSION(6, 6, 0)
+#define KERNEL_VERSION(a, b, c) (((a) << 16) + ((b) << 8) + (c))
+
+// the kernel's loff_t is long long, glibc's is long on 64-bit
+#define loff_t long long
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int64_t s64;
+typedef unsigned short umode_t;
+typedef unsigned int fmode_t;
+typedef unsigned int gfp_t;
+
+#define __user
+#define __maybe_unused __attribute__((unused))
+#ifndef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#endif
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+#define barrier() __asm__ __volatile__("" ::: "memory")
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member)                                        \
+	((type *)((char *)(ptr)-offsetof(type, member)))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// printk
+
+extern bool shim_verbose;
+
+#define shim_log(fmt, ...)                                                     \
+	do {                                                                   \
+		if (unlikely(shim_verbose))                                    \
+			fprintf(stderr, "KernelSU: " fmt, ##__VA_ARGS__);      \
+	} while (0)
+#define pr_err(fmt, ...) shim_log(fmt, ##__VA_ARGS__)
+#define pr_warn(fmt, ...) shim_log(fmt, ##__VA_ARGS__)
+#define pr_warn_once(fmt, ...) shim_log(fmt, ##__VA_ARGS__)
+#define pr_info(fmt, ...) shim_log(fmt, ##__VA_ARGS__)
+#define pr_debug(fmt, ...) shim_log(fmt, ##__VA_ARGS__)
+
+// errors
+
+#define MAX_ERRNO 4095
+#define IS_ERR_VALUE(x) ((unsigned long)(x) >= (unsigned long)-MAX_ERRNO)
+#define IS_ERR(ptr) IS_ERR_VALUE((unsigned long)(ptr))
+#define PTR_ERR(ptr) ((long)(ptr))
+#define ERR_PTR(err) ((void *)(long)(err))
+
+// allocation
+
+#define GFP_KERNEL 0u
+#define GFP_ATOMIC 1u
+#define kmalloc(size, gfp) malloc(size)
+#define kzalloc(size, gfp) calloc(1, size)
+#define kfree(ptr) free((void *)(ptr))
+
+// strings
+
+ssize_t strscpy(char *dst, const char *src, size_t count);
+char *bin2hex(char *dst, const void *src, size_t count);
+int kstrtou32(const char *s, unsigned int base, u32 *res);
+unsigned int full_name_hash(const void *salt, const char *name,
+			    unsigned int len);
+
+// lists
+
+struct list_head {
+	struct list_head *next, *prev;
+};
+
+#define LIST_HEAD_INIT(name) { &(name), &(name) }
+#define LIST_HEAD(name) struct list_head name = LIST_HEAD_INIT(name)
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+	list->next = list;
+	list->prev = list;
+}
+
+static inline void list_add_tail(struct list_head *new, struct list_head *head)
+{
+	new->prev = head->prev;
+	new->next = head;
+	head->prev->next = new;
+	head->prev = new;
+}
+
+static inline void list_del(struct list_head *entry)
+{
+	entry->prev->next = entry->next;
+	entry->next->prev = entry->prev;
+	entry->next = entry->prev = NULL;
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+	return head->next == head;
+}
+
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+#define list_first_entry(ptr, type, member)                                    \
+	list_entry((ptr)->next, type, member)
+#define list_next_entry(pos, member)                                           \
+	list_entry((pos)->member.next, __typeof__(*(pos)), member)
+#define list_for_each(pos, head)                                               \
+	for (pos = (head)->next; pos != (head); pos = pos->next)
+#define list_for_each_entry(pos, head, member)                                 \
+	for (pos = list_first_entry(head, __typeof__(*pos), member);           \
+	     &pos->member != (head); pos = list_next_entry(pos, member))
+#define list_for_each_entry_safe(pos, n, head, member)                         \
+	for (pos = list_first_entry(head, __typeof__(*pos), member),           \
+	    n = list_next_entry(pos, member);                                  \
+	     &pos->member != (head); pos = n, n = list_next_entry(n, member))
+
+// files, backed by an in-memory image registered with shim_set_file()
+
+#define FMODE_NONOTIFY 0x4000000u
+#define LOOKUP_FOLLOW 0x0001
+#define STATX_UID 0x0008u
+#define AT_STATX_SYNC_AS_STAT 0x0000
+
+struct super_block {
+	unsigned long s_magic;
+};
+
+struct inode {
+	loff_t i_size;
+	struct super_block *i_sb;
+};
+
+struct file {
+	fmode_t f_mode;
+	struct inode *f_inode;
+	const u8 *data;
+};
+
+struct dir_context;
+typedef bool (*filldir_t)(struct dir_context *, const char *, int, loff_t,
+			  u64, unsigned int);
+struct dir_context {
+	filldir_t actor;
+	loff_t pos;
+};
+
+typedef struct {
+	uid_t val;
+} kuid_t;
+
+struct user_namespace {
+	int unused;
+};
+extern struct user_namespace init_user_ns;
+
+struct path {
+	void *dentry;
+};
+
+struct kstat {
+	kuid_t uid;
+};
+
+struct work_struct;
+struct cred;
+
+void shim_set_file(const char *path, const void *data, size_t size);
+struct file *ksu_filp_open_compat(const char *filename, int flags,
+				  umode_t mode);
+ssize_t ksu_kernel_read_compat(struct file *p, void *buf, size_t count,
+			       loff_t *pos);
+ssize_t ksu_kernel_write_compat(struct file *p, const void *buf, size_t count,
+				loff_t *pos);
+int filp_close(struct file *filp, void *id);
+
+static inline struct inode *file_inode(const struct file *f)
+{
+	return f->f_inode;
+}
+
+static inline loff_t i_size_read(const struct inode *inode)
+{
+	return inode->i_size;
+}
+
+// the directory walk of throne_tracker.c never runs on the host
+int iterate_dir(struct file *file, struct dir_context *ctx);
+int kern_path(const char *name, unsigned int flags, struct path *path);
+int vfs_getattr(const struct path *path, struct kstat *stat, u32 request_mask,
+		unsigned int query_flags);
+void path_put(const struct path *path);
+uid_t from_kuid(struct user_namespace *ns, kuid_t uid);
+kuid_t current_uid(void);
+
+static inline unsigned long copy_from_user(void *to, const void __user *from,
+					   unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+#define copy_from_user_nofault copy_from_user
+
+// sha256 behind the crypto_shash calls apk_sign.c makes
+
+#define SHA256_DIGEST_SIZE 32
+
+struct crypto_shash {
+	int unused;
+};
+
+struct shash_desc {
+	struct crypto_shash *tfm;
+};
+
+struct crypto_shash *crypto_alloc_shash(const char *alg_name, u32 type,
+					u32 mask);
+void crypto_free_shash(struct crypto_shash *tfm);
+unsigned int crypto_shash_descsize(struct crypto_shash *tfm);
+int crypto_shash_digest(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out);
+
+// dynamic manager, configured by the harness
+
+void shim_set_dynamic_manager(unsigned int size, const char *hash);
+bool shim_sha256_hex(const void *data, size_t len, char *hex);
+
+#endif
@@ -0,0 +1,316 @@
+// Host implementations of the kernel calls declared in ksu_shim.h.
+
+#include "dynamic_manager.h"
+
+bool shim_verbose;
+struct user_namespace init_user_ns;
+bool ksu_uid_scanner_enabled;
+
+// strings
+
+ssize_t strscpy(char *dst, const char *src, size_t count)
+{
+	size_t len;
+
+	if (!count)
+		return -E2BIG;
+	len = strnlen(src, count);
+	if (len == count) {
+		memcpy(dst, src, count - 1);
+		dst[count - 1] = '\0';
+		return -E2BIG;
+	}
+	memcpy(dst, src, len + 1);
+	return len;
+}
+
+char *bin2hex(char *dst, const void *src, size_t count)
+{
+	static const char hex[] = "0123456789abcdef";
+	const u8 *p = src;
+
+	while (count--) {
+		*dst++ = hex[*p >> 4];
+		*dst++ = hex[*p++ & 0xf];
+	}
+	return dst;
+}
+
+// Same rules as the kernel: digits only, one trailing newline allowed.
+int kstrtou32(const char *s, unsigned int base, u32 *res)
+{
+	u64 v = 0;
+	const char *p = s;
+
+	if (base != 10)
+		return -EINVAL;
+	if (*p == '+')
+		p++;
+	if (*p < '0' || *p > '9')
+		return -EINVAL;
+	for (; *p >= '0' && *p <= '9'; p++) {
+		v = v * 10 + (*p - '0');
+		if (v > UINT32_MAX)
+			return -ERANGE;
+	}
+	if (*p == '\n')
+		p++;
+	if (*p)
+		return -EINVAL;
+	*res = v;
+	return 0;
+}
+
+unsigned int full_name_hash(const void *salt, const char *name,
+			    unsigned int len)
+{
+	unsigned int hash = 0;
+
+	while (len--)
+		hash = (hash + (u8)*name++) * 9;
+	return hash;
+}
+
+// files
+
+static struct {
+	char path[256];
+	const u8 *data;
+	size_t size;
+} shim_file;
+
+void shim_set_file(const char *path, const void *data, size_t size)
+{
+	strscpy(shim_file.path, path, sizeof(shim_file.path));
+	shim_file.data = data;
+	shim_file.size = size;
+}
+
+struct file *ksu_filp_open_compat(const char *filename, int flags,
+				  umode_t mode)
+{
+	struct {
+		struct file file;
+		struct inode inode;
+		struct super_block sb;
+	} *f;
+
+	if (strcmp(filename, shim_file.path))
+		return ERR_PTR(-ENOENT);
+	f = calloc(1, sizeof(*f));
+	if (!f)
+		return ERR_PTR(-ENOMEM);
+	f->inode.i_size = shim_file.size;
+	f->inode.i_sb = &f->sb;
+	f->file.f_inode = &f->inode;
+	f->file.data = shim_file.data;
+	// file comes first, so filp_close can free the whole block
+	return &f->file;
+}
+
+ssize_t ksu_kernel_read_compat(struct file *p, void *buf, size_t count,
+			       loff_t *pos)
+{
+	loff_t size = p->f_inode->i_size;
+
+	if (*pos < 0)
+		return -EINVAL;
+	if (*pos >= size)
+		return 0;
+	if (count > size - *pos)
+		count = size - *pos;
+	memcpy(buf, p->data + *pos, count);
+	*pos += count;
+	return count;
+}
+
+ssize_t ksu_kernel_write_compat(struct file *p, const void *buf, size_t count,
+				loff_t *pos)
+{
+	return -EROFS;
+}
+
+int filp_close(struct file *filp, void *id)
+{
+	free(filp);
+	return 0;
+}
+
+int iterate_dir(struct file *file, struct dir_context *ctx)
+{
+	return -ENOTDIR;
+}
+
+int kern_path(const char *name, unsigned int flags, struct path *path)
+{
+	return -ENOENT;
+}
+
+int vfs_getattr(const struct path *path, struct kstat *stat, u32 request_mask,
+		unsigned int query_flags)
+{
+	return -ENOENT;
+}
+
+void path_put(const struct path *path)
+{
+}
+
+uid_t from_kuid(struct user_namespace *ns, kuid_t uid)
+{
+	return uid.val;
+}
+
+kuid_t current_uid(void)
+{
+	return (kuid_t){ 0 };
+}
+
+// sha256, FIPS 180-4
+
+static const u32 sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+	0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+	0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ror32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(u32 *h, const u8 *p)
+{
+	u32 w[64], a, b, c, d, e, f, g, k, t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = (u32)p[i * 4] << 24 | (u32)p[i * 4 + 1] << 16 |
+		       (u32)p[i * 4 + 2] << 8 | p[i * 4 + 3];
+	for (; i < 64; i++)
+		w[i] = w[i - 16] + w[i - 7] +
+		       (ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^
+			(w[i - 15] >> 3)) +
+		       (ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^
+			(w[i - 2] >> 10));
+
+	a = h[0], b = h[1], c = h[2], d = h[3];
+	e = h[4], f = h[5], g = h[6], k = h[7];
+	for (i = 0; i < 64; i++) {
+		t1 = k + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) +
+		     ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) +
+		     ((a & b) ^ (a & c) ^ (b & c));
+		k = g, g = f, f = e, e = d + t1;
+		d = c, c = b, b = a, a = t1 + t2;
+	}
+	h[0] += a, h[1] += b, h[2] += c, h[3] += d;
+	h[4] += e, h[5] += f, h[6] += g, h[7] += k;
+}
+
+static void sha256(const u8 *data, size_t len, u8 *out)
+{
+	u32 h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	u8 tail[128] = { 0 };
+	size_t rest = len % 64, tail_len = rest < 56 ? 64 : 128;
+	u64 bits = (u64)len * 8;
+	size_t i;
+
+	for (i = 0; i + 64 <= len; i += 64)
+		sha256_block(h, data + i);
+	memcpy(tail, data + i, rest);
+	tail[rest] = 0x80;
+	for (i = 0; i < 8; i++)
+		tail[tail_len - 1 - i] = bits >> (i * 8);
+	for (i = 0; i < tail_len; i += 64)
+		sha256_block(h, tail + i);
+	for (i = 0; i < 32; i++)
+		out[i] = h[i / 4] >> (24 - (i % 4) * 8);
+}
+
+static struct crypto_shash shim_sha256_tfm;
+
+struct crypto_shash *crypto_alloc_shash(const char *alg_name, u32 type,
+					u32 mask)
+{
+	if (strcmp(alg_name, "sha256"))
+		return ERR_PTR(-ENOENT);
+	return &shim_sha256_tfm;
+}
+
+void crypto_free_shash(struct crypto_shash *tfm)
+{
+}
+
+unsigned int crypto_shash_descsize(struct crypto_shash *tfm)
+{
+	return 0;
+}
+
+int crypto_shash_digest(struct shash_desc *desc, const u8 *data,
+			unsigned int len, u8 *out)
+{
+	sha256(data, len, out);
+	return 0;
+}
+
+bool shim_sha256_hex(const void *data, size_t len, char *hex)
+{
+	u8 digest[SHA256_DIGEST_SIZE];
+
+	sha256(data, len, digest);
+	bin2hex(hex, digest, SHA256_DIGEST_SIZE);
+	hex[SHA256_DIGEST_SIZE * 2] = '\0';
+	return true;
+}
+
+// dynamic manager and allowlist
+
+static struct dynamic_manager_config shim_dynamic;
+
+void shim_set_dynamic_manager(unsigned int size, const char *hash)
+{
+	shim_dynamic.is_set = hash != NULL;
+	if (!hash)
+		return;
+	shim_dynamic.size = size;
+	strscpy(shim_dynamic.hash, hash, sizeof(shim_dynamic.hash));
+}
+
+bool ksu_is_dynamic_manager_enabled(void)
+{
+	return shim_dynamic.is_set;
+}
+
+bool ksu_get_dynamic_manager_config(unsigned int *size, const char **hash)
+{
+	if (!shim_dynamic.is_set)
+		return false;
+	*size = shim_dynamic.size;
+	*hash = shim_dynamic.hash;
+	return true;
+}
+
+void ksu_add_manager(uid_t uid, int signature_index)
+{
+}
+
+void ksu_remove_manager(uid_t uid)
+{
+}
+
+bool ksu_is_any_manager(uid_t uid)
+{
+	return false;
+}
+
+void ksu_prune_allowlist(bool (*is_uid_exist)(uid_t, char *, void *),
+			 void *data)
+{
+}
@@ -0,0 +1,25 @@
+#ifndef __KSU_H_TEST
+#define __KSU_H_TEST
+
+#include <kunit/test.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+
+// The suites are #included at the end of the file they test, like
+// fs/ext4/mballoc-test.c, so they can reach its static functions.
+
+// Time iters runs of body and report the mean in the test log.
+#define KSU_BENCH(test, name, iters, body)                                     \
+	do {                                                                   \
+		u64 __iters = (iters), __i, __start;                           \
+		__start = ktime_get_ns();                                      \
+		for (__i = 0; __i < __iters; __i++) {                          \
+			body;                                                  \
+		}                                                              \
+		kunit_info(test, "bench %s: %llu ns/op over %llu runs\n",      \
+			   name,                                               \
+			   div64_u64(ktime_get_ns() - __start, __iters),       \
+			   __iters);                                           \
+	} while (0)
+
+#endif
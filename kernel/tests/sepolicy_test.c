@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: GPL-2.0
+// Included from selinux/sepolicy.c when CONFIG_KSU_KUNIT_TEST is set.
+
+#include "ksu_test.h"
+
+#define ALL NULL
+
+// The policydb is assembled by hand from the symtab and avtab helpers,
+// whose signatures only settled in 5.10, so older kernels skip the suite.
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0)
+
+#define TEST_TYPES 64
+#define TEST_TYPE_NAME_LEN 24
+
+struct test_policy {
+	struct policydb db;
+	char names[TEST_TYPES][TEST_TYPE_NAME_LEN];
+};
+
+static int test_free_sym(void *key, void *datum, void *args)
+{
+	kfree(key);
+	kfree(datum);
+	return 0;
+}
+
+static int test_free_class(void *key, void *datum, void *args)
+{
+	struct class_datum *cls = datum;
+
+	hashtab_map(&cls->permissions.table, test_free_sym, NULL);
+	hashtab_destroy(&cls->permissions.table);
+	return test_free_sym(key, datum, args);
+}
+
+static void test_add_perm(struct kunit *test, struct class_datum *cls,
+			  const char *name, u32 value)
+{
+	struct perm_datum *perm;
+
+	perm = kzalloc(sizeof(*perm), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, perm);
+	perm->value = value;
+	KUNIT_ASSERT_EQ(test,
+			symtab_insert(&cls->permissions,
+				      kstrdup(name, GFP_KERNEL), perm),
+			0);
+	cls->permissions.nprim++;
+}
+
+// one class "file" with "read" and "write", one attribute, two types
+static int sepolicy_test_init(struct kunit *test)
+{
+	struct test_policy *tp;
+	struct policydb *db;
+	struct class_datum *cls;
+	int i;
+
+	tp = kunit_kzalloc(test, sizeof(*tp), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, tp);
+	db = &tp->db;
+
+	KUNIT_ASSERT_EQ(test, symtab_init(&db->p_types, 256), 0);
+	KUNIT_ASSERT_EQ(test, symtab_init(&db->p_classes, 8), 0);
+	avtab_init(&db->te_avtab);
+	KUNIT_ASSERT_EQ(test, avtab_alloc(&db->te_avtab, 1024), 0);
+
+	cls = kzalloc(sizeof(*cls), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, cls);
+	KUNIT_ASSERT_EQ(test, symtab_init(&cls->permissions, 4), 0);
+	cls->value = ++db->p_classes.nprim;
+	KUNIT_ASSERT_EQ(test,
+			symtab_insert(&db->p_classes,
+				      kstrdup("file", GFP_KERNEL), cls),
+			0);
+	test_add_perm(test, cls, "read", 1);
+	test_add_perm(test, cls, "write", 2);
+
+	KUNIT_ASSERT_TRUE(test, ksu_attribute(db, "ksu_test_attr"));
+	KUNIT_ASSERT_TRUE(test, ksu_type(db, "ksu_test_a", "ksu_test_attr"));
+	KUNIT_ASSERT_TRUE(test, ksu_type(db, "ksu_test_b", "ksu_test_attr"));
+
+	for (i = 0; i < TEST_TYPES; i++)
+		snprintf(tp->names[i], TEST_TYPE_NAME_LEN, "ksu_test_t%d", i);
+
+	test->priv = tp;
+	return 0;
+}
+
+static void sepolicy_test_exit(struct kunit *test)
+{
+	struct test_policy *tp = test->priv;
+	struct policydb *db = &tp->db;
+	u32 i;
+
+	avtab_destroy(&db->te_avtab);
+	for (i = 0; i < db->p_types.nprim; i++)
+		ebitmap_destroy(&db->type_attr_map_array[i]);
+	kfree(db->type_attr_map_array);
+	kfree(db->type_val_to_struct);
+	// the names are the symtab keys, freed below
+	kfree(db->sym_val_to_name[SYM_TYPES]);
+	hashtab_map(&db->p_types.table, test_free_sym, NULL);
+	hashtab_destroy(&db->p_types.table);
+	hashtab_map(&db->p_classes.table, test_free_class, NULL);
+	hashtab_destroy(&db->p_classes.table);
+}
+
+// the allowed perms of src -> tgt:file, -1 when there is no rule at all
+static s64 test_allowed(struct policydb *db, const char *src, const char *tgt)
+{
+	struct type_datum *s = symtab_search(&db->p_types, src);
+	struct type_datum *t = symtab_search(&db->p_types, tgt);
+	struct avtab_key key = {
+		.source_type = s->value,
+		.target_type = t->value,
+		.target_class = 1,
+		.specified = AVTAB_ALLOWED,
+	};
+	struct avtab_node *node = avtab_search_node(&db->te_avtab, &key);
+
+	return node ? node->datum.u.data : -1;
+}
+
+static void ksu_test_sepolicy_allow(struct kunit *test)
+{
+	struct policydb *db = &((struct test_policy *)test->priv)->db;
+	u32 nel;
+
+	KUNIT_ASSERT_TRUE(test, ksu_allow(db, "ksu_test_a", "ksu_test_b",
+					  "file", "read"));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_a", "ksu_test_b"),
+			1LL);
+	nel = db->te_avtab.nel;
+
+	// a second perm lands in the same node
+	KUNIT_ASSERT_TRUE(test, ksu_allow(db, "ksu_test_a", "ksu_test_b",
+					  "file", "write"));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_a", "ksu_test_b"),
+			3LL);
+	KUNIT_EXPECT_EQ(test, db->te_avtab.nel, nel);
+
+	KUNIT_ASSERT_TRUE(test, ksu_deny(db, "ksu_test_a", "ksu_test_b",
+					 "file", "read"));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_a", "ksu_test_b"),
+			2LL);
+
+	// denying what was never allowed adds nothing
+	KUNIT_ASSERT_TRUE(test, ksu_deny(db, "ksu_test_b", "ksu_test_a",
+					 "file", "read"));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_b", "ksu_test_a"),
+			-1LL);
+	KUNIT_EXPECT_EQ(test, db->te_avtab.nel, nel);
+
+	// no perm means all of them
+	KUNIT_ASSERT_TRUE(test, ksu_allow(db, "ksu_test_b", "ksu_test_b",
+					  "file", ALL));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_b", "ksu_test_b"),
+			(s64)U32_MAX);
+}
+
+static void ksu_test_sepolicy_unknown(struct kunit *test)
+{
+	struct policydb *db = &((struct test_policy *)test->priv)->db;
+	u32 nel = db->te_avtab.nel;
+
+	KUNIT_EXPECT_FALSE(test, ksu_allow(db, "ksu_test_nope", "ksu_test_b",
+					   "file", "read"));
+	KUNIT_EXPECT_FALSE(test, ksu_allow(db, "ksu_test_a", "ksu_test_nope",
+					   "file", "read"));
+	KUNIT_EXPECT_FALSE(test, ksu_allow(db, "ksu_test_a", "ksu_test_b",
+					   "dir", "read"));
+	KUNIT_EXPECT_FALSE(test, ksu_allow(db, "ksu_test_a", "ksu_test_b",
+					   "file", "execute"));
+	KUNIT_EXPECT_FALSE(test, ksu_allow(db, "ksu_test_a", "ksu_test_b",
+					   ALL, "read"));
+	KUNIT_EXPECT_EQ(test, db->te_avtab.nel, nel);
+
+	// types can't be attributes and the other way round
+	KUNIT_EXPECT_FALSE(test, ksu_typeattribute(db, "ksu_test_attr",
+						   "ksu_test_attr"));
+	KUNIT_EXPECT_FALSE(test, ksu_typeattribute(db, "ksu_test_a",
+						   "ksu_test_b"));
+	KUNIT_EXPECT_TRUE(test, ksu_exists(db, "ksu_test_a"));
+	KUNIT_EXPECT_FALSE(test, ksu_exists(db, "ksu_test_nope"));
+}
+
+static void ksu_test_sepolicy_wildcard(struct kunit *test)
+{
+	struct policydb *db = &((struct test_policy *)test->priv)->db;
+
+	// an ALL source expands to the attributes only, which already cover
+	// every type that carries them
+	KUNIT_ASSERT_TRUE(test, ksu_allow(db, ALL, "ksu_test_b", "file",
+					  "read"));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_attr", "ksu_test_b"),
+			1LL);
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_a", "ksu_test_b"),
+			-1LL);
+
+	KUNIT_ASSERT_TRUE(test, ksu_allow(db, "ksu_test_a", ALL, "file",
+					  "write"));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_a", "ksu_test_attr"),
+			2LL);
+
+	// stripping with a wildcard only touches rules that exist
+	KUNIT_ASSERT_TRUE(test, ksu_deny(db, ALL, "ksu_test_b", "file",
+					 "read"));
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_attr", "ksu_test_b"),
+			0LL);
+	KUNIT_EXPECT_EQ(test, test_allowed(db, "ksu_test_b", "ksu_test_b"),
+			-1LL);
+}
+
+static void ksu_test_sepolicy_rehash(struct kunit *test)
+{
+	struct test_policy *tp = test->priv;
+	struct policydb *db = &tp->db;
+	struct avtab rebuilt;
+	struct avtab_node *cur, *node;
+	u32 i, j;
+
+	// start from a table sized for a handful of rules, as a tiny
+	// vendor policy would be
+	avtab_destroy(&db->te_avtab);
+	avtab_init(&db->te_avtab);
+	KUNIT_ASSERT_EQ(test, avtab_alloc(&db->te_avtab, 8), 0);
+	KUNIT_EXPECT_FALSE(test, ksu_avtab_need_rehash(&db->te_avtab));
+
+	for (i = 0; i < 8; i++)
+		KUNIT_ASSERT_TRUE(test, ksu_type(db, tp->names[i],
+						 "ksu_test_attr"));
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < 8; j++) {
+			KUNIT_ASSERT_TRUE(test,
+					  ksu_allow(db, tp->names[i],
+						    tp->names[j], "file",
+						    "read"));
+			// room to grow, but no chain long enough yet
+			if (i == 0 && j == 7)
+				KUNIT_EXPECT_FALSE(test,
+						   ksu_avtab_need_rehash(
+							   &db->te_avtab));
+		}
+	KUNIT_EXPECT_TRUE(test, ksu_avtab_can_grow(&db->te_avtab));
+	KUNIT_EXPECT_TRUE(test, ksu_avtab_need_rehash(&db->te_avtab));
+
+	KUNIT_ASSERT_EQ(test, ksu_avtab_rebuild(&rebuilt, &db->te_avtab), 0);
+	KUNIT_EXPECT_EQ(test, rebuilt.nel, db->te_avtab.nel);
+	KUNIT_EXPECT_GT(test, rebuilt.nslot, db->te_avtab.nslot);
+	KUNIT_EXPECT_FALSE(test, ksu_avtab_can_grow(&rebuilt));
+	KUNIT_EXPECT_FALSE(test, ksu_avtab_need_rehash(&rebuilt));
+
+	for (i = 0; i < db->te_avtab.nslot; i++) {
+		for (cur = db->te_avtab.htable[i]; cur; cur = cur->next) {
+			node = avtab_search_node(&rebuilt, &cur->key);
+			KUNIT_ASSERT_NOT_NULL(test, node);
+			KUNIT_EXPECT_EQ(test, node->datum.u.data,
+					cur->datum.u.data);
+		}
+	}
+	avtab_destroy(&rebuilt);
+}
+
+// rules.c inserts a few hundred rules at boot, often with wildcards
+static void ksu_test_sepolicy_bench(struct kunit *test)
+{
+	struct test_policy *tp = test->priv;
+	struct policydb *db = &tp->db;
+	u32 i, n = TEST_TYPES * TEST_TYPES;
+
+	for (i = 0; i < TEST_TYPES; i++)
+		KUNIT_ASSERT_TRUE(test, ksu_type(db, tp->names[i],
+						 "ksu_test_attr"));
+
+	i = 0;
+	KSU_BENCH(test, "ksu_allow/new", n, {
+		ksu_allow(db, tp->names[i / TEST_TYPES],
+			  tp->names[i % TEST_TYPES], "file", "read");
+		i++;
+	});
+	ksu_avtab_stats(&db->te_avtab, "test");
+
+	i = 0;
+	KSU_BENCH(test, "ksu_allow/existing", n, {
+		ksu_allow(db, tp->names[i / TEST_TYPES],
+			  tp->names[i % TEST_TYPES], "file", "write");
+		i++;
+	});
+
+	KSU_BENCH(test, "ksu_allow/wildcard", 100,
+		  ksu_allow(db, "ksu_test_a", ALL, "file", "read"));
+
+	KSU_BENCH(test, "ksu_allow/unknown", 10000,
+		  ksu_allow(db, "ksu_test_nope", "ksu_test_b", "file", "read"));
+}
+
+static struct kunit_case ksu_sepolicy_test_cases[] = {
+	KUNIT_CASE(ksu_test_sepolicy_allow),
+	KUNIT_CASE(ksu_test_sepolicy_unknown),
+	KUNIT_CASE(ksu_test_sepolicy_wildcard),
+	KUNIT_CASE(ksu_test_sepolicy_rehash),
+	KUNIT_CASE(ksu_test_sepolicy_bench),
+	{}
+};
+
+static struct kunit_suite ksu_sepolicy_test_suite = {
+	.name = "ksu_sepolicy",
+	.init = sepolicy_test_init,
+	.exit = sepolicy_test_exit,
+	.test_cases = ksu_sepolicy_test_cases,
+};
+
+kunit_test_suites(&ksu_sepolicy_test_suite);
+
+#endif
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-2.0
+// Included from throne_tracker.c when CONFIG_KSU_KUNIT_TEST is set.
+
+#include "ksu_test.h"
+
+static void test_free_uid_list(struct list_head *uid_list)
+{
+	struct uid_data *d, *n;
+
+	list_for_each_entry_safe (d, n, uid_list, list) {
+		list_del(&d->list);
+		kfree(d);
+	}
+}
+
+static void ksu_test_uid_list_parse(struct kunit *test)
+{
+	char buf[] = "10001 com.example.a\n"
+		     "\n"
+		     "  10002\tcom.example.b\n"
+		     "\r\n"
+		     "bogus com.example.c\n"
+		     "10004\n"
+		     "10005   \n"
+		     "10006 com.example.f";
+	struct uid_data *d;
+	LIST_HEAD(uid_list);
+
+	KUNIT_ASSERT_EQ(test, uid_from_um_buf(buf, &uid_list), 3);
+
+	d = list_first_entry(&uid_list, struct uid_data, list);
+	KUNIT_EXPECT_EQ(test, d->uid, (u32)10001);
+	KUNIT_EXPECT_STREQ(test, d->package, "com.example.a");
+	d = list_next_entry(d, list);
+	KUNIT_EXPECT_EQ(test, d->uid, (u32)10002);
+	KUNIT_EXPECT_STREQ(test, d->package, "com.example.b");
+	d = list_next_entry(d, list);
+	// the last line has no newline
+	KUNIT_EXPECT_EQ(test, d->uid, (u32)10006);
+	KUNIT_EXPECT_STREQ(test, d->package, "com.example.f");
+
+	test_free_uid_list(&uid_list);
+}
+
+static void ksu_test_uid_list_empty(struct kunit *test)
+{
+	char empty[] = "";
+	char blank[] = "\n \n\t\n";
+	LIST_HEAD(uid_list);
+	struct file *fp;
+
+	KUNIT_EXPECT_EQ(test, uid_from_um_buf(empty, &uid_list), 0);
+	KUNIT_EXPECT_EQ(test, uid_from_um_buf(blank, &uid_list), 0);
+	KUNIT_EXPECT_TRUE(test, list_empty(&uid_list));
+
+	// no uid_list on the test rootfs, the caller falls back to packages.list
+	fp = ksu_filp_open_compat(KSU_UID_LIST_PATH, O_RDONLY, 0);
+	if (!IS_ERR(fp)) {
+		filp_close(fp, NULL);
+		kunit_skip(test, "%s exists", KSU_UID_LIST_PATH);
+	}
+	KUNIT_EXPECT_LT(test, uid_from_um_list(&uid_list), 0);
+	KUNIT_EXPECT_TRUE(test, list_empty(&uid_list));
+}
+
+static void ksu_test_pkg_from_apk_path(struct kunit *test)
+{
+	char pkg[KSU_MAX_PACKAGE_NAME];
+
+	KUNIT_ASSERT_EQ(test,
+			get_pkg_from_apk_path(
+				pkg, "/data/app/~~Yn0Ok7b9ZZPKUMA==/"
+				     "com.sukisu.ultra-3Xk0sWv8ELe5Sg==/base.apk"),
+			0);
+	KUNIT_EXPECT_STREQ(test, pkg, "com.sukisu.ultra");
+
+	KUNIT_ASSERT_EQ(test,
+			get_pkg_from_apk_path(pkg,
+					      "/data/app/me.weishu.kernelsu-1/"
+					      "base.apk"),
+			0);
+	KUNIT_EXPECT_STREQ(test, pkg, "me.weishu.kernelsu");
+
+	// no hyphen in the package directory
+	KUNIT_EXPECT_LT(test,
+			get_pkg_from_apk_path(pkg, "/data/app/com.a/base.apk"),
+			0);
+	// the hyphen belongs to the file name, not the directory
+	KUNIT_EXPECT_LT(test,
+			get_pkg_from_apk_path(pkg, "/data/app/com.a/base-1.apk"),
+			0);
+	KUNIT_EXPECT_LT(test, get_pkg_from_apk_path(pkg, "base.apk"), 0);
+	KUNIT_EXPECT_LT(test, get_pkg_from_apk_path(pkg, "/-x/base.apk"), 0);
+	KUNIT_EXPECT_LT(test, get_pkg_from_apk_path(pkg, ""), 0);
+}
+
+// uid_list sizes seen on devices run from a few hundred to a few thousand
+static void ksu_test_throne_bench(struct kunit *test)
+{
+	static const int sizes[] = { 100, 1000, 5000 };
+	char name[32], *src, *buf;
+	size_t len, cap;
+	int i, j, n;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		n = sizes[i];
+		cap = n * 32 + 1;
+		src = kunit_kmalloc(test, cap, GFP_KERNEL);
+		buf = kunit_kmalloc(test, cap, GFP_KERNEL);
+		KUNIT_ASSERT_NOT_NULL(test, src);
+		KUNIT_ASSERT_NOT_NULL(test, buf);
+
+		for (j = 0, len = 0; j < n; j++)
+			len += scnprintf(src + len, cap - len,
+					 "%d com.example.pkg%d\n", 10000 + j, j);
+
+		snprintf(name, sizeof(name), "uid_from_um_buf/%d", n);
+		KSU_BENCH(test, name, 100, {
+			LIST_HEAD(uid_list);
+
+			memcpy(buf, src, len + 1);
+			KUNIT_EXPECT_EQ(test, uid_from_um_buf(buf, &uid_list), n);
+			test_free_uid_list(&uid_list);
+		});
+	}
+
+	KSU_BENCH(test, "get_pkg_from_apk_path", 100000, {
+		char pkg[KSU_MAX_PACKAGE_NAME];
+
+		get_pkg_from_apk_path(pkg,
+				      "/data/app/~~Yn0Ok7b9ZZPKUMA==/"
+				      "com.sukisu.ultra-3Xk0sWv8ELe5Sg==/base.apk");
+	});
+}
+
+static struct kunit_case ksu_throne_tracker_test_cases[] = {
+	KUNIT_CASE(ksu_test_uid_list_parse),
+	KUNIT_CASE(ksu_test_uid_list_empty),
+	KUNIT_CASE(ksu_test_pkg_from_apk_path),
+	KUNIT_CASE(ksu_test_throne_bench),
+	{}
+};
+
+static struct kunit_suite ksu_throne_tracker_test_suite = {
+	.name = "ksu_throne_tracker",
+	.test_cases = ksu_throne_tracker_test_cases,
+};
+
+kunit_test_suites(&ksu_throne_tracker_test_suite);
@@ -31,6 +31,45 @@ struct uid_data {
 	char package[KSU_MAX_PACKAGE_NAME];
 };
 
+// Parse "<uid> <package>" lines, buf is modified in place
+static int uid_from_um_buf(char *buf, struct list_head *uid_list)
+{
+	int cnt = 0;
+
+	for (char *line = buf, *next; line; line = next) {
+		next = strchr(line, '\n');
+		if (next) *next++ = '\0';
+
+		while (*line == ' ' || *line == '\t' || *line == '\r') ++line;
+		if (!*line) continue;
+
+		char *uid_str = strsep(&line, " \t");
+		char *pkg     = line;
+		if (!pkg) continue;
+		while (*pkg == ' ' || *pkg == '\t') ++pkg;
+		if (!*pkg)   continue;
+
+		u32 uid;
+		if (kstrtou32(uid_str, 10, &uid)) {
+			pr_warn_once("uid_list: bad uid <%s>\n", uid_str);
+			continue;
+		}
+
+		struct uid_data *d = kzalloc(sizeof(*d), GFP_ATOMIC);
+		if (unlikely(!d)) {
+			pr_err("uid_list: OOM uid=%u\n", uid);
+			continue;
+		}
+
+		d->uid = uid;
+		strscpy(d->package, pkg, KSU_MAX_PACKAGE_NAME);
+		list_add_tail(&d->list, uid_list);
+		++cnt;
+	}
+
+	return cnt;
+}
+
 // Try read /data/misc/user_uid/uid_list
 static int uid_from_um_list(struct list_head *uid_list)
 {
@@ -38,7 +77,7 @@ static int uid_from_um_list(struct list_head *uid_list)
 	char *buf = NULL;
 	loff_t size, pos = 0;
 	ssize_t nr;
-	int cnt = 0;
+	int cnt;
 
 	fp = ksu_filp_open_compat(KSU_UID_LIST_PATH, O_RDONLY, 0);
 	if (IS_ERR(fp))
@@ -66,36 +105,7 @@ static int uid_from_um_list(struct list_head *uid_list)
 	}
 	buf[size] = '\0';
 
-	for (char *line = buf, *next; line; line = next) {
-		next = strchr(line, '\n');
-		if (next) *next++ = '\0';
-
-		while (*line == ' ' || *line == '\t' || *line == '\r') ++line;
-		if (!*line) continue;
-
-		char *uid_str = strsep(&line, " \t");
-		char *pkg     = line;
-		if (!pkg) continue;
-		while (*pkg == ' ' || *pkg == '\t') ++pkg;
-		if (!*pkg)   continue;
-
-		u32 uid;
-		if (kstrtou32(uid_str, 10, &uid)) {
-			pr_warn_once("uid_list: bad uid <%s>\n", uid_str);
-			continue;
-		}
-
-		struct uid_data *d = kzalloc(sizeof(*d), GFP_ATOMIC);
-		if (unlikely(!d)) {
-			pr_err("uid_list: OOM uid=%u\n", uid);
-			continue;
-		}
-
-		d->uid = uid;
-		strscpy(d->package, pkg, KSU_MAX_PACKAGE_NAME);
-		list_add_tail(&d->list, uid_list);
-		++cnt;
-	}
+	cnt = uid_from_um_buf(buf, uid_list);
 
 	kfree(buf);
 	pr_info("uid_list: loaded %d entries\n", cnt);
@@ -645,3 +655,7 @@ void ksu_throne_tracker_exit()
 {
 	// nothing to do
 }
+
+#ifdef CONFIG_KSU_KUNIT_TEST
+#include "tests/throne_tracker_test.c"
+#endif
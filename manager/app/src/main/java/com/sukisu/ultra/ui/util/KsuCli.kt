@@ -20,6 +20,7 @@ import com.sukisu.ultra.BuildConfig
 import com.sukisu.ultra.Natives
 import com.sukisu.ultra.ksuApp
 import org.json.JSONArray
+import org.json.JSONObject
 import java.io.File
 
 
@@ -29,7 +30,7 @@ import java.io.File
  */
 private const val TAG = "KsuCli"
 
-private fun getKsuDaemonPath(): String {
+fun getKsuDaemonPath(): String {
     return ksuApp.applicationInfo.nativeLibraryDir + File.separator + "libksud.so"
 }
 
@@ -97,6 +98,16 @@ fun execKsud(args: String, newShell: Boolean = false): Boolean {
     }
 }
 
+// Outcome of a mutating call through the ksud daemon, null if it is not running
+private fun ksudRpcResult(method: String, params: JSONObject): Boolean? {
+    return try {
+        KsudClient.call(method, params)?.let { true }
+    } catch (e: KsudClient.KsudException) {
+        Log.w(TAG, "$method failed: ${e.message}")
+        false
+    }
+}
+
 fun install() {
     val start = SystemClock.elapsedRealtime()
     val magiskboot = File(ksuApp.applicationInfo.nativeLibraryDir, "libmagiskboot.so").absolutePath
@@ -105,13 +116,30 @@ fun install() {
 }
 
 fun listModules(): String {
+    (KsudClient.callOrNull("module.list") as? JSONArray)?.let { return it.toString() }
+
     val shell = getRootShell()
 
     val out =
-        shell.newJob().add("${getKsuDaemonPath()} module list").to(ArrayList(), null).exec().out
+        shell.newJob().add("${getKsuDaemonPath()} module list --compact").to(ArrayList(), null).exec().out
     return out.joinToString("\n").ifBlank { "[]" }
 }
 
+fun getModuleSizes(): Map<String, Long> {
+    (KsudClient.callOrNull("module.sizes") as? JSONObject)?.let { json ->
+        return json.keys().asSequence().associateWith { json.getLong(it) }
+    }
+
+    val shell = getRootShell()
+
+    val out =
+        shell.newJob().add("${getKsuDaemonPath()} module sizes").to(ArrayList(), null).exec().out
+    return runCatching {
+        val json = JSONObject(out.joinToString("\n"))
+        json.keys().asSequence().associateWith { json.getLong(it) }
+    }.getOrElse { emptyMap() }
+}
+
 fun getModuleCount(): Int {
     val result = listModules()
     runCatching {
@@ -130,21 +158,24 @@ fun toggleModule(id: String, enable: Boolean): Boolean {
     } else {
         "module disable $id"
     }
-    val result = execKsud(cmd, true)
+    val method = if (enable) "module.enable" else "module.disable"
+    val result = ksudRpcResult(method, JSONObject().put("id", id)) ?: execKsud(cmd, true)
     Log.i(TAG, "$cmd result: $result")
     return result
 }
 
 fun uninstallModule(id: String): Boolean {
     val cmd = "module uninstall $id"
-    val result = execKsud(cmd, true)
+    val result = ksudRpcResult("module.uninstall", JSONObject().put("id", id))
+        ?: execKsud(cmd, true)
     Log.i(TAG, "uninstall module $id result: $result")
     return result
 }
 
 fun restoreModule(id: String): Boolean {
     val cmd = "module restore $id"
-    val result = execKsud(cmd, true)
+    val result = ksudRpcResult("module.restore", JSONObject().put("id", id))
+        ?: execKsud(cmd, true)
     Log.i(TAG, "restore module $id result: $result")
     return result
 }
@@ -378,6 +409,9 @@ fun isSepolicyValid(rules: String?): Boolean {
 }
 
 fun getSepolicy(pkg: String): String {
+    (KsudClient.callOrNull("profile.get_sepolicy", JSONObject().put("package", pkg)) as? String)
+        ?.let { return it }
+
     val shell = getRootShell()
     val result =
         shell.newJob().add("${getKsuDaemonPath()} profile get-sepolicy $pkg").to(ArrayList(), null)
@@ -387,6 +421,11 @@ fun getSepolicy(pkg: String): String {
 }
 
 fun setSepolicy(pkg: String, rules: String): Boolean {
+    ksudRpcResult(
+        "profile.set_sepolicy",
+        JSONObject().put("package", pkg).put("policy", rules)
+    )?.let { return it }
+
     val shell = getRootShell()
     val result = shell.newJob().add("${getKsuDaemonPath()} profile set-sepolicy $pkg '$rules'")
         .to(ArrayList(), null).exec()
@@ -395,18 +434,30 @@ fun setSepolicy(pkg: String, rules: String): Boolean {
 }
 
 fun listAppProfileTemplates(): List<String> {
+    (KsudClient.callOrNull("profile.list_templates") as? JSONArray)?.let { ids ->
+        return List(ids.length()) { ids.getString(it) }
+    }
+
     val shell = getRootShell()
     return shell.newJob().add("${getKsuDaemonPath()} profile list-templates").to(ArrayList(), null)
         .exec().out
 }
 
 fun getAppProfileTemplate(id: String): String {
+    (KsudClient.callOrNull("profile.get_template", JSONObject().put("id", id)) as? String)
+        ?.let { return it }
+
     val shell = getRootShell()
     return shell.newJob().add("${getKsuDaemonPath()} profile get-template '${id}'")
         .to(ArrayList(), null).exec().out.joinToString("\n")
 }
 
 fun setAppProfileTemplate(id: String, template: String): Boolean {
+    ksudRpcResult(
+        "profile.set_template",
+        JSONObject().put("id", id).put("template", template)
+    )?.let { return it }
+
     val shell = getRootShell()
     val escapedTemplate = template.replace("\"", "\\\"")
     val cmd = """${getKsuDaemonPath()} profile set-template "$id" "$escapedTemplate'""""
@@ -415,6 +466,8 @@ fun setAppProfileTemplate(id: String, template: String): Boolean {
 }
 
 fun deleteAppProfileTemplate(id: String): Boolean {
+    ksudRpcResult("profile.delete_template", JSONObject().put("id", id))?.let { return it }
+
     val shell = getRootShell()
     return shell.newJob().add("${getKsuDaemonPath()} profile delete-template '${id}'")
         .to(ArrayList(), null).exec().isSuccess
@@ -433,6 +486,8 @@ fun unloadKpmModule(name: String): String {
 }
 
 fun getKpmModuleCount(): Int {
+    (KsudClient.callOrNull("kpm.num") as? Int)?.let { return it }
+
     val shell = getRootShell()
     val cmd = "${getKsuDaemonPath()} kpm num"
     val result = ShellUtils.fastCmd(shell, cmd)
@@ -448,6 +503,8 @@ fun runCmd(shell: Shell, cmd: String): String {
 }
 
 fun listKpmModules(): String {
+    (KsudClient.callOrNull("kpm.list") as? String)?.let { return it.trim() }
+
     val shell = getRootShell()
     val cmd = "${getKsuDaemonPath()} kpm list"
     return try {
@@ -459,6 +516,9 @@ fun listKpmModules(): String {
 }
 
 fun getKpmModuleInfo(name: String): String {
+    (KsudClient.callOrNull("kpm.info", JSONObject().put("name", name)) as? String)
+        ?.let { return it.trim() }
+
     val shell = getRootShell()
     val cmd = "${getKsuDaemonPath()} kpm info $name"
     return try {
@@ -477,6 +537,8 @@ fun controlKpmModule(name: String, args: String? = null): Int {
 }
 
 fun getKpmVersion(): String {
+    (KsudClient.callOrNull("kpm.version") as? String)?.let { return it.trim() }
+
     val shell = getRootShell()
     val cmd = "${getKsuDaemonPath()} kpm version"
     val result = ShellUtils.fastCmd(shell, cmd)
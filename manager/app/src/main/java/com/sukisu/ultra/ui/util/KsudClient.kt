@@ -0,0 +1,142 @@
+package com.sukisu.ultra.ui.util
+
+import android.net.LocalSocket
+import android.net.LocalSocketAddress
+import android.os.ParcelFileDescriptor
+import android.system.Os
+import android.util.Log
+import org.json.JSONObject
+import java.io.BufferedReader
+import java.io.FileDescriptor
+import java.io.IOException
+import java.io.InputStreamReader
+import java.io.OutputStream
+import java.util.concurrent.Semaphore
+import java.util.concurrent.atomic.AtomicLong
+
+/**
+ * Client for the `ksud daemon` socket: one JSON request per line, one
+ * JSON response per line. Every call returns null when the daemon is not
+ * reachable, callers then fall back to running ksud in the root shell.
+ */
+object KsudClient {
+    private const val TAG = "KsudClient"
+    private const val SOCKET_NAME = "ksud_rpc"
+    // the daemon answers each connection in order on a thread of its own,
+    // so concurrent calls need connections of their own
+    private const val MAX_CONNECTIONS = 4
+
+    private class Connection(val socket: LocalSocket) {
+        val reader = BufferedReader(InputStreamReader(socket.inputStream))
+        val writer: OutputStream = socket.outputStream
+
+        fun close() {
+            runCatching { socket.close() }
+        }
+    }
+
+    private val permits = Semaphore(MAX_CONNECTIONS)
+    private val idle = ArrayDeque<Connection>()
+    private val nextId = AtomicLong()
+
+    private fun connect(): Connection? {
+        val s = LocalSocket()
+        return try {
+            s.connect(LocalSocketAddress(SOCKET_NAME, LocalSocketAddress.Namespace.ABSTRACT))
+            Connection(s)
+        } catch (e: IOException) {
+            runCatching { s.close() }
+            null
+        }
+    }
+
+    private fun takeConnection(fresh: Boolean): Connection? {
+        if (!fresh) synchronized(idle) { idle.removeFirstOrNull() }?.let { return it }
+        return connect()
+    }
+
+    private fun returnConnection(connection: Connection) {
+        // never more idle than could be in use at once
+        val kept = synchronized(idle) { idle.size < MAX_CONNECTIONS && idle.add(connection) }
+        if (!kept) connection.close()
+    }
+
+    // the raw response to [method] and the fds sent along with it
+    private fun request(
+        method: String,
+        params: JSONObject
+    ): Pair<JSONObject, Array<FileDescriptor>?>? {
+        permits.acquire()
+        try {
+            // one retry on a new connection, the daemon may have been
+            // restarted since the pooled one was opened
+            repeat(2) { attempt ->
+                val connection = takeConnection(fresh = attempt > 0) ?: return null
+                val request = JSONObject()
+                    .put("id", nextId.getAndIncrement())
+                    .put("method", method)
+                    .put("params", params)
+                try {
+                    connection.writer.write((request.toString() + "\n").toByteArray())
+                    connection.writer.flush()
+                    val line = connection.reader.readLine()
+                        ?: throw IOException("ksud daemon closed")
+                    val fds = connection.socket.ancillaryFileDescriptors
+                    returnConnection(connection)
+                    return JSONObject(line) to fds
+                } catch (e: IOException) {
+                    Log.w(TAG, "$method: ${e.message}")
+                    connection.close()
+                }
+            }
+            return null
+        } finally {
+            permits.release()
+        }
+    }
+
+    /**
+     * Call [method], returning its `result` (a String, Int, Boolean,
+     * JSONObject or JSONArray), or null if the daemon is unavailable.
+     * Errors reported by the daemon are thrown as [KsudException].
+     */
+    fun call(method: String, params: JSONObject = JSONObject()): Any? {
+        val (response, _) = request(method, params) ?: return null
+        if (response.has("error")) {
+            throw KsudException(response.getString("error"))
+        }
+        return response.opt("result")
+    }
+
+    /**
+     * Like [call] for methods that answer with a file, returning the
+     * result together with the received descriptor.
+     */
+    @Throws(KsudException::class)
+    fun callForFd(
+        method: String,
+        params: JSONObject = JSONObject()
+    ): Pair<JSONObject, ParcelFileDescriptor>? {
+        val (response, fds) = request(method, params) ?: return null
+        val pfd = fds?.firstOrNull()?.let { fd ->
+            ParcelFileDescriptor.dup(fd).also { Os.close(fd) }
+        }
+        if (response.has("error")) {
+            pfd?.close()
+            throw KsudException(response.getString("error"))
+        }
+        pfd ?: throw KsudException("$method: no file descriptor received")
+        return response.getJSONObject("result") to pfd
+    }
+
+    fun callOrNull(method: String, params: JSONObject = JSONObject()): Any? {
+        return try {
+            call(method, params)
+        } catch (e: KsudException) {
+            Log.w(TAG, "$method failed: ${e.message}")
+            null
+        }
+    }
+
+    class KsudException(message: String) : Exception(message)
+}
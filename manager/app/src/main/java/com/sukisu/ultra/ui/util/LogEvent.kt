@@ -25,7 +25,7 @@ fun getBugreportFile(context: Context): File {
     // Xiaomi/Readmi devices have diag in /data/vendor/diag
     val diagFile = File(bugreportDir, "diag.tar.gz")
     val oplusFile = File(bugreportDir, "oplus.tar.gz")
-    val bootlogFile = File(bugreportDir, "bootlog.tar.gz")
+    val bootlogFile = File(bugreportDir, "bootlog.tar")
     val mountsFile = File(bugreportDir, "mounts.txt")
     val fileSystemsFile = File(bugreportDir, "filesystems.txt")
     val adbFileTree = File(bugreportDir, "adb_tree.txt")
@@ -47,7 +47,8 @@ fun getBugreportFile(context: Context): File {
     shell.newJob().add("tar -czf ${pstoreFile.absolutePath} -C /sys/fs/pstore .").exec()
     shell.newJob().add("tar -czf ${diagFile.absolutePath} -C /data/vendor/diag . --exclude=./minidump.gz").exec()
     shell.newJob().add("tar -czf ${oplusFile.absolutePath} -C /mnt/oplus/op2/media/log/boot_log/ .").exec()
-    shell.newJob().add("tar -czf ${bootlogFile.absolutePath} -C /data/adb/ksu/log .").exec()
+    // boot logs are already gzip segments, no need to compress them again
+    shell.newJob().add("tar -cf ${bootlogFile.absolutePath} -C /data/adb/ksu/log .").exec()
 
     shell.newJob().add("cat /proc/1/mountinfo > ${mountsFile.absolutePath}").exec()
     shell.newJob().add("cat /proc/filesystems > ${fileSystemsFile.absolutePath}").exec()
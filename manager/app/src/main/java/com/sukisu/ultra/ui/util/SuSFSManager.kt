@@ -54,12 +54,15 @@ object SuSFSManager {
 
     // 常量
     private const val SUSFS_BINARY_TARGET_NAME = "ksu_susfs"
+    private const val SUSFSD_TARGET_PATH = "/data/adb/ksu/bin/susfsd"
     private const val DEFAULT_UNAME = "default"
     private const val DEFAULT_BUILD_TIME = "default"
     private const val MODULE_ID = "susfs_manager"
     private const val MODULE_PATH = "/data/adb/modules/$MODULE_ID"
     private const val MIN_VERSION_FOR_HIDE_MOUNT = "1.5.8"
     private const val MIN_VERSION_FOR_LOOP_PATH = "1.5.9"
+    // susfsd batch在内核SuSFS版本没有已知结构布局时的退出码，需逐条调用ksu_susfs
+    const val BATCH_UNSUPPORTED = 2
     private const val BACKUP_FILE_EXTENSION = ".susfs_backup"
     private const val MEDIA_DATA_PATH = "/data/media/0/Android/data"
     private const val CGROUP_UID_PATH_PREFIX = "/sys/fs/cgroup/uid_"
@@ -142,6 +145,7 @@ object SuSFSManager {
      */
     data class ModuleConfig(
         val targetPath: String,
+        val batchPath: String,
         val unameValue: String,
         val buildTimeValue: String,
         val executeInPostFsData: Boolean,
@@ -252,6 +256,7 @@ object SuSFSManager {
     private fun getCurrentModuleConfig(context: Context): ModuleConfig {
         return ModuleConfig(
             targetPath = getSuSFSTargetPath(),
+            batchPath = SUSFSD_TARGET_PATH,
             unameValue = getUnameValue(context),
             buildTimeValue = getBuildTimeValue(context),
             executeInPostFsData = getExecuteInPostFsData(context),
@@ -608,6 +613,9 @@ object SuSFSManager {
             // 还原所有配置
             restoreConfigurations(context, backupData.configurations)
 
+            // 立即批量应用还原的路径、挂载和卸载配置
+            applyBatch(context)
+
             // 如果自启动已启用，更新模块
             if (isAutoStartEnabled(context)) {
                 updateMagiskModule(context)
@@ -793,15 +801,65 @@ object SuSFSManager {
             val moduleProp = ScriptGenerator.generateModuleProp(MODULE_ID)
             if (!runCmdWithResult("cat > $MODULE_PATH/module.prop << 'EOF'\n$moduleProp\nEOF").isSuccess) return@withContext false
 
-            // 生成并创建所有脚本文件
+            // 启动脚本通过susfsd批量应用配置
+            val daemonPath = getSuSFSDaemonPath()
+            if (!runCmdWithResult("cp '$daemonPath' '$SUSFSD_TARGET_PATH' && chmod 755 '$SUSFSD_TARGET_PATH'").isSuccess) {
+                return@withContext false
+            }
+
+            // 生成并在一次shell调用中创建所有脚本文件
             val scripts = ScriptGenerator.generateAllScripts(config)
+            val writeScripts = scripts.entries.joinToString("\n") { (filename, content) ->
+                "cat > $MODULE_PATH/$filename << 'EOF'\n$content\nEOF\nchmod 755 $MODULE_PATH/$filename"
+            }
+            // 在子shell中set -e，避免影响常驻的root shell
+            runCmdWithResult("(\nset -e\n$writeScripts\n)").isSuccess
+        } catch (e: Exception) {
+            e.printStackTrace()
+            false
+        }
+    }
 
-            scripts.all { (filename, content) ->
-                runCmdWithResult("cat > $MODULE_PATH/$filename << 'EOF'\n$content\nEOF").isSuccess &&
-                        runCmdWithResult("chmod 755 $MODULE_PATH/$filename").isSuccess
+    /**
+     * 批量应用当前的SUS路径、循环路径、挂载和尝试卸载配置
+     * 所有条目在同一个susfsd进程中完成，而不是每条启动一个命令
+     */
+    suspend fun applyBatch(context: Context): Boolean = withContext(Dispatchers.IO) {
+        try {
+            val config = getCurrentModuleConfig(context)
+            val batch = ScriptGenerator.generateBatch(
+                config.susPaths, config.susLoopPaths, config.susMounts, config.tryUmounts
+            )
+            if (batch.isEmpty()) return@withContext true
+
+            // 1.5.8需要先设置路径配置
+            if (config.support158 && (config.susPaths.isNotEmpty() || config.susLoopPaths.isNotEmpty())) {
+                executeSusfsCommand(context, "set_android_data_root_path '${config.androidDataPath}'")
+                executeSusfsCommand(context, "set_sdcard_root_path '${config.sdcardPath}'")
             }
+
+            val eof = ScriptGenerator.BATCH_EOF
+            val job = Shell.getShell().newJob()
+                .add("${getSuSFSDaemonPath()} batch - << '$eof'\n$batch$eof").exec()
+            if (job.code == BATCH_UNSUPPORTED) {
+                // 内核SuSFS版本不支持批量操作，逐条回退到ksu_susfs
+                return@withContext batch.lines().filter { it.isNotEmpty() }.map { line ->
+                    val op = line.substringBefore(' ')
+                    val args = line.substringAfter(' ')
+                    if (op == "add_try_umount") {
+                        executeSusfsCommand(context, "$op '${args.substringBeforeLast(' ')}' ${args.substringAfterLast(' ')}")
+                    } else {
+                        executeSusfsCommand(context, "$op '$args'")
+                    }
+                }.all { it }
+            }
+            if (!job.isSuccess) {
+                showToast(context, "${context.getString(R.string.susfs_command_failed)}\n${job.out.joinToString("\n")}\n${job.err.joinToString("\n")}")
+            }
+            job.isSuccess
         } catch (e: Exception) {
             e.printStackTrace()
+            showToast(context, context.getString(R.string.susfs_command_error, e.message ?: "Unknown error"))
             false
         }
     }
@@ -13,6 +13,9 @@ object ScriptGenerator {
     private const val DEFAULT_BUILD_TIME = "default"
     private const val LOG_DIR = "/data/adb/ksu/log"
 
+    // 批量操作heredoc的结束标记，不能与写入脚本时使用的EOF冲突
+    const val BATCH_EOF = "SUSFS_BATCH"
+
     /**
      * 生成所有脚本文件
      */
@@ -41,15 +44,64 @@ object ScriptGenerator {
     """.trimIndent()
 
     // 二进制文件检查的通用脚本片段
-    private fun generateBinaryCheck(targetPath: String): String = """
+    private fun generateBinaryCheck(targetPath: String, batchPath: String): String = """
         # 检查SuSFS二进制文件
         SUSFS_BIN="$targetPath"
+        SUSFSD_BIN="$batchPath"
         if [ ! -f "${'$'}SUSFS_BIN" ]; then
             echo "$(get_current_time): SuSFS二进制文件未找到: ${'$'}SUSFS_BIN" >> "${'$'}LOG_FILE"
             exit 1
         fi
+        
+        # 从标准输入读取批量操作，用susfsd一次应用
+        # susfsd缺失或内核SuSFS版本没有已知的结构布局（退出码${SuSFSManager.BATCH_UNSUPPORTED}）时逐条调用ksu_susfs
+        apply_batch() {
+            batch=${'$'}(cat)
+            if [ -f "${'$'}SUSFSD_BIN" ]; then
+                printf '%s\n' "${'$'}batch" | "${'$'}SUSFSD_BIN" batch - >> "${'$'}LOG_FILE" 2>&1
+                if [ ${'$'}? -ne ${SuSFSManager.BATCH_UNSUPPORTED} ]; then
+                    return
+                fi
+            fi
+            printf '%s\n' "${'$'}batch" | while read -r op args; do
+                case "${'$'}op" in
+                    add_try_umount) "${'$'}SUSFS_BIN" "${'$'}op" "${'$'}{args% *}" "${'$'}{args##* }" ;;
+                    add_*) "${'$'}SUSFS_BIN" "${'$'}op" "${'$'}args" ;;
+                esac
+            done >> "${'$'}LOG_FILE" 2>&1
+        }
     """.trimIndent()
 
+    /**
+     * 生成susfsd的批量操作内容，每行一个操作
+     */
+    fun generateBatch(
+        susPaths: Set<String> = emptySet(),
+        susLoopPaths: Set<String> = emptySet(),
+        susMounts: Set<String> = emptySet(),
+        tryUmounts: Set<String> = emptySet()
+    ): String = buildString {
+        susPaths.forEach { appendLine("add_sus_path $it") }
+        susLoopPaths.forEach { appendLine("add_sus_path_loop $it") }
+        susMounts.forEach { appendLine("add_sus_mount $it") }
+        tryUmounts.forEach { umount ->
+            val parts = umount.split("|")
+            if (parts.size == 2) {
+                appendLine("add_try_umount ${parts[0]} ${parts[1]}")
+            }
+        }
+    }
+
+    // 在一个susfsd进程中应用整批操作，不支持时由apply_batch逐条回退
+    private fun StringBuilder.generateBatchSection(title: String, count: Int, batch: String) {
+        appendLine("# $title")
+        appendLine("apply_batch << '$BATCH_EOF'")
+        append(batch)
+        appendLine(BATCH_EOF)
+        appendLine("echo \"$(get_current_time): $title: $count 项\" >> \"${'$'}LOG_FILE\"")
+        appendLine()
+    }
+
     /**
      * 生成service.sh脚本内容
      */
@@ -62,7 +114,7 @@ object ScriptGenerator {
             appendLine()
             appendLine(generateLogSetup("susfs_service.log"))
             appendLine()
-            appendLine(generateBinaryCheck(config.targetPath))
+            appendLine(generateBinaryCheck(config.targetPath, config.batchPath))
             appendLine()
 
             if (shouldConfigureInService(config)) {
@@ -127,23 +179,13 @@ object ScriptGenerator {
 
     private fun StringBuilder.generateSusPathsSection(susPaths: Set<String>) {
         if (susPaths.isNotEmpty()) {
-            appendLine("# 添加SUS路径")
-            susPaths.forEach { path ->
-                appendLine("\"${'$'}SUSFS_BIN\" add_sus_path '$path'")
-                appendLine("echo \"$(get_current_time): 添加SUS路径: $path\" >> \"${'$'}LOG_FILE\"")
-            }
-            appendLine()
+            generateBatchSection("添加SUS路径", susPaths.size, generateBatch(susPaths = susPaths))
         }
     }
 
     private fun StringBuilder.generateSusLoopPathsSection(susLoopPaths: Set<String>) {
         if (susLoopPaths.isNotEmpty()) {
-            appendLine("# 添加SUS循环路径")
-            susLoopPaths.forEach { path ->
-                appendLine("\"${'$'}SUSFS_BIN\" add_sus_path_loop '$path'")
-                appendLine("echo \"$(get_current_time): 添加SUS循环路径: $path\" >> \"${'$'}LOG_FILE\"")
-            }
-            appendLine()
+            generateBatchSection("添加SUS循环路径", susLoopPaths.size, generateBatch(susLoopPaths = susLoopPaths))
         }
     }
 
@@ -379,7 +421,7 @@ object ScriptGenerator {
             appendLine()
             appendLine(generateLogSetup("susfs_post_fs_data.log"))
             appendLine()
-            appendLine(generateBinaryCheck(config.targetPath))
+            appendLine(generateBinaryCheck(config.targetPath, config.batchPath))
             appendLine()
             appendLine("echo \"$(get_current_time): Post-FS-Data脚本开始执行\" >> \"${'$'}LOG_FILE\"")
             appendLine()
@@ -425,32 +467,17 @@ object ScriptGenerator {
             appendLine()
             appendLine("echo \"$(get_current_time): Post-Mount脚本开始执行\" >> \"${'$'}LOG_FILE\"")
             appendLine()
-            appendLine(generateBinaryCheck(config.targetPath))
+            appendLine(generateBinaryCheck(config.targetPath, config.batchPath))
             appendLine()
 
             // 添加SUS挂载
             if (config.susMounts.isNotEmpty()) {
-                appendLine("# 添加SUS挂载")
-                config.susMounts.forEach { mount ->
-                    appendLine("\"${'$'}SUSFS_BIN\" add_sus_mount '$mount'")
-                    appendLine("echo \"$(get_current_time): 添加SUS挂载: $mount\" >> \"${'$'}LOG_FILE\"")
-                }
-                appendLine()
+                generateBatchSection("添加SUS挂载", config.susMounts.size, generateBatch(susMounts = config.susMounts))
             }
 
             // 添加尝试卸载
             if (config.tryUmounts.isNotEmpty()) {
-                appendLine("# 添加尝试卸载")
-                config.tryUmounts.forEach { umount ->
-                    val parts = umount.split("|")
-                    if (parts.size == 2) {
-                        val path = parts[0]
-                        val mode = parts[1]
-                        appendLine("\"${'$'}SUSFS_BIN\" add_try_umount '$path' $mode")
-                        appendLine("echo \"$(get_current_time): 添加尝试卸载: $path (模式: $mode)\" >> \"${'$'}LOG_FILE\"")
-                    }
-                }
-                appendLine()
+                generateBatchSection("添加尝试卸载", config.tryUmounts.size, generateBatch(tryUmounts = config.tryUmounts))
             }
 
             appendLine("echo \"$(get_current_time): Post-Mount脚本执行完成\" >> \"${'$'}LOG_FILE\"")
@@ -471,7 +498,7 @@ object ScriptGenerator {
             appendLine()
             appendLine("echo \"$(get_current_time): Boot-Completed脚本开始执行\" >> \"${'$'}LOG_FILE\"")
             appendLine()
-            appendLine(generateBinaryCheck(config.targetPath))
+            appendLine(generateBinaryCheck(config.targetPath, config.batchPath))
             appendLine()
 
             // 仅在支持隐藏挂载功能时执行相关配置
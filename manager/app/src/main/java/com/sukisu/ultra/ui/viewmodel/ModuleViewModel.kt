@@ -15,6 +15,7 @@ import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.launch
 import com.sukisu.ultra.ui.util.HanziToPinyin
 import com.sukisu.ultra.ui.util.listModules
+import com.sukisu.ultra.ui.util.getModuleSizes
 import com.sukisu.ultra.ui.util.getRootShell
 import com.sukisu.ultra.ui.util.ModuleVerificationManager
 import kotlinx.coroutines.withContext
@@ -401,8 +402,9 @@ class ModuleSizeCache(context: Context) {
             val newModules = currentModules.filter { !sizeCache.containsKey(it) }
             if (newModules.isNotEmpty()) {
                 Log.d(TAG, "发现 ${newModules.size} 个新模块，计算大小: $newModules")
+                val sizes = getModuleSizes()
                 for (dirId in newModules) {
-                    val size = calculateModuleFolderSize(dirId)
+                    val size = sizes[dirId] ?: calculateModuleFolderSize(dirId)
                     sizeCache[dirId] = size
                     Log.d(TAG, "新模块 $dirId 大小: ${formatFileSize(size)}")
                 }
@@ -424,9 +426,10 @@ class ModuleSizeCache(context: Context) {
                 Log.d(TAG, "清理了 ${toRemove.size} 个不存在的模块缓存: $toRemove")
             }
 
-            // 计算所有当前模块的大小
+            // 计算所有当前模块的大小，ksud 一次返回全部结果
+            val sizes = getModuleSizes()
             for (dirId in currentModules) {
-                val size = calculateModuleFolderSize(dirId)
+                val size = sizes[dirId] ?: calculateModuleFolderSize(dirId)
                 sizeCache[dirId] = size
                 Log.d(TAG, "更新模块 $dirId 大小: ${formatFileSize(size)}")
             }
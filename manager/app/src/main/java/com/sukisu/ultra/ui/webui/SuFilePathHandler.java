@@ -1,20 +1,32 @@
 package com.sukisu.ultra.ui.webui;
 
 import android.content.Context;
+import android.os.ParcelFileDescriptor;
 import android.util.Log;
 import android.webkit.WebResourceResponse;
 import androidx.annotation.NonNull;
+import androidx.annotation.Nullable;
 import androidx.annotation.WorkerThread;
 import androidx.webkit.WebViewAssetLoader;
+import com.sukisu.ultra.ui.util.KsudClient;
 import com.topjohnwu.superuser.Shell;
 import com.topjohnwu.superuser.io.SuFile;
 import com.topjohnwu.superuser.io.SuFileInputStream;
 
+import org.json.JSONArray;
+import org.json.JSONException;
+import org.json.JSONObject;
+
 import java.io.File;
 import java.io.IOException;
 import java.io.InputStream;
+import java.util.HashMap;
+import java.util.Locale;
+import java.util.Map;
 import java.util.zip.GZIPInputStream;
 
+import kotlin.Pair;
+
 /**
  * Handler class to open files from file system by root access
  * For more information about android storage please refer to
@@ -55,8 +67,17 @@ public final class SuFilePathHandler implements WebViewAssetLoader.PathHandler {
     @NonNull
     private final File mDirectory;
 
+    @NonNull
+    private final String mModuleId;
+
     private final Shell mShell;
 
+    /**
+     * Content codings the request being handled on this thread accepts, see
+     * {@link #setAcceptEncoding}.
+     */
+    private final ThreadLocal<JSONArray> mAcceptEncoding = new ThreadLocal<>();
+
     /**
      * Creates PathHandler for app's internal storage.
      * The directory to be exposed must be inside either the application's internal data
@@ -76,15 +97,18 @@ public final class SuFilePathHandler implements WebViewAssetLoader.PathHandler {
      *
      * @param directory the absolute path of the exposed app internal storage directory from
      *                  which files can be loaded.
+     * @param moduleId  the module whose webroot {@code directory} is, used to have the ksud
+     *                  daemon open files on our behalf.
      * @throws IllegalArgumentException if the directory is not allowed.
      */
-    public SuFilePathHandler(@NonNull File directory, Shell rootShell) {
+    public SuFilePathHandler(@NonNull File directory, @NonNull String moduleId, Shell rootShell) {
         try {
             mDirectory = new File(getCanonicalDirPath(directory));
             if (!isAllowedInternalStorageDir()) {
                 throw new IllegalArgumentException("The given directory \"" + directory
                         + "\" doesn't exist under an allowed app internal storage directory");
             }
+            mModuleId = moduleId;
             mShell = rootShell;
         } catch (IOException e) {
             throw new IllegalArgumentException(
@@ -93,6 +117,32 @@ public final class SuFilePathHandler implements WebViewAssetLoader.PathHandler {
         }
     }
 
+    /**
+     * Records the {@code Accept-Encoding} header of the request about to be passed to
+     * {@link #handle} on this thread, which only gets the path. Codings with {@code q=0}
+     * are left out; without a header no precompressed variant is served.
+     *
+     * @param header the header value, or {@code null} if the request has none.
+     */
+    public void setAcceptEncoding(@Nullable String header) {
+        JSONArray accepted = new JSONArray();
+        if (header != null) {
+            for (String part : header.split(",")) {
+                String[] fields = part.split(";");
+                String coding = fields[0].trim().toLowerCase(Locale.ROOT);
+                boolean refused = false;
+                for (int i = 1; i < fields.length; i++) {
+                    String param = fields[i].trim().replace(" ", "");
+                    refused |= param.matches("q=0(\\.0*)?");
+                }
+                if (!coding.isEmpty() && !refused) {
+                    accepted.put(coding);
+                }
+            }
+        }
+        mAcceptEncoding.set(accepted);
+    }
+
     private boolean isAllowedInternalStorageDir() throws IOException {
         String dir = getCanonicalDirPath(mDirectory);
 
@@ -130,6 +180,10 @@ public final class SuFilePathHandler implements WebViewAssetLoader.PathHandler {
         try {
             File file = getCanonicalFileIfChild(mDirectory, path);
             if (file != null) {
+                WebResourceResponse response = openFromDaemon(path);
+                if (response != null) {
+                    return response;
+                }
                 InputStream is = openFile(file, mShell);
                 String mimeType = guessMimeType(path);
                 return new WebResourceResponse(mimeType, null, is);
@@ -144,6 +198,50 @@ public final class SuFilePathHandler implements WebViewAssetLoader.PathHandler {
         return new WebResourceResponse(null, null, null);
     }
 
+    /**
+     * Asks the ksud daemon for a descriptor of the requested file, which the WebView then
+     * reads directly instead of through the root shell. A precompressed {@code .br} or
+     * {@code .gz} variant picked by the daemon, only among the codings the request accepts,
+     * is passed on untouched with a matching {@code Content-Encoding}.
+     *
+     * @return the response, or {@code null} to fall back to the root shell.
+     */
+    @Nullable
+    private WebResourceResponse openFromDaemon(@NonNull String path) {
+        Pair<JSONObject, ParcelFileDescriptor> opened;
+        try {
+            JSONArray encodings = mAcceptEncoding.get();
+            JSONObject params = new JSONObject()
+                    .put("module", mModuleId)
+                    .put("path", path)
+                    .put("encodings", encodings != null ? encodings : new JSONArray());
+            opened = KsudClient.INSTANCE.callForFd("webui.open", params);
+        } catch (KsudClient.KsudException | JSONException e) {
+            Log.w(TAG, "ksud could not open " + path + ": " + e.getMessage());
+            return null;
+        }
+        if (opened == null) {
+            return null;
+        }
+        JSONObject info = opened.getFirst();
+        InputStream is = new ParcelFileDescriptor.AutoCloseInputStream(opened.getSecond());
+        Map<String, String> headers = new HashMap<>();
+        if (!info.isNull("encoding")) {
+            headers.put("Content-Encoding", info.optString("encoding"));
+        } else if (path.endsWith(".svgz")) {
+            try {
+                is = handleSvgzStream(path, is);
+            } catch (IOException e) {
+                Log.e(TAG, "Error opening the requested path: " + path, e);
+                return null;
+            }
+        }
+        if (is instanceof ParcelFileDescriptor.AutoCloseInputStream) {
+            headers.put("Content-Length", String.valueOf(info.optLong("size")));
+        }
+        return new WebResourceResponse(guessMimeType(path), null, 200, "OK", headers, is);
+    }
+
     public static String getCanonicalDirPath(@NonNull File file) throws IOException {
         String canonicalPath = file.getCanonicalPath();
         if (!canonicalPath.endsWith("/")) canonicalPath += "/";
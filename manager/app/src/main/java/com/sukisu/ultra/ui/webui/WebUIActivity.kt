@@ -24,6 +24,7 @@ import java.io.File
 class WebUIActivity : ComponentActivity() {
     private val rootShell by lazy { createRootShell(true) }
     private var webView = null as WebView?
+    private var moduleId = null as String?
 
     override fun onCreate(savedInstanceState: Bundle?) {
 
@@ -36,6 +37,7 @@ class WebUIActivity : ComponentActivity() {
         super.onCreate(savedInstanceState)
 
         val moduleId = intent.getStringExtra("id") ?: finishAndRemoveTask().let { return }
+        this.moduleId = moduleId
         val name = intent.getStringExtra("name") ?: finishAndRemoveTask().let { return }
         if (Build.VERSION.SDK_INT < Build.VERSION_CODES.TIRAMISU) {
             @Suppress("DEPRECATION")
@@ -51,12 +53,10 @@ class WebUIActivity : ComponentActivity() {
 
         val moduleDir = "/data/adb/modules/${moduleId}"
         val webRoot = File("${moduleDir}/webroot")
+        val pathHandler = SuFilePathHandler(webRoot, moduleId, rootShell)
         val webViewAssetLoader = WebViewAssetLoader.Builder()
             .setDomain("mui.kernelsu.org")
-            .addPathHandler(
-                "/",
-                SuFilePathHandler(webRoot, rootShell)
-            )
+            .addPathHandler("/", pathHandler)
             .build()
 
         val webViewClient = object : WebViewClient() {
@@ -64,6 +64,12 @@ class WebUIActivity : ComponentActivity() {
                 view: WebView,
                 request: WebResourceRequest
             ): WebResourceResponse? {
+                // the loader only passes the path on, hand the header over first
+                pathHandler.setAcceptEncoding(
+                    request.requestHeaders.entries
+                        .firstOrNull { it.key.equals("Accept-Encoding", ignoreCase = true) }
+                        ?.value
+                )
                 return webViewAssetLoader.shouldInterceptRequest(request.url)
             }
         }
@@ -84,6 +90,7 @@ class WebUIActivity : ComponentActivity() {
             settings.javaScriptEnabled = true
             settings.domStorageEnabled = true
             settings.allowFileAccess = false
+            WebUIExecutor.open(moduleId)
             addJavascriptInterface(WebViewInterface(WXOptions(this@WebUIActivity, this, ModId(moduleId))), "ksu")
             setWebViewClient(webViewClient)
             loadUrl("https://mui.kernelsu.org/index.html")
@@ -94,6 +101,7 @@ class WebUIActivity : ComponentActivity() {
 
     override fun onDestroy() {
         rootShell.runCatching { close() }
+        moduleId?.let { WebUIExecutor.release(it) }
         webView?.apply {
             stopLoading()
             removeAllViews()
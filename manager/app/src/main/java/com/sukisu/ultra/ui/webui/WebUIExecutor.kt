@@ -0,0 +1,271 @@
+package com.sukisu.ultra.ui.webui
+
+import android.os.SystemClock
+import android.util.Log
+import android.webkit.WebMessage
+import android.webkit.WebMessagePort
+import android.webkit.WebView
+import com.sukisu.ultra.ui.util.createRootShell
+import com.sukisu.ultra.ui.util.getKsuDaemonPath
+import com.topjohnwu.superuser.Shell
+import org.json.JSONObject
+import java.io.IOException
+import java.io.InputStream
+import java.io.InputStreamReader
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.Executors
+import java.util.concurrent.Semaphore
+import java.util.concurrent.atomic.AtomicBoolean
+import java.util.concurrent.atomic.AtomicLong
+import kotlin.concurrent.thread
+
+/**
+ * Runs one module's WebUI commands on a small pool of reused root shells
+ * instead of a fresh shell per `ksu.exec`, with at most [MAX_CONCURRENT]
+ * commands of the module in flight at once. Streams get a process of
+ * their own, in a session of its own, so they can be cancelled without
+ * touching the pool, and a limit of their own, so long-running ones never
+ * hold up `exec`.
+ */
+class WebUIExecutor private constructor(private val moduleId: String) {
+
+    companion object {
+        private const val TAG = "WebUIExecutor"
+        private const val MAX_CONCURRENT = 3
+        private const val MAX_STREAMS = 3
+        private const val MAX_IDLE = 2
+        private const val CHUNK_CHARS = 4096
+
+        private val executors = ConcurrentHashMap<String, WebUIExecutor>()
+        private val threads = Executors.newCachedThreadPool()
+
+        /** Set up the module's executor when its WebUI opens. */
+        fun open(moduleId: String): WebUIExecutor =
+            executors.getOrPut(moduleId) { WebUIExecutor(moduleId) }
+
+        /** The module's executor, null once [release] dropped it. */
+        fun forModule(moduleId: String): WebUIExecutor? = executors[moduleId]
+
+        /** Drop the module's executor once its WebUI is gone. */
+        fun release(moduleId: String) {
+            executors.remove(moduleId)?.close()
+        }
+    }
+
+    private val permits = Semaphore(MAX_CONCURRENT)
+    private val streamPermits = Semaphore(MAX_STREAMS)
+    @Volatile
+    private var closed = false
+    private val idle = ArrayDeque<Shell>()
+    private val streams = ConcurrentHashMap<String, RunningStream>()
+
+    private val calls = AtomicLong()
+    private val failures = AtomicLong()
+    private val cancelled = AtomicLong()
+    private val inFlight = AtomicLong()
+    private val totalMs = AtomicLong()
+    private val maxMs = AtomicLong()
+
+    private fun takeShell(): Shell {
+        val shell = synchronized(idle) { idle.removeFirstOrNull() }
+        return shell?.takeIf { it.isAlive } ?: createRootShell(true)
+    }
+
+    private fun returnShell(shell: Shell) {
+        val kept = shell.isAlive && synchronized(idle) {
+            !closed && idle.size < MAX_IDLE && idle.add(shell)
+        }
+        if (!kept) runCatching { shell.close() }
+    }
+
+    private inline fun <T> timed(block: () -> T): T {
+        inFlight.incrementAndGet()
+        val start = SystemClock.elapsedRealtime()
+        try {
+            return block()
+        } finally {
+            val elapsed = SystemClock.elapsedRealtime() - start
+            calls.incrementAndGet()
+            totalMs.addAndGet(elapsed)
+            maxMs.accumulateAndGet(elapsed, ::maxOf)
+            inFlight.decrementAndGet()
+        }
+    }
+
+    private inline fun <T> measured(limit: Semaphore, block: () -> T): T {
+        limit.acquire()
+        try {
+            return timed(block)
+        } finally {
+            limit.release()
+        }
+    }
+
+    /** Run [command] on a pooled shell, blocking until it finishes. */
+    fun exec(command: String): Shell.Result = measured(permits) {
+        val shell = takeShell()
+        try {
+            // a subshell keeps cd and exports from leaking into the next user
+            shell.newJob().add("(\n$command\n)").to(ArrayList(), ArrayList()).exec().also {
+                if (!it.isSuccess) failures.incrementAndGet()
+            }
+        } finally {
+            returnShell(shell)
+        }
+    }
+
+    /** Run [command] in the background and hand the result to [callback]. */
+    fun execAsync(command: String, callback: (Shell.Result) -> Unit) {
+        threads.execute { callback(exec(command)) }
+    }
+
+    private fun startRootProcess(): Process {
+        return try {
+            ProcessBuilder(getKsuDaemonPath(), "debug", "su", "-g").start()
+        } catch (e: IOException) {
+            Log.w(TAG, "ksu failed: ", e)
+            ProcessBuilder("su", "-mm").start()
+        }
+    }
+
+    // The process is root, so the app can't signal it, and killing only the
+    // shell would leave its children holding the pipes; a pooled root
+    // shell kills the whole session's group instead.
+    private fun killGroup(group: Int) {
+        threads.execute {
+            val shell = takeShell()
+            try {
+                shell.newJob().add("kill -9 -- -$group").exec()
+            } finally {
+                returnShell(shell)
+            }
+        }
+    }
+
+    /** A stream's process group, and the permit it holds until exit or cancel. */
+    private inner class RunningStream {
+        private var group = 0
+        private var cancelled = false
+        private val holding = AtomicBoolean(true)
+
+        @Synchronized
+        fun started(group: Int) {
+            this.group = group
+            if (cancelled) killGroup(group)
+        }
+
+        @Synchronized
+        fun cancel() {
+            cancelled = true
+            releasePermit()
+            if (group > 0) killGroup(group)
+        }
+
+        fun releasePermit() {
+            if (holding.getAndSet(false)) streamPermits.release()
+        }
+    }
+
+    // The first line a stream prints is the pid of its session leader,
+    // which is also its process group; read it unbuffered so pump() still
+    // sees everything after it.
+    private fun readGroup(input: InputStream): Int {
+        val line = StringBuilder()
+        while (true) {
+            val c = input.read()
+            if (c < 0 || c == '\n'.code) break
+            line.append(c.toChar())
+        }
+        return line.toString().trim().toIntOrNull() ?: 0
+    }
+
+    private fun pump(input: InputStream, type: String, send: (JSONObject) -> Unit) {
+        try {
+            InputStreamReader(input).use { reader ->
+                val buffer = CharArray(CHUNK_CHARS)
+                while (true) {
+                    val n = reader.read(buffer)
+                    if (n < 0) break
+                    send(JSONObject().put("type", type).put("data", String(buffer, 0, n)))
+                }
+            }
+        } catch (e: IOException) {
+            // the process was cancelled under us
+        }
+    }
+
+    /**
+     * Run [command] in its own root process, posting `stdout`/`stderr`
+     * chunks as they arrive and finally `exit` to [port].
+     */
+    fun stream(id: String, command: String, webView: WebView, port: WebMessagePort) {
+        val send = { message: JSONObject ->
+            webView.post { port.postMessage(WebMessage(message.toString())) }
+        }
+        // a new session puts everything the command starts in one group
+        val quoted = "'" + command.replace("'", "'\\''") + "'"
+        val script = "exec setsid sh -c 'echo \$\$; exec sh -c \"\$0\"' $quoted\n"
+        threads.execute {
+            streamPermits.acquire()
+            if (closed) {
+                // released while queued, close() won't see this one
+                streamPermits.release()
+                send(JSONObject().put("type", "exit").put("code", -1))
+                webView.post { port.close() }
+                return@execute
+            }
+            val stream = RunningStream()
+            streams[id] = stream
+            val code = timed {
+                try {
+                    val process = startRootProcess()
+                    process.outputStream.use { it.write(script.toByteArray()) }
+                    stream.started(readGroup(process.inputStream))
+                    val stderr = thread { pump(process.errorStream, "stderr", send) }
+                    pump(process.inputStream, "stdout", send)
+                    stderr.join()
+                    process.waitFor()
+                } catch (e: IOException) {
+                    Log.w(TAG, "stream $id: ", e)
+                    -1
+                } finally {
+                    streams.remove(id)
+                    stream.releasePermit()
+                }
+            }
+            if (code != 0) failures.incrementAndGet()
+            send(JSONObject().put("type", "exit").put("code", code))
+            webView.post { port.close() }
+        }
+    }
+
+    /**
+     * Kill a running stream with everything it started and free its slot
+     * right away, its `exit` message still follows.
+     */
+    fun cancel(id: String): Boolean {
+        val stream = streams[id] ?: return false
+        stream.cancel()
+        cancelled.incrementAndGet()
+        return true
+    }
+
+    /** Kill running streams and close the idle shells, in-flight execs finish. */
+    private fun close() {
+        closed = true
+        streams.values.forEach { it.cancel() }
+        val shells = synchronized(idle) { idle.toList().also { idle.clear() } }
+        shells.forEach { runCatching { it.close() } }
+    }
+
+    fun metrics(): JSONObject = JSONObject()
+        .put("module", moduleId)
+        .put("calls", calls.get())
+        .put("failures", failures.get())
+        .put("cancelled", cancelled.get())
+        .put("inFlight", inFlight.get())
+        .put("streams", streams.size)
+        .put("idleShells", synchronized(idle) { idle.size })
+        .put("totalMs", totalMs.get())
+        .put("maxMs", maxMs.get())
+}
@@ -1,11 +1,13 @@
 package com.sukisu.ultra.ui.webui
 
 import android.app.Activity
+import android.net.Uri
 import android.os.Handler
 import android.os.Looper
 import android.text.TextUtils
 import android.view.Window
 import android.webkit.JavascriptInterface
+import android.webkit.WebMessage
 import android.widget.Toast
 import androidx.core.view.WindowInsetsCompat
 import androidx.core.view.WindowInsetsControllerCompat
@@ -14,12 +16,12 @@ import com.dergoogler.mmrl.webui.interfaces.WXOptions
 import com.dergoogler.mmrl.webui.model.JavaScriptInterface
 import com.sukisu.ultra.ui.util.*
 import com.topjohnwu.superuser.CallbackList
-import com.topjohnwu.superuser.ShellUtils
 import com.topjohnwu.superuser.internal.UiThreadHandler
 import org.json.JSONArray
 import org.json.JSONObject
 import java.io.File
 import java.util.concurrent.CompletableFuture
+import java.util.concurrent.atomic.AtomicInteger
 
 @Suppress("unused")
 class WebViewInterface(
@@ -33,9 +35,14 @@ class WebViewInterface(
 
     private val modDir get() = "/data/adb/modules/${modId.id}"
 
+    // looked up once, a released executor must not come back for this page
+    private val executor = WebUIExecutor.forModule(modId.id)
+    private val streamIds = AtomicInteger()
+
     @JavascriptInterface
     fun exec(cmd: String): String {
-        return withNewRootShell(true) { ShellUtils.fastCmd(this, cmd) }
+        // same as ShellUtils.fastCmd: the last line of stdout
+        return executor?.exec(cmd)?.out?.lastOrNull() ?: ""
     }
 
     @JavascriptInterface
@@ -71,21 +78,55 @@ class WebViewInterface(
             append(cmd)
         }
 
-        val result = withNewRootShell(true) {
-            newJob().add(finalCommand).to(ArrayList(), ArrayList()).exec()
+        executor?.execAsync(finalCommand) { result ->
+            val stdout = result.out.joinToString(separator = "\n")
+            val stderr = result.err.joinToString(separator = "\n")
+
+            val jsCode =
+                "(function() { try { ${callbackFunc}(${result.code}, ${
+                    JSONObject.quote(
+                        stdout
+                    )
+                }, ${JSONObject.quote(stderr)}); } catch(e) { console.error(e); } })();"
+            webView.post {
+                webView.evaluateJavascript(jsCode, null)
+            }
         }
-        val stdout = result.out.joinToString(separator = "\n")
-        val stderr = result.err.joinToString(separator = "\n")
+    }
 
-        val jsCode =
-            "(function() { try { ${callbackFunc}(${result.code}, ${
-                JSONObject.quote(
-                    stdout
-                )
-            }, ${JSONObject.quote(stderr)}); } catch(e) { console.error(e); } })();"
+    /**
+     * Run [cmd] and stream its output. Returns a stream id; the page then
+     * receives a `message` event whose data is that id, carrying a
+     * MessagePort that gets `{type: "stdout"|"stderr", data}` chunks and
+     * a final `{type: "exit", code}`.
+     */
+    @JavascriptInterface
+    fun execStream(cmd: String, options: String?): String {
+        val id = "ksu-stream-${streamIds.incrementAndGet()}"
+        val finalCommand = buildString {
+            processOptions(this, options)
+            append(cmd)
+        }
         webView.post {
-            webView.evaluateJavascript(jsCode, null)
+            val (local, remote) = webView.createWebMessageChannel()
+            webView.postWebMessage(WebMessage(id, arrayOf(remote)), Uri.parse("*"))
+            if (executor != null) {
+                executor.stream(id, finalCommand, webView, local)
+            } else {
+                local.close()
+            }
         }
+        return id
+    }
+
+    @JavascriptInterface
+    fun cancel(streamId: String): Boolean {
+        return executor?.cancel(streamId) ?: false
+    }
+
+    @JavascriptInterface
+    fun execStats(): String {
+        return executor?.metrics()?.toString() ?: "{}"
     }
 
     @JavascriptInterface
@@ -1,5 +1,5 @@
 use std::env;
-use std::fs::File;
+use std::fs::{self, File};
 use std::io::Write;
 use std::path::Path;
 use std::process::Command;
@@ -28,6 +28,48 @@ fn get_git_version() -> Result<(u32, String), std::io::Error> {
     Ok((version_code, version_name))
 }
 
+// keep in sync with the rust-embed folders in src/assets.rs
+fn asset_dir() -> &'static str {
+    match env::var("CARGO_CFG_TARGET_ARCH").as_deref() {
+        Ok("x86_64") => "bin/x86_64",
+        Ok("arm") => "bin/arm",
+        _ => "bin/aarch64",
+    }
+}
+
+// FNV-1a, only needs to tell revisions of the same asset apart
+fn fnv1a(data: &[u8]) -> u64 {
+    data.iter().fold(0xcbf29ce484222325, |hash, &b| {
+        (hash ^ u64::from(b)).wrapping_mul(0x100000001b3)
+    })
+}
+
+fn write_asset_manifest(out_dir: &Path) {
+    let mut entries = Vec::new();
+    if let Ok(dir) = fs::read_dir(asset_dir()) {
+        for entry in dir.flatten() {
+            if !entry.file_type().is_ok_and(|t| t.is_file()) {
+                continue;
+            }
+            let name = entry.file_name().to_string_lossy().to_string();
+            if name.starts_with('.') {
+                continue;
+            }
+            let data = fs::read(entry.path()).expect("Failed to read asset");
+            entries.push((name, fnv1a(&data)));
+        }
+    }
+    entries.sort();
+
+    let mut manifest = File::create(out_dir.join("asset_manifest.rs"))
+        .expect("Failed to create asset_manifest.rs");
+    writeln!(manifest, "pub const ASSET_MANIFEST: &[(&str, u64)] = &[").unwrap();
+    for (name, hash) in entries {
+        writeln!(manifest, "    ({name:?}, {hash:#018x}),").unwrap();
+    }
+    writeln!(manifest, "];").expect("Failed to write asset_manifest.rs");
+}
+
 fn main() {
     let (code, name) = match get_git_version() {
         Ok((code, name)) => (code, name),
@@ -48,4 +90,6 @@ fn main() {
         .expect("Failed to create VERSION_NAME")
         .write_all(name.trim().as_bytes())
         .expect("Failed to write VERSION_NAME");
+
+    write_asset_manifest(out_dir);
 }
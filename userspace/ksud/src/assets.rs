@@ -1,7 +1,7 @@
 use anyhow::Result;
 use const_format::concatcp;
 use rust_embed::RustEmbed;
-use std::path::Path;
+use std::{collections::HashMap, path::Path};
 
 use crate::{defs::BINARY_DIR, utils};
 
@@ -9,6 +9,14 @@ pub const RESETPROP_PATH: &str = concatcp!(BINARY_DIR, "resetprop");
 pub const BUSYBOX_PATH: &str = concatcp!(BINARY_DIR, "busybox");
 pub const BOOTCTL_PATH: &str = concatcp!(BINARY_DIR, "bootctl");
 
+// name and content hash of every embedded asset, generated by build.rs
+include!(concat!(env!("OUT_DIR"), "/asset_manifest.rs"));
+
+const ASSET_MANIFEST_PATH: &str = concatcp!(BINARY_DIR, ".manifest");
+
+// what modules need during post-fs-data, the rest is extracted on first use
+const BOOT_ASSETS: &[&str] = &["busybox", "resetprop"];
+
 #[cfg(all(target_arch = "x86_64", target_os = "android"))]
 #[derive(RustEmbed)]
 #[folder = "bin/x86_64"]
@@ -25,18 +33,80 @@ struct Asset;
 #[folder = "bin/arm"]
 struct Asset;
 
-pub fn ensure_binaries(ignore_if_exist: bool) -> Result<()> {
-    for file in Asset::iter() {
-        if file == "ksuinit" || file.ends_with(".ko") {
+fn load_manifest() -> HashMap<String, u64> {
+    let Ok(content) = std::fs::read_to_string(ASSET_MANIFEST_PATH) else {
+        return HashMap::new();
+    };
+    content
+        .lines()
+        .filter_map(|line| {
+            let (name, hash) = line.split_once(' ')?;
+            let hash = u64::from_str_radix(hash.trim_start_matches("0x"), 16).ok()?;
+            Some((name.to_string(), hash))
+        })
+        .collect()
+}
+
+fn store_manifest(manifest: &HashMap<String, u64>) -> Result<()> {
+    let content: String = manifest
+        .iter()
+        .map(|(name, hash)| format!("{name} {hash:#018x}\n"))
+        .collect();
+    let tmp = format!("{ASSET_MANIFEST_PATH}.tmp");
+    std::fs::write(&tmp, content)?;
+    std::fs::rename(&tmp, ASSET_MANIFEST_PATH)?;
+    Ok(())
+}
+
+/// Extract the selected assets whose recorded hash differs from the
+/// embedded one, so unchanged binaries are neither decompressed nor
+/// rewritten. Files we have no record of are kept if `ignore_if_exist`.
+fn extract_assets(filter: impl Fn(&str) -> bool, ignore_if_exist: bool) -> Result<()> {
+    let mut manifest = load_manifest();
+    let mut dirty = false;
+
+    for &(name, hash) in ASSET_MANIFEST {
+        if name == "ksuinit" || name.ends_with(".ko") {
             // don't extract ksuinit and kernel modules
             continue;
         }
-        let asset = Asset::get(&file).ok_or(anyhow::anyhow!("asset not found: {}", file))?;
-        utils::ensure_binary(format!("{BINARY_DIR}{file}"), &asset.data, ignore_if_exist)?
+        if !filter(name) {
+            continue;
+        }
+        let path = format!("{BINARY_DIR}{name}");
+        let exists = Path::new(&path).exists();
+        match manifest.get(name) {
+            Some(&recorded) if recorded == hash && exists => continue,
+            None if ignore_if_exist && exists => continue,
+            _ => {}
+        }
+
+        let asset = Asset::get(name).ok_or(anyhow::anyhow!("asset not found: {}", name))?;
+        utils::ensure_binary(&path, &asset.data, false)?;
+        manifest.insert(name.to_string(), hash);
+        dirty = true;
+    }
+
+    if dirty {
+        store_manifest(&manifest)?;
     }
     Ok(())
 }
 
+pub fn ensure_binaries(ignore_if_exist: bool) -> Result<()> {
+    extract_assets(|_| true, ignore_if_exist)
+}
+
+/// Only what post-fs-data needs; see `ensure_asset` for everything else.
+pub fn ensure_boot_binaries() -> Result<()> {
+    extract_assets(|name| BOOT_ASSETS.contains(&name), true)
+}
+
+/// Make sure a single asset is extracted and current before using it.
+pub fn ensure_asset(name: &str) -> Result<()> {
+    extract_assets(|asset| asset == name, true)
+}
+
 pub fn copy_assets_to_file(name: &str, dst: impl AsRef<Path>) -> Result<()> {
     let asset = Asset::get(name).ok_or(anyhow::anyhow!("asset not found: {}", name))?;
     std::fs::write(dst, asset.data)?;
@@ -0,0 +1,262 @@
+use anyhow::{Result, bail, ensure};
+use libc::{c_int, c_ulong};
+use std::{
+    fs::File,
+    io::Read,
+    os::fd::{AsRawFd, FromRawFd},
+    ptr,
+    sync::atomic::{AtomicU64, Ordering, fence},
+};
+
+use crate::ksucalls::KSU_OPTIONS;
+
+const CMD_GET_EVENT_RING_FD: c_int = 106;
+
+const RING_MAGIC: u32 = 0x4b534556;
+const RING_VERSION: u32 = 1;
+
+/// Mirrors `struct ksu_event` in kernel/event_ring.h.
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct RawEvent {
+    seq: u64,
+    timestamp: u64,
+    kind: u32,
+    uid: u32,
+    pid: u32,
+    data: u32,
+}
+
+/// Mirrors the fixed part of `struct ksu_event_ring_header`.
+#[repr(C)]
+struct RingHeader {
+    magic: u32,
+    version: u32,
+    nr_cpus: u32,
+    ring_entries: u32,
+    event_size: u32,
+    ring_offset: u32,
+    ring_stride: u32,
+    _reserved: u32,
+}
+
+// the header fills the first page, whatever size the kernel's pages are
+fn page_size() -> usize {
+    // SAFETY: sysconf has no preconditions.
+    let size = unsafe { libc::sysconf(libc::_SC_PAGESIZE) };
+    usize::try_from(size).unwrap_or(4096)
+}
+
+fn kind_name(kind: u32) -> &'static str {
+    match kind {
+        1 => "grant",
+        2 => "deny",
+        3 => "profile",
+        4 => "umount",
+        _ => "unknown",
+    }
+}
+
+struct Mapping {
+    addr: *mut libc::c_void,
+    len: usize,
+}
+
+impl Mapping {
+    fn new(fd: &File, len: usize) -> Result<Self> {
+        // SAFETY: fresh read-only shared mapping of the ring fd, checked below.
+        let addr = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_SHARED,
+                fd.as_raw_fd(),
+                0,
+            )
+        };
+        if addr == libc::MAP_FAILED {
+            bail!("mmap event ring: {}", std::io::Error::last_os_error());
+        }
+        Ok(Self { addr, len })
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        // SAFETY: addr/len come from a successful mmap.
+        unsafe { libc::munmap(self.addr, self.len) };
+    }
+}
+
+/// Consumer side of the kernel's per-cpu root grant event rings.
+struct EventRing {
+    file: File,
+    map: Mapping,
+    nr_cpus: usize,
+    entries: u64,
+    ring_offset: usize,
+    ring_stride: usize,
+    positions: Vec<u64>,
+    lost: u64,
+}
+
+impl EventRing {
+    fn open() -> Result<Self> {
+        let mut fd: c_int = -1;
+        let mut rc: u32 = 0;
+        // SAFETY: both out pointers live through the prctl.
+        unsafe {
+            libc::prctl(
+                KSU_OPTIONS,
+                CMD_GET_EVENT_RING_FD,
+                &mut fd as *mut c_int as c_ulong,
+                0,
+                &mut rc as *mut u32 as c_ulong,
+            );
+        }
+        ensure!(
+            rc == KSU_OPTIONS as u32 && fd >= 0,
+            "kernel does not provide the event ring"
+        );
+        // SAFETY: the kernel handed us a new fd we now own.
+        let file = unsafe { File::from_raw_fd(fd) };
+
+        let header = Mapping::new(&file, page_size())?;
+        // SAFETY: the first page always holds the header.
+        let hdr = unsafe { ptr::read(header.addr as *const RingHeader) };
+        ensure!(
+            hdr.magic == RING_MAGIC && hdr.version == RING_VERSION,
+            "unsupported event ring version {}",
+            hdr.version
+        );
+        ensure!(
+            hdr.event_size as usize == std::mem::size_of::<RawEvent>(),
+            "unexpected event size {}",
+            hdr.event_size
+        );
+        drop(header);
+
+        let nr_cpus = hdr.nr_cpus as usize;
+        let len = hdr.ring_offset as usize + nr_cpus * hdr.ring_stride as usize;
+        let map = Mapping::new(&file, len)?;
+
+        Ok(Self {
+            file,
+            map,
+            nr_cpus,
+            entries: u64::from(hdr.ring_entries),
+            ring_offset: hdr.ring_offset as usize,
+            ring_stride: hdr.ring_stride as usize,
+            positions: vec![0; nr_cpus],
+            lost: 0,
+        })
+    }
+
+    fn head(&self, cpu: usize) -> u64 {
+        let offset = std::mem::size_of::<RingHeader>() + cpu * 8;
+        // SAFETY: head[] lies in the header page and is naturally aligned.
+        let head = unsafe { &*(self.map.addr.add(offset) as *const AtomicU64) };
+        head.load(Ordering::Acquire)
+    }
+
+    fn slot(&self, cpu: usize, pos: u64) -> *const RawEvent {
+        let index = (pos & (self.entries - 1)) as usize;
+        let offset =
+            self.ring_offset + cpu * self.ring_stride + index * std::mem::size_of::<RawEvent>();
+        // SAFETY: index < entries, so the slot is inside the cpu's ring.
+        unsafe { self.map.addr.add(offset) as *const RawEvent }
+    }
+
+    /// Copy every event published since the last call, oldest first.
+    fn drain(&mut self, out: &mut Vec<RawEvent>) {
+        for cpu in 0..self.nr_cpus {
+            let head = self.head(cpu);
+            let mut pos = self.positions[cpu];
+            if head - pos > self.entries {
+                self.lost += head - self.entries - pos;
+                pos = head - self.entries;
+            }
+            for p in pos..head {
+                let slot = self.slot(cpu, p);
+                // SAFETY: slot points into the mapping; the seq check
+                // below rejects copies torn by a concurrent producer.
+                let (before, event, after) = unsafe {
+                    let seq = &*(ptr::addr_of!((*slot).seq) as *const AtomicU64);
+                    let before = seq.load(Ordering::Acquire);
+                    let event = ptr::read_volatile(slot);
+                    fence(Ordering::Acquire);
+                    (before, event, seq.load(Ordering::Relaxed))
+                };
+                if before == p + 1 && after == p + 1 {
+                    out.push(event);
+                } else {
+                    self.lost += 1;
+                }
+            }
+            self.positions[cpu] = head;
+        }
+        out.sort_by_key(|e| e.timestamp);
+    }
+
+    /// Block until the kernel signals new events, then acknowledge them.
+    fn wait(&mut self) -> Result<()> {
+        let mut pfd = libc::pollfd {
+            fd: self.file.as_raw_fd(),
+            events: libc::POLLIN,
+            revents: 0,
+        };
+        // SAFETY: pfd is valid for the duration of the call.
+        if unsafe { libc::poll(&mut pfd, 1, -1) } < 0 {
+            let err = std::io::Error::last_os_error();
+            if err.kind() != std::io::ErrorKind::Interrupted {
+                bail!("poll event ring: {err}");
+            }
+        }
+        let mut total = [0u8; 8];
+        self.file.read_exact(&mut total)?;
+        Ok(())
+    }
+}
+
+fn print_events(events: &[RawEvent]) {
+    for e in events {
+        println!(
+            "{}",
+            serde_json::json!({
+                "time": e.timestamp,
+                "type": kind_name(e.kind),
+                "uid": e.uid,
+                "pid": e.pid,
+                "data": e.data,
+            })
+        );
+    }
+}
+
+/// Dump the root grant audit log as json lines, optionally following it.
+pub fn dump_events(follow: bool) -> Result<()> {
+    let mut ring = EventRing::open()?;
+    let mut events = Vec::new();
+
+    loop {
+        ring.drain(&mut events);
+        print_events(&events);
+        events.clear();
+
+        if ring.lost > 0 {
+            log::warn!(
+                "{} events were overwritten before they were read",
+                ring.lost
+            );
+            ring.lost = 0;
+        }
+
+        if !follow {
+            break;
+        }
+        ring.wait()?;
+    }
+
+    Ok(())
+}
@@ -0,0 +1,216 @@
+use anyhow::{Context, Result, bail, ensure};
+use flate2::read::DeflateDecoder;
+use std::{
+    fs::{File, OpenOptions},
+    io::{BufRead, BufReader, Read, Write},
+    os::{fd::AsRawFd, unix::fs::FileExt},
+    path::{Path, PathBuf},
+};
+
+use crate::defs::KSU_BACKUP_CHUNK_DIR;
+#[cfg(target_os = "android")]
+use crate::defs::{KSU_BACKUP_DIR, KSU_BACKUP_FILE_PREFIX};
+
+const MANIFEST_MAGIC: &str = "ksu-backup-v1";
+// boot images are laid out in fixed blocks, so fixed chunks dedup A/B
+// slots and unchanged OTA regions just as well as content-defined ones
+const CHUNK_SIZE: usize = 1 << 20;
+
+/// Backup manifest: the image size, then the sha256 and length of every
+/// chunk in order. Chunks live deflated under `KSU_BACKUP_CHUNK_DIR` and
+/// are shared between all backups.
+struct Manifest {
+    size: u64,
+    chunks: Vec<(String, usize)>,
+}
+
+fn chunk_path(id: &str) -> PathBuf {
+    Path::new(KSU_BACKUP_CHUNK_DIR).join(id)
+}
+
+fn read_manifest(path: &Path) -> Result<Manifest> {
+    let mut lines = BufReader::new(File::open(path)?).lines();
+    ensure!(
+        lines.next().transpose()?.as_deref() == Some(MANIFEST_MAGIC),
+        "{} is not a backup manifest",
+        path.display()
+    );
+    let Some(size) = lines.next().transpose()? else {
+        bail!("truncated backup manifest");
+    };
+    let size = size.parse()?;
+    let mut chunks = Vec::new();
+    for line in lines {
+        let line = line?;
+        let Some((id, len)) = line.split_once(' ') else {
+            bail!("bad backup manifest line: {line}");
+        };
+        chunks.push((id.to_string(), len.parse()?));
+    }
+    Ok(Manifest { size, chunks })
+}
+
+/// Whether `path` is a chunked backup rather than a plain image copy.
+pub fn is_chunked(path: &Path) -> bool {
+    let mut magic = [0u8; MANIFEST_MAGIC.len()];
+    File::open(path)
+        .and_then(|mut f| f.read_exact(&mut magic))
+        .is_ok_and(|()| magic == MANIFEST_MAGIC.as_bytes())
+}
+
+fn read_chunk_into(id: &str, len: usize, buffer: &mut Vec<u8>) -> Result<()> {
+    buffer.clear();
+    let file = File::open(chunk_path(id)).with_context(|| format!("missing backup chunk {id}"))?;
+    DeflateDecoder::new(file).read_to_end(buffer)?;
+    ensure!(
+        buffer.len() == len && sha256::digest(buffer.as_slice()) == id,
+        "corrupted backup chunk {id}"
+    );
+    Ok(())
+}
+
+/// Decompress the backup at `manifest` into `dst`, which may be the boot
+/// block device itself. Every chunk is verified before the first write,
+/// and read back from `dst` after the last.
+pub fn restore_to(manifest: &Path, dst: &Path) -> Result<()> {
+    let manifest = read_manifest(manifest)?;
+    let total: u64 = manifest.chunks.iter().map(|(_, len)| *len as u64).sum();
+    ensure!(total == manifest.size, "backup manifest size mismatch");
+
+    let mut buffer = Vec::with_capacity(CHUNK_SIZE);
+    for (id, len) in &manifest.chunks {
+        read_chunk_into(id, *len, &mut buffer)?;
+    }
+
+    // O_TRUNC is ignored for block devices
+    let mut out = OpenOptions::new()
+        .read(true)
+        .write(true)
+        .create(true)
+        .truncate(true)
+        .open(dst)
+        .with_context(|| format!("open {}", dst.display()))?;
+    for (id, len) in &manifest.chunks {
+        read_chunk_into(id, *len, &mut buffer)?;
+        out.write_all(&buffer)?;
+    }
+    out.sync_all()?;
+
+    // make sure the verify pass reads the media, not the page cache
+    // SAFETY: plain advice on a valid fd.
+    unsafe { libc::posix_fadvise(out.as_raw_fd(), 0, 0, libc::POSIX_FADV_DONTNEED) };
+
+    let mut offset = 0u64;
+    for (id, len) in &manifest.chunks {
+        buffer.resize(*len, 0);
+        out.read_exact_at(&mut buffer, offset)?;
+        ensure!(
+            sha256::digest(buffer.as_slice()) == *id,
+            "verify {} failed at offset {offset}",
+            dst.display()
+        );
+        offset += *len as u64;
+    }
+    Ok(())
+}
+
+#[cfg(target_os = "android")]
+fn fill_buffer(file: &mut File, buffer: &mut [u8]) -> std::io::Result<usize> {
+    let mut filled = 0;
+    while filled < buffer.len() {
+        match file.read(&mut buffer[filled..]) {
+            Ok(0) => break,
+            Ok(n) => filled += n,
+            Err(e) if e.kind() == std::io::ErrorKind::Interrupted => {}
+            Err(e) => return Err(e),
+        }
+    }
+    Ok(filled)
+}
+
+#[cfg(target_os = "android")]
+fn write_chunk(id: &str, data: &[u8]) -> Result<()> {
+    use flate2::{Compression, write::DeflateEncoder};
+
+    let path = chunk_path(id);
+    let tmp = path.with_extension("tmp");
+    let mut encoder = DeflateEncoder::new(File::create(&tmp)?, Compression::fast());
+    encoder.write_all(data)?;
+    encoder.finish()?.sync_all()?;
+    std::fs::rename(&tmp, &path)?;
+    Ok(())
+}
+
+/// Back up `image` in a single pass, returning its sha1 which names the
+/// backup. Only chunks not already held by another backup are written.
+#[cfg(target_os = "android")]
+pub fn store(image: &Path) -> Result<String> {
+    use sha1::Digest;
+
+    crate::utils::ensure_dir_exists(KSU_BACKUP_CHUNK_DIR)?;
+
+    let mut file = File::open(image).with_context(|| format!("open {}", image.display()))?;
+    let mut hasher = sha1::Sha1::new();
+    let mut buffer = vec![0u8; CHUNK_SIZE];
+    let mut existing = Vec::with_capacity(CHUNK_SIZE);
+    let mut chunks = String::new();
+    let mut size = 0u64;
+    let (mut total, mut written) = (0, 0);
+
+    loop {
+        let n = fill_buffer(&mut file, &mut buffer)?;
+        if n == 0 {
+            break;
+        }
+        let chunk = &buffer[..n];
+        hasher.update(chunk);
+        let id = sha256::digest(chunk);
+        // an interrupted earlier backup may have left a bad chunk behind,
+        // reusing it would make this backup unrestorable too
+        if read_chunk_into(&id, n, &mut existing).is_err() {
+            if chunk_path(&id).exists() {
+                log::warn!("backup chunk {id} is corrupted, rewriting it");
+            }
+            write_chunk(&id, chunk)?;
+            written += 1;
+        }
+        chunks.push_str(&format!("{id} {n}\n"));
+        size += n as u64;
+        total += 1;
+    }
+
+    let sha1 = format!("{:x}", hasher.finalize());
+    let path = format!("{KSU_BACKUP_DIR}{KSU_BACKUP_FILE_PREFIX}{sha1}");
+    let tmp = format!("{path}.tmp");
+    std::fs::write(&tmp, format!("{MANIFEST_MAGIC}\n{size}\n{chunks}"))?;
+    std::fs::rename(&tmp, &path)?;
+    log::info!("backup {sha1}: {written} of {total} chunks are new");
+    Ok(sha1)
+}
+
+/// Drop chunks that no remaining backup refers to.
+#[cfg(target_os = "android")]
+pub fn prune_chunks() -> Result<()> {
+    let mut referenced = std::collections::HashSet::new();
+    for entry in std::fs::read_dir(KSU_BACKUP_DIR)?.flatten() {
+        let path = entry.path();
+        let is_backup = path
+            .file_name()
+            .is_some_and(|name| name.to_string_lossy().starts_with(KSU_BACKUP_FILE_PREFIX));
+        if is_backup && is_chunked(&path) {
+            let manifest = read_manifest(&path)?;
+            referenced.extend(manifest.chunks.into_iter().map(|(id, _)| id));
+        }
+    }
+
+    let Ok(dir) = std::fs::read_dir(KSU_BACKUP_CHUNK_DIR) else {
+        return Ok(());
+    };
+    for entry in dir.flatten() {
+        let name = entry.file_name().to_string_lossy().to_string();
+        if !referenced.contains(&name) {
+            std::fs::remove_file(entry.path()).ok();
+        }
+    }
+    Ok(())
+}
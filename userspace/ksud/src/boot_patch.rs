@@ -10,12 +10,17 @@ use anyhow::Result;
 use anyhow::anyhow;
 use anyhow::bail;
 use anyhow::ensure;
+#[cfg(target_os = "android")]
 use regex_lite::Regex;
 use which::which;
 
+use crate::backup;
+use crate::cpio::Cpio;
 use crate::defs;
 use crate::defs::BACKUP_FILENAME;
 use crate::defs::{KSU_BACKUP_DIR, KSU_BACKUP_FILE_PREFIX};
+use crate::flash;
+use crate::kmi;
 use crate::{assets, utils};
 
 #[cfg(target_os = "android")]
@@ -96,50 +101,27 @@ pub fn get_current_kmi() -> Result<String> {
     bail!("Unsupported platform")
 }
 
-fn parse_kmi_from_kernel(kernel: &PathBuf, workdir: &Path) -> Result<String> {
-    use std::fs::{File, copy};
-    use std::io::{BufReader, Read};
-    let kernel_path = workdir.join("kernel");
-    copy(kernel, &kernel_path).context("Failed to copy kernel")?;
-
-    let file = File::open(&kernel_path).context("Failed to open kernel file")?;
-    let mut reader = BufReader::new(file);
-    let mut buffer = Vec::new();
-    reader
-        .read_to_end(&mut buffer)
-        .context("Failed to read kernel file")?;
-
-    let printable_strings: Vec<&str> = buffer
-        .split(|&b| b == 0)
-        .filter_map(|slice| std::str::from_utf8(slice).ok())
-        .filter(|s| s.chars().all(|c| c.is_ascii_graphic() || c == ' '))
-        .collect();
-
-    let re =
-        Regex::new(r"(?:.* )?(\d+\.\d+)(?:\S+)?(android\d+)").context("Failed to compile regex")?;
-    for s in printable_strings {
-        if let Some(caps) = re.captures(s) {
-            if let (Some(kernel_version), Some(android_version)) = (caps.get(1), caps.get(2)) {
-                let kmi = format!("{}-{}", android_version.as_str(), kernel_version.as_str());
-                return Ok(kmi);
-            }
-        }
+fn parse_kmi_from_kernel(kernel: &Path) -> Result<String> {
+    if let Some(kmi) = kmi::scan_kernel(kernel).context("Failed to scan kernel")? {
+        return Ok(kmi);
     }
     println!("- Failed to get KMI version");
     bail!("Try to choose LKM manually")
 }
 
-fn parse_kmi_from_boot(magiskboot: &Path, image: &PathBuf, workdir: &Path) -> Result<String> {
-    let image_path = workdir.join("image");
-
-    std::fs::copy(image, &image_path).context("Failed to copy image")?;
+fn parse_kmi_from_boot(magiskboot: &Path, image: &Path, workdir: &Path) -> Result<String> {
+    // most boot images carry an uncompressed kernel, try it in place first
+    if let Ok(Some(kmi)) = kmi::scan_kernel(image) {
+        return Ok(kmi);
+    }
 
+    let image = std::fs::canonicalize(image).context("Failed to find image")?;
     let status = Command::new(magiskboot)
         .current_dir(workdir)
         .stdout(Stdio::null())
         .stderr(Stdio::null())
         .arg("unpack")
-        .arg(&image_path)
+        .arg(&image)
         .status()
         .context("Failed to execute magiskboot command")?;
 
@@ -150,132 +132,58 @@ fn parse_kmi_from_boot(magiskboot: &Path, image: &PathBuf, workdir: &Path) -> Re
         );
     }
 
-    parse_kmi_from_kernel(&image_path, workdir)
+    parse_kmi_from_kernel(&workdir.join("kernel"))
 }
 
-fn do_cpio_cmd(magiskboot: &Path, workdir: &Path, cmd: &str) -> Result<()> {
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .arg("cpio")
-        .arg("ramdisk.cpio")
-        .arg(cmd)
-        .status()?;
+const RAMDISK_CPIO: &str = "ramdisk.cpio";
+const VENDOR_INIT_BOOT_CPIO: &str = "vendor_ramdisk/init_boot.cpio";
+const VENDOR_RAMDISK_CPIO: &str = "vendor_ramdisk/ramdisk.cpio";
 
-    ensure!(status.success(), "magiskboot cpio {} failed", cmd);
-    Ok(())
+/// The ramdisks unpacked into workdir, each parsed on first use and written
+/// back at most once instead of running magiskboot for every cpio command.
+struct Ramdisks<'a> {
+    workdir: &'a Path,
+    loaded: Vec<(&'static str, Cpio)>,
 }
 
-fn do_vendor_init_boot_cpio_cmd(magiskboot: &Path, workdir: &Path, cmd: &str) -> Result<()> {
-    let vendor_init_boot_cpio = workdir.join("vendor_ramdisk").join("init_boot.cpio");
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .arg("cpio")
-        .arg(vendor_init_boot_cpio)
-        .arg(cmd)
-        .status()?;
-
-    ensure!(status.success(), "magiskboot cpio {} failed", cmd);
-    Ok(())
-}
-
-fn do_vendor_ramdisk_cpio_cmd(magiskboot: &Path, workdir: &Path, cmd: &str) -> Result<()> {
-    let vendor_ramdisk_cpio = workdir.join("vendor_ramdisk").join("ramdisk.cpio");
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .arg("cpio")
-        .arg(vendor_ramdisk_cpio)
-        .arg(cmd)
-        .status()?;
-
-    ensure!(status.success(), "magiskboot cpio {} failed", cmd);
-    Ok(())
-}
-
-fn is_magisk_patched(magiskboot: &Path, workdir: &Path) -> Result<bool> {
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .args(["cpio", "ramdisk.cpio", "test"])
-        .status()?;
-
-    // 0: stock, 1: magisk
-    Ok(status.code() == Some(1))
-}
-
-fn is_magisk_patched_vendor_init_boot(magiskboot: &Path, workdir: &Path) -> Result<bool> {
-    let vendor_init_boot_cpio = workdir.join("vendor_ramdisk").join("init_boot.cpio");
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .args(["cpio", vendor_init_boot_cpio.to_str().unwrap(), "test"])
-        .status()?;
-
-    // 0: stock, 1: magisk
-    Ok(status.code() == Some(1))
-}
-
-fn is_magisk_patched_vendor_ramdisk(magiskboot: &Path, workdir: &Path) -> Result<bool> {
-    let vendor_ramdisk_cpio = workdir.join("vendor_ramdisk").join("ramdisk.cpio");
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .args(["cpio", vendor_ramdisk_cpio.to_str().unwrap(), "test"])
-        .status()?;
-
-    // 0: stock, 1: magisk
-    Ok(status.code() == Some(1))
-}
-
-fn is_kernelsu_patched(magiskboot: &Path, workdir: &Path) -> Result<bool> {
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .args(["cpio", "ramdisk.cpio", "exists kernelsu.ko"])
-        .status()?;
-
-    Ok(status.success())
-}
+impl<'a> Ramdisks<'a> {
+    fn new(workdir: &'a Path) -> Self {
+        Self {
+            workdir,
+            loaded: Vec::new(),
+        }
+    }
 
-fn is_kernelsu_patched_vendor_init_boot(magiskboot: &Path, workdir: &Path) -> Result<bool> {
-    let vendor_ramdisk_cpio = workdir.join("vendor_ramdisk").join("init_boot.cpio");
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .args([
-            "cpio",
-            vendor_ramdisk_cpio.to_str().unwrap(),
-            "exists kernelsu.ko",
-        ])
-        .status()?;
+    fn exists(&self, name: &str) -> bool {
+        self.workdir.join(name).exists()
+    }
 
-    Ok(status.success())
-}
+    fn get(&mut self, name: &'static str) -> Result<&mut Cpio> {
+        let index = match self.loaded.iter().position(|(n, _)| *n == name) {
+            Some(index) => index,
+            None => {
+                let cpio = Cpio::load(self.workdir.join(name))?;
+                self.loaded.push((name, cpio));
+                self.loaded.len() - 1
+            }
+        };
+        Ok(&mut self.loaded[index].1)
+    }
 
-fn is_kernelsu_patched_vendor_ramdisk(magiskboot: &Path, workdir: &Path) -> Result<bool> {
-    let vendor_ramdisk_cpio = workdir.join("vendor_ramdisk").join("ramdisk.cpio");
-    let status = Command::new(magiskboot)
-        .current_dir(workdir)
-        .stdout(Stdio::null())
-        .stderr(Stdio::null())
-        .args([
-            "cpio",
-            vendor_ramdisk_cpio.to_str().unwrap(),
-            "exists kernelsu.ko",
-        ])
-        .status()?;
+    fn remove(&mut self, name: &str) -> Result<()> {
+        self.loaded.retain(|(n, _)| *n != name);
+        std::fs::remove_file(self.workdir.join(name))?;
+        Ok(())
+    }
 
-    Ok(status.success())
+    fn save(self) -> Result<()> {
+        for (name, cpio) in &self.loaded {
+            if cpio.is_modified() {
+                cpio.dump(self.workdir.join(name))?;
+            }
+        }
+        Ok(())
+    }
 }
 
 fn dd<P: AsRef<Path>, Q: AsRef<Path>>(ifile: P, ofile: Q) -> Result<()> {
@@ -323,18 +231,15 @@ pub fn restore(
         .status()?;
     ensure!(status.success(), "magiskboot unpack failed");
 
-    let no_ramdisk = !workdir.join("ramdisk.cpio").exists();
-    // let no_ramdisk = !workdir.join("ramdisk.cpio").exists();
-    let no_vendor_init_boot = !workdir
-        .join("vendor_ramdisk")
-        .join("init_boot.cpio")
-        .exists();
-    let no_vendor_ramdisk = !workdir.join("vendor_ramdisk").join("ramdisk.cpio").exists();
-    let is_kernelsu_patched = is_kernelsu_patched(&magiskboot, workdir)?;
+    let mut ramdisks = Ramdisks::new(workdir);
+    let no_ramdisk = !ramdisks.exists(RAMDISK_CPIO);
+    let no_vendor_init_boot = !ramdisks.exists(VENDOR_INIT_BOOT_CPIO);
+    let no_vendor_ramdisk = !ramdisks.exists(VENDOR_RAMDISK_CPIO);
+    let is_kernelsu_patched = ramdisks.get(RAMDISK_CPIO)?.exists("kernelsu.ko");
     let is_kernelsu_patched_vendor_init_boot =
-        is_kernelsu_patched_vendor_init_boot(&magiskboot, workdir)?;
+        ramdisks.get(VENDOR_INIT_BOOT_CPIO)?.exists("kernelsu.ko");
     let is_kernelsu_patched_vendor_ramdisk =
-        is_kernelsu_patched_vendor_ramdisk(&magiskboot, workdir)?;
+        ramdisks.get(VENDOR_RAMDISK_CPIO)?.exists("kernelsu.ko");
     ensure!(
         is_kernelsu_patched
             || is_kernelsu_patched_vendor_init_boot
@@ -346,14 +251,8 @@ pub fn restore(
     let mut from_backup = false;
 
     #[cfg(target_os = "android")]
-    if do_cpio_cmd(&magiskboot, workdir, &format!("exists {BACKUP_FILENAME}")).is_ok() {
-        do_cpio_cmd(
-            &magiskboot,
-            workdir,
-            &format!("extract {BACKUP_FILENAME} {BACKUP_FILENAME}"),
-        )?;
-        let sha = std::fs::read(workdir.join(BACKUP_FILENAME))?;
-        let sha = String::from_utf8(sha)?;
+    if let Some(sha) = ramdisks.get(RAMDISK_CPIO)?.get(BACKUP_FILENAME) {
+        let sha = String::from_utf8(sha.to_vec())?;
         let sha = sha.trim();
         let backup_path =
             PathBuf::from(KSU_BACKUP_DIR).join(format!("{KSU_BACKUP_FILE_PREFIX}{sha}"));
@@ -372,82 +271,35 @@ pub fn restore(
     }
 
     if new_boot.is_none() {
-        if !no_ramdisk {
-            println!("- Restoring /ramdisk");
-            println!("- Removing /ramdisk/kernelsu.ko");
-            // remove kernelsu.ko
-            do_cpio_cmd(&magiskboot, workdir, "rm kernelsu.ko")?;
-
-            // if init.real exists, restore it
-            println!("- Checking if init.real exists");
-            let status = do_cpio_cmd(&magiskboot, workdir, "exists init.real").is_ok();
-            if status {
-                println!("- /ramdisk/init.real exists");
-                println!("- Restoring /ramdisk/init.real to init");
-                do_cpio_cmd(&magiskboot, workdir, "mv init.real init")?;
-            } else {
-                println!("- /ramdisk/init.real not found");
-                println!("- Removing ramdisk.cpio");
-                let ramdisk = workdir.join("ramdisk.cpio");
-                std::fs::remove_file(ramdisk)?;
-            }
+        let target = if !no_ramdisk {
+            RAMDISK_CPIO
         } else if !no_vendor_init_boot {
-            println!("- Restoring /vendor_ramdisk/init_boot");
-            println!("- Removing /vendor_ramdisk/init_boot/kernelsu.ko");
-            // vendor init_boot restore
-            do_vendor_init_boot_cpio_cmd(&magiskboot, workdir, "rm kernelsu.ko")?;
-
-            println!("- Checking if init.real exists");
-            let status =
-                do_vendor_init_boot_cpio_cmd(&magiskboot, workdir, "exists init.real").is_ok();
-            if status {
-                println!("- /vendor_ramdisk/init_boot/init.real exists");
-                println!("- Restoring /vendor_ramdisk/init_boot/init.real to init");
-                do_vendor_init_boot_cpio_cmd(&magiskboot, workdir, "mv init.real init")?;
-            } else {
-                println!("- /vendor_ramdisk/init_boot/init.real not found");
-                println!("- Removing vendor_ramdisk/init_boot.cpio");
-                let vendor_init_boot = workdir.join("vendor_ramdisk").join("init_boot.cpio");
-                std::fs::remove_file(vendor_init_boot)?;
-            }
+            VENDOR_INIT_BOOT_CPIO
         } else if !no_vendor_ramdisk {
-            println!("- Restoring /vendor_ramdisk/ramdisk");
-            println!("- Removing /vendor_ramdisk/ramdisk/kernelsu.ko");
-            // vendor ramdisk restore
-            do_vendor_ramdisk_cpio_cmd(&magiskboot, workdir, "rm kernelsu.ko")?;
-
-            let status =
-                do_vendor_ramdisk_cpio_cmd(&magiskboot, workdir, "exists init.real").is_ok();
-            if status {
-                println!("- /vendor_ramdisk/ramdisk/init.real exists");
-                println!("- Restoring /vendor_ramdisk/ramdisk/init.real to init");
-                do_vendor_ramdisk_cpio_cmd(&magiskboot, workdir, "mv init.real init")?;
-            } else {
-                println!("- /vendor_ramdisk/ramdisk/init.real not found");
-                println!("- Removing vendor_ramdisk/ramdisk.cpio");
-                let vendor_ramdisk = workdir.join("vendor_ramdisk").join("ramdisk.cpio");
-                std::fs::remove_file(vendor_ramdisk)?;
-            }
+            VENDOR_RAMDISK_CPIO
         } else {
-            println!("- Restoring /ramdisk");
-            println!("- Removing /ramdisk/kernelsu.ko");
-            // remove kernelsu.ko
-            do_cpio_cmd(&magiskboot, workdir, "rm kernelsu.ko")?;
-
-            // if init.real exists, restore it
-            println!("- Checking if init.real exists");
-            let status = do_cpio_cmd(&magiskboot, workdir, "exists init.real").is_ok();
-            if status {
-                println!("- /ramdisk/init.real exists");
-                println!("- Restoring /ramdisk/init.real to init");
-                do_cpio_cmd(&magiskboot, workdir, "mv init.real init")?;
-            } else {
-                println!("- /ramdisk/init.real not found");
-                println!("- Removing ramdisk.cpio");
-                let ramdisk = workdir.join("ramdisk.cpio");
-                std::fs::remove_file(ramdisk)?;
-            }
+            RAMDISK_CPIO
+        };
+        let label = target.trim_end_matches(".cpio");
+
+        println!("- Restoring /{label}");
+        println!("- Removing /{label}/kernelsu.ko");
+        // remove kernelsu.ko
+        let cpio = ramdisks.get(target)?;
+        cpio.rm("kernelsu.ko");
+
+        // if init.real exists, restore it
+        println!("- Checking if init.real exists");
+        if cpio.exists("init.real") {
+            println!("- /{label}/init.real exists");
+            println!("- Restoring /{label}/init.real to init");
+            cpio.mv("init.real", "init")?;
+        } else {
+            println!("- /{label}/init.real not found");
+            println!("- Removing {target}");
+            ramdisks.remove(target)?;
         }
+        ramdisks.save()?;
 
         println!("- Repacking boot image");
         let status = Command::new(&magiskboot)
@@ -472,7 +324,9 @@ pub fn restore(
             now.format("%Y%m%d_%H%M%S")
         ));
 
-        if from_backup || std::fs::rename(&new_boot, &output_image).is_err() {
+        if from_backup && backup::is_chunked(&new_boot) {
+            backup::restore_to(&new_boot, &output_image).context("copy out new boot failed")?;
+        } else if from_backup || std::fs::rename(&new_boot, &output_image).is_err() {
             std::fs::copy(&new_boot, &output_image).context("copy out new boot failed")?;
         }
         println!("- Output file is written to");
@@ -566,7 +420,7 @@ fn do_patch(
                         "- Trying to auto detect KMI version for {}",
                         kernel_path.to_str().unwrap()
                     );
-                    parse_kmi_from_kernel(kernel_path, tmpdir.path())?
+                    parse_kmi_from_kernel(kernel_path)?
                 } else {
                     "".to_string()
                 }
@@ -624,20 +478,18 @@ fn do_patch(
         .status()?;
     ensure!(status.success(), "magiskboot unpack failed");
 
-    let no_ramdisk = !workdir.join("ramdisk.cpio").exists();
-    let no_vendor_init_boot = !workdir
-        .join("vendor_ramdisk")
-        .join("init_boot.cpio")
-        .exists();
-    let no_vendor_ramdisk = !workdir.join("vendor_ramdisk").join("ramdisk.cpio").exists();
+    let mut ramdisks = Ramdisks::new(workdir);
+    let no_ramdisk = !ramdisks.exists(RAMDISK_CPIO);
+    let no_vendor_init_boot = !ramdisks.exists(VENDOR_INIT_BOOT_CPIO);
+    let no_vendor_ramdisk = !ramdisks.exists(VENDOR_RAMDISK_CPIO);
     if no_ramdisk && no_vendor_init_boot && no_vendor_ramdisk {
         println!("- No compatible ramdisk found.");
         println!("- Will create our own ramdisk!");
     }
-    let is_magisk_patched = is_magisk_patched(&magiskboot, workdir)?;
+    let is_magisk_patched = ramdisks.get(RAMDISK_CPIO)?.is_magisk_patched();
     let is_magisk_patched_vendor_init_boot =
-        is_magisk_patched_vendor_init_boot(&magiskboot, workdir)?;
-    let is_magisk_patched_vendor_ramdisk = is_magisk_patched_vendor_ramdisk(&magiskboot, workdir)?;
+        ramdisks.get(VENDOR_INIT_BOOT_CPIO)?.is_magisk_patched();
+    let is_magisk_patched_vendor_ramdisk = ramdisks.get(VENDOR_RAMDISK_CPIO)?.is_magisk_patched();
     ensure!(
         !is_magisk_patched
             || !is_magisk_patched_vendor_init_boot
@@ -646,77 +498,55 @@ fn do_patch(
     );
 
     println!("- Adding KernelSU LKM");
-    let is_kernelsu_patched = is_kernelsu_patched(&magiskboot, workdir)?;
+    let is_kernelsu_patched = ramdisks.get(RAMDISK_CPIO)?.exists("kernelsu.ko");
     let is_kernelsu_patched_vendor_init_boot =
-        is_kernelsu_patched_vendor_init_boot(&magiskboot, workdir)?;
+        ramdisks.get(VENDOR_INIT_BOOT_CPIO)?.exists("kernelsu.ko");
     let is_kernelsu_patched_vendor_ramdisk =
-        is_kernelsu_patched_vendor_ramdisk(&magiskboot, workdir)?;
+        ramdisks.get(VENDOR_RAMDISK_CPIO)?.exists("kernelsu.ko");
+
+    let (target, mode) = if !no_ramdisk {
+        (RAMDISK_CPIO, 0o755)
+    } else if !no_vendor_init_boot {
+        (VENDOR_INIT_BOOT_CPIO, 0o755)
+    } else if !no_vendor_ramdisk {
+        (VENDOR_RAMDISK_CPIO, 0o750)
+    } else {
+        (RAMDISK_CPIO, 0o755)
+    };
+    let label = target.trim_end_matches(".cpio");
+    let cpio = ramdisks.get(target)?;
 
     let mut need_backup = false;
     if (no_ramdisk && !is_kernelsu_patched_vendor_init_boot)
         || (no_ramdisk && no_vendor_init_boot && !is_kernelsu_patched_vendor_ramdisk)
         || !is_kernelsu_patched
     {
-        if !no_ramdisk {
-            println!("- Checking if /ramdisk/init exists");
-            let status = do_cpio_cmd(&magiskboot, workdir, "exists init");
-            if status.is_ok() {
-                println!("- Backing up ramdisk/init");
-                do_cpio_cmd(&magiskboot, workdir, "mv init init.real")?;
-            }
-            need_backup = flash;
-        } else if !no_vendor_init_boot {
-            println!("- Checking if /vendor_ramdisk/init_boot/init exists");
-            let status = do_vendor_init_boot_cpio_cmd(&magiskboot, workdir, "exists init");
-            if status.is_ok() {
-                println!("- Backing up vendor_ramdisk/init_boot/init");
-                do_vendor_init_boot_cpio_cmd(&magiskboot, workdir, "mv init init.real")?;
-            }
-            need_backup = flash;
-        } else if !no_vendor_ramdisk {
-            println!("- Checking if /vendor_ramdisk/ramdisk/init exists");
-            let status = do_vendor_ramdisk_cpio_cmd(&magiskboot, workdir, "exists init");
-            if status.is_ok() {
-                println!("- Backing up vendor_ramdisk/ramdisk/init");
-                do_vendor_ramdisk_cpio_cmd(&magiskboot, workdir, "mv init init.real")?;
-            }
-            need_backup = flash;
-        } else {
-            println!("- Checking if /ramdisk/init exists");
-            let status = do_cpio_cmd(&magiskboot, workdir, "exists init");
-            if status.is_ok() {
-                println!("- Backing up ramdisk/init");
-                do_cpio_cmd(&magiskboot, workdir, "mv init init.real")?;
-            }
-            need_backup = flash;
+        println!("- Checking if /{label}/init exists");
+        if cpio.exists("init") {
+            println!("- Backing up {label}/init");
+            cpio.mv("init", "init.real")?;
         }
+        need_backup = flash;
     }
 
-    if !no_ramdisk {
-        println!("- Patching /ramdisk");
-        do_cpio_cmd(&magiskboot, workdir, "add 0755 init init")?;
-        do_cpio_cmd(&magiskboot, workdir, "add 0755 kernelsu.ko kernelsu.ko")?;
-    } else if !no_vendor_init_boot {
-        println!("- Patching /vendor_ramdisk/init_boot");
-        do_vendor_init_boot_cpio_cmd(&magiskboot, workdir, "add 0755 init init")?;
-        do_vendor_init_boot_cpio_cmd(&magiskboot, workdir, "add 0755 kernelsu.ko kernelsu.ko")?;
-    } else if !no_vendor_ramdisk {
-        println!("- Patching /vendor_ramdisk/ramdisk");
-        do_vendor_ramdisk_cpio_cmd(&magiskboot, workdir, "add 0750 init init")?;
-        do_vendor_ramdisk_cpio_cmd(&magiskboot, workdir, "add 0750 kernelsu.ko kernelsu.ko")?;
+    if no_ramdisk && no_vendor_init_boot && no_vendor_ramdisk {
+        println!("- Creating and Patching /{label}");
     } else {
-        println!("- Creating and Patching /ramdisk");
-        do_cpio_cmd(&magiskboot, workdir, "add 0755 init init")?;
-        do_cpio_cmd(&magiskboot, workdir, "add 0755 kernelsu.ko kernelsu.ko")?;
+        println!("- Patching /{label}");
     }
+    cpio.add_file(mode, "init", workdir.join("init"))?;
+    cpio.add_file(mode, "kernelsu.ko", workdir.join("kernelsu.ko"))?;
 
+    // the backup marker always lives in ramdisk.cpio, which restore reads
     #[cfg(target_os = "android")]
     if need_backup {
-        if let Err(e) = do_backup(&magiskboot, workdir, &bootimage) {
+        if let Err(e) = do_backup(ramdisks.get(RAMDISK_CPIO)?, &bootimage) {
             println!("- Backup stock image failed: {e}");
         }
     }
 
+    ramdisks.save()?;
+
     println!("- Repacking boot image");
     // magiskboot repack boot.img
     let status = Command::new(&magiskboot)
@@ -759,40 +589,11 @@ fn do_patch(
 }
 
 #[cfg(target_os = "android")]
-fn calculate_sha1(file_path: impl AsRef<Path>) -> Result<String> {
-    use sha1::Digest;
-    use std::io::Read;
-    let mut file = std::fs::File::open(file_path.as_ref())?;
-    let mut hasher = sha1::Sha1::new();
-    let mut buffer = [0; 1024];
-
-    loop {
-        let n = file.read(&mut buffer)?;
-        if n == 0 {
-            break;
-        }
-        hasher.update(&buffer[..n]);
-    }
-
-    let result = hasher.finalize();
-    Ok(format!("{result:x}"))
-}
-
-#[cfg(target_os = "android")]
-fn do_backup(magiskboot: &Path, workdir: &Path, image: &str) -> Result<()> {
-    let sha1 = calculate_sha1(image)?;
-    let filename = format!("{KSU_BACKUP_FILE_PREFIX}{sha1}");
-
+fn do_backup(ramdisk: &mut Cpio, image: &str) -> Result<()> {
     println!("- Backup stock boot image");
-    // magiskboot cpio ramdisk.cpio 'add 0755 $BACKUP_FILENAME'
-    let target = format!("{KSU_BACKUP_DIR}{filename}");
-    std::fs::copy(image, &target).with_context(|| format!("backup to {target}"))?;
-    std::fs::write(workdir.join(BACKUP_FILENAME), sha1.as_bytes()).context("write sha1")?;
-    do_cpio_cmd(
-        magiskboot,
-        workdir,
-        &format!("add 0755 {BACKUP_FILENAME} {BACKUP_FILENAME}"),
-    )?;
+    let sha1 = backup::store(Path::new(image)).context("backup stock image")?;
+    let target = format!("{KSU_BACKUP_DIR}{KSU_BACKUP_FILE_PREFIX}{sha1}");
+    ramdisk.add(0o755, BACKUP_FILENAME, sha1.into_bytes());
     println!("- Stock image has been backup to");
     println!("- {target}");
     Ok(())
@@ -818,7 +619,7 @@ fn clean_backup(sha1: &str) -> Result<()> {
             }
         }
     }
-    Ok(())
+    backup::prune_chunks()
 }
 
 fn flash_boot(bootdevice: &Option<String>, new_boot: PathBuf) -> Result<()> {
@@ -830,7 +631,17 @@ fn flash_boot(bootdevice: &Option<String>, new_boot: PathBuf) -> Result<()> {
         .arg(bootdevice)
         .status()?;
     ensure!(status.success(), "set boot device rw failed");
-    dd(new_boot, bootdevice).context("flash boot failed")?;
+    if backup::is_chunked(&new_boot) {
+        backup::restore_to(&new_boot, Path::new(bootdevice)).context("flash boot failed")?;
+    } else {
+        let stats =
+            flash::flash_image(&new_boot, Path::new(bootdevice)).context("flash boot failed")?;
+        println!(
+            "- Wrote {}, skipped {} unchanged",
+            humansize::format_size(stats.written, humansize::DECIMAL),
+            humansize::format_size(stats.skipped, humansize::DECIMAL)
+        );
+    }
     Ok(())
 }
 
@@ -1000,6 +811,7 @@ fn find_boot_image(
 fn post_ota() -> Result<()> {
     use crate::defs::ADB_DIR;
     use assets::BOOTCTL_PATH;
+    assets::ensure_asset("bootctl")?;
     let status = Command::new(BOOTCTL_PATH).arg("hal-info").status()?;
     if !status.success() {
         return Ok(());
@@ -0,0 +1,297 @@
+use anyhow::{Result, bail};
+use flate2::{Compression, write::GzEncoder};
+use std::{
+    fs::File,
+    io::{BufRead, BufReader, Read, Write},
+    path::{Path, PathBuf},
+    process::{Child, ChildStdout, Command, Stdio},
+    sync::{
+        Arc,
+        atomic::{AtomicBool, Ordering},
+    },
+    thread,
+    time::{Duration, Instant},
+};
+
+use crate::{defs, utils};
+
+// raw bytes per segment, and segments kept per log: at most 4 MiB of text
+// per log ever reaches the flash, deflated
+const SEGMENT_SIZE: usize = 256 << 10;
+const SEGMENTS: u32 = 16;
+// unwritten lines are appended to the open segment after this long, so a
+// bootloop loses seconds of log, not a quarter MiB
+const SEGMENT_AGE: Duration = Duration::from_secs(3);
+
+// keep capturing this long after boot-completed, and never longer than
+// MAX_CAPTURE in total so a bootloop does not log forever
+const GRACE: Duration = Duration::from_secs(15);
+const MAX_CAPTURE: Duration = Duration::from_secs(300);
+const POLL: Duration = Duration::from_millis(500);
+
+const LOGCAT_FILTER: &[&str] = &["*:I"];
+// kernel messages up to KERN_INFO, debug noise is dropped
+const KMSG_MAX_LEVEL: u32 = 6;
+
+/// A log kept as a ring of gzip segments, `<name>.<seq>.gz`. Only the
+/// last `SEGMENTS` survive. Every sync appends the lines not yet on disk
+/// to the open segment as one more gzip member, so a segment, and the
+/// segments concatenated in order, are each one valid gzip stream. A
+/// segment is closed once it holds `SEGMENT_SIZE` raw bytes.
+struct LogRing {
+    dir: PathBuf,
+    name: &'static str,
+    // lines not on disk yet
+    buffer: Vec<u8>,
+    // raw bytes already in the open segment
+    written: usize,
+    seq: u32,
+    // oldest line not on disk yet
+    unsynced: Option<Instant>,
+}
+
+impl LogRing {
+    fn new(dir: &Path, name: &'static str) -> Self {
+        Self {
+            dir: dir.to_path_buf(),
+            name,
+            buffer: Vec::with_capacity(SEGMENT_SIZE + 4096),
+            written: 0,
+            seq: 0,
+            unsynced: None,
+        }
+    }
+
+    fn segment(&self, seq: u32) -> PathBuf {
+        self.dir.join(format!("{}.{seq:04}.gz", self.name))
+    }
+
+    fn push(&mut self, line: &[u8]) {
+        self.buffer.extend_from_slice(line);
+        if !line.ends_with(b"\n") {
+            self.buffer.push(b'\n');
+        }
+        self.unsynced.get_or_insert_with(Instant::now);
+        if self.written + self.buffer.len() >= SEGMENT_SIZE {
+            self.flush();
+        } else {
+            self.tick();
+        }
+    }
+
+    /// Append to the open segment if its oldest unwritten line is too old,
+    /// also called while the source is quiet.
+    fn tick(&mut self) {
+        if self
+            .unsynced
+            .is_some_and(|since| since.elapsed() >= SEGMENT_AGE)
+        {
+            self.sync();
+        }
+    }
+
+    fn sync(&mut self) {
+        if let Err(e) = self.append_member() {
+            log::warn!("bootlog: write {} segment: {e}", self.name);
+        }
+        // dropped on error too, the next member must not repeat them
+        self.written += self.buffer.len();
+        self.buffer.clear();
+        self.unsynced = None;
+    }
+
+    /// Close the open segment, the next line starts a new one.
+    fn flush(&mut self) {
+        if self.unsynced.is_some() {
+            self.sync();
+        }
+        if self.written == 0 {
+            return;
+        }
+        self.written = 0;
+        self.seq += 1;
+    }
+
+    fn append_member(&mut self) -> Result<()> {
+        if self.written == 0 && self.seq >= SEGMENTS {
+            let _ = std::fs::remove_file(self.segment(self.seq - SEGMENTS));
+        }
+        let file = File::options()
+            .create(true)
+            .append(true)
+            .open(self.segment(self.seq))?;
+        let mut encoder = GzEncoder::new(file, Compression::fast());
+        encoder.write_all(&self.buffer)?;
+        encoder.finish()?;
+        Ok(())
+    }
+}
+
+fn spawn_logcat() -> Result<Child> {
+    Ok(Command::new("logcat")
+        .args(["-v", "threadtime"])
+        .args(LOGCAT_FILTER)
+        .stdin(Stdio::null())
+        .stdout(Stdio::piped())
+        .stderr(Stdio::null())
+        .spawn()?)
+}
+
+// runs until logcat is killed and the pipe hits EOF
+fn capture_logcat(stdout: ChildStdout, mut ring: LogRing) -> Result<()> {
+    use std::os::unix::io::AsRawFd;
+
+    let fd = stdout.as_raw_fd();
+    let mut reader = BufReader::new(stdout);
+    let mut line = Vec::new();
+    loop {
+        // wait for more with a timeout, so a quiet logcat still gets synced
+        if reader.buffer().is_empty() {
+            let mut pollfd = libc::pollfd {
+                fd,
+                events: libc::POLLIN,
+                revents: 0,
+            };
+            // SAFETY: one valid pollfd, the pipe outlives the call.
+            let ready = unsafe { libc::poll(&mut pollfd, 1, POLL.as_millis() as libc::c_int) };
+            if ready == 0 {
+                ring.tick();
+                continue;
+            }
+        }
+        line.clear();
+        if reader.read_until(b'\n', &mut line)? == 0 {
+            break;
+        }
+        ring.push(&line);
+    }
+    ring.flush();
+    Ok(())
+}
+
+// "<prio>,<seq>,<usec>,<flags>;<message>" from /dev/kmsg, as dmesg prints it
+fn format_kmsg(record: &[u8]) -> Option<Vec<u8>> {
+    let split = record.iter().position(|&b| b == b';')?;
+    let header = std::str::from_utf8(&record[..split]).ok()?;
+    let mut fields = header.split(',');
+    let prio: u32 = fields.next()?.parse().ok()?;
+    let _seq = fields.next()?;
+    let usec: u64 = fields.next()?.parse().ok()?;
+    if prio & 7 > KMSG_MAX_LEVEL {
+        return None;
+    }
+    // continuation lines carry the structured dictionary, skip them
+    let message = record[split + 1..].split(|&b| b == b'\n').next()?;
+    let mut line = format!("[{:5}.{:06}] ", usec / 1_000_000, usec % 1_000_000).into_bytes();
+    line.extend_from_slice(message);
+    Some(line)
+}
+
+fn capture_kmsg(mut ring: LogRing, stop: Arc<AtomicBool>) -> Result<()> {
+    use std::os::unix::fs::OpenOptionsExt;
+
+    let mut kmsg = File::options()
+        .read(true)
+        .custom_flags(libc::O_NONBLOCK)
+        .open("/dev/kmsg")?;
+    // every read returns exactly one record
+    let mut record = vec![0u8; 8192];
+    while !stop.load(Ordering::Relaxed) {
+        match kmsg.read(&mut record) {
+            Ok(0) => break,
+            Ok(n) => {
+                if let Some(line) = format_kmsg(&record[..n]) {
+                    ring.push(&line);
+                }
+            }
+            Err(e) if e.kind() == std::io::ErrorKind::WouldBlock => {
+                ring.tick();
+                thread::sleep(POLL);
+            }
+            // records overwritten before we got to them
+            Err(e) if e.raw_os_error() == Some(libc::EPIPE) => {}
+            Err(e) => return Err(e.into()),
+        }
+    }
+    ring.flush();
+    Ok(())
+}
+
+fn boot_completed() -> bool {
+    utils::getprop("sys.boot_completed").is_some_and(|v| v == "1")
+}
+
+/// Start the capture in the background, detached from post-fs-data.
+pub fn start() -> Result<()> {
+    use std::os::unix::process::CommandExt;
+
+    let mut cmd = Command::new(defs::DAEMON_PATH);
+    cmd.arg("boot-log")
+        .stdin(Stdio::null())
+        .stdout(Stdio::null())
+        .stderr(Stdio::null())
+        .current_dir("/");
+    unsafe {
+        cmd.pre_exec(|| {
+            libc::setsid();
+            utils::switch_cgroups();
+            Ok(())
+        });
+    }
+    let child = cmd.spawn()?;
+    log::info!("bootlog: capture started with pid: {}", child.id());
+    Ok(())
+}
+
+/// Capture logcat and the kernel log into gzip rings under
+/// `BOOTLOG_DIR` until boot-completed plus a grace period. The previous
+/// boot's logs are kept in `BOOTLOG_OLD_DIR`.
+pub fn run() -> Result<()> {
+    let dir = Path::new(defs::BOOTLOG_DIR);
+    let old = Path::new(defs::BOOTLOG_OLD_DIR);
+    if old.exists() {
+        std::fs::remove_dir_all(old)?;
+    }
+    if dir.exists() {
+        std::fs::rename(dir, old)?;
+    }
+    utils::ensure_dir_exists(dir)?;
+
+    let stop = Arc::new(AtomicBool::new(false));
+    let mut logcat_child = spawn_logcat()?;
+    let Some(stdout) = logcat_child.stdout.take() else {
+        bail!("logcat has no stdout");
+    };
+    let logcat = {
+        let ring = LogRing::new(dir, "logcat");
+        thread::spawn(move || capture_logcat(stdout, ring))
+    };
+    let kmsg = {
+        let (ring, stop) = (LogRing::new(dir, "dmesg"), stop.clone());
+        thread::spawn(move || capture_kmsg(ring, stop))
+    };
+
+    let start = Instant::now();
+    let mut completed_at = None;
+    while start.elapsed() < MAX_CAPTURE {
+        if completed_at.is_none() && boot_completed() {
+            completed_at = Some(Instant::now());
+        }
+        if completed_at.is_some_and(|at| at.elapsed() >= GRACE) {
+            break;
+        }
+        thread::sleep(POLL);
+    }
+    stop.store(true, Ordering::Relaxed);
+    let _ = logcat_child.kill();
+    let _ = logcat_child.wait();
+
+    for (name, handle) in [("logcat", logcat), ("dmesg", kmsg)] {
+        match handle.join() {
+            Ok(Err(e)) => log::warn!("bootlog: {name}: {e}"),
+            Err(_) => log::warn!("bootlog: {name} capture panicked"),
+            Ok(Ok(())) => {}
+        }
+    }
+    Ok(())
+}
@@ -38,6 +38,14 @@ enum Commands {
     /// Trigger `boot-complete` event
     BootCompleted,
 
+    /// Capture boot logs until shortly after boot-completed
+    #[command(hide = true)]
+    BootLog,
+
+    /// Serve the manager's requests over a unix socket
+    #[command(hide = true)]
+    Daemon,
+
     /// Install KernelSU userspace component to system
     Install {
         #[arg(long, default_value = None)]
@@ -173,6 +181,31 @@ enum Debug {
 
     Mount,
 
+    /// Dump the root grant audit log from the kernel event ring
+    Events {
+        /// keep streaming new events
+        #[arg(short, long, default_value = "false")]
+        follow: bool,
+    },
+
+    /// Serve `su -c` requests from pre-forked root workers
+    SuBroker,
+
+    /// Compare `su -c` latency against the su broker
+    SuBench {
+        /// number of runs per mode
+        #[arg(short, long, default_value = "100")]
+        count: usize,
+
+        /// drop the page cache before every su run
+        #[arg(long)]
+        cold: bool,
+
+        /// command to run
+        #[arg(default_value_t = String::from("true"))]
+        command: String,
+    },
+
     /// For testing
     Test,
 }
@@ -237,7 +270,14 @@ enum Module {
     },
 
     /// list all modules
-    List,
+    List {
+        /// print json on a single line
+        #[arg(short, long, default_value = "false")]
+        compact: bool,
+    },
+
+    /// print the size of every module as a json map
+    Sizes,
 }
 
 #[derive(clap::Subcommand, Debug)]
@@ -292,6 +332,11 @@ mod kpm_cmd {
             path: PathBuf,
             args: Option<String>,
         },
+        /// Load several KPM modules in one kernel call: load-batch <path[:args]>...
+        LoadBatch {
+            #[arg(required = true)]
+            modules: Vec<String>,
+        },
         /// Unload a KPM module: unload <name>
         Unload { name: String },
         /// Get number of loaded modules
@@ -304,6 +349,9 @@ mod kpm_cmd {
         Control { name: String, args: String },
         /// Print KPM Loader version
         Version,
+        /// Watch /data/adb/kpm and hot (un)load modules on change
+        #[command(hide = true)]
+        Watch,
     }
 }
 
@@ -318,12 +366,6 @@ pub fn run() -> Result<()> {
     #[cfg(not(target_os = "android"))]
     env_logger::init();
 
-    // the kernel executes su with argv[0] = "su" and replace it with us
-    let arg0 = std::env::args().next().unwrap_or_default();
-    if arg0 == "su" || arg0 == "/system/bin/su" {
-        return crate::su::root_shell();
-    }
-
     let cli = Args::parse();
 
     if !cli.verbose && !Path::new(KSUD_VERBOSE_LOG_FILE).exists() {
@@ -335,11 +377,13 @@ pub fn run() -> Result<()> {
     let result = match cli.command {
         Commands::PostFsData => init_event::on_post_data_fs(),
         Commands::BootCompleted => init_event::on_boot_completed(),
+        Commands::BootLog => crate::bootlog::run(),
+        Commands::Daemon => crate::rpc::run(),
 
         Commands::Module { command } => {
             #[cfg(any(target_os = "linux", target_os = "android"))]
             {
-                utils::switch_mnt_ns(1)?;
+                utils::switch_global_mnt_ns()?;
             }
             match command {
                 Module::Install { zip } => module::install_module(&zip),
@@ -348,7 +392,8 @@ pub fn run() -> Result<()> {
                 Module::Enable { id } => module::enable_module(&id),
                 Module::Disable { id } => module::disable_module(&id),
                 Module::Action { id } => module::run_action(&id),
-                Module::List => module::list_modules(),
+                Module::List { compact } => module::list_modules(compact),
+                Module::Sizes => module::module_sizes(),
             }
         }
         Commands::Install { magiskboot } => utils::install(magiskboot),
@@ -383,6 +428,13 @@ pub fn run() -> Result<()> {
             }
             Debug::Su { global_mnt } => crate::su::grant_root(global_mnt),
             Debug::Mount => init_event::mount_modules_systemlessly(),
+            Debug::Events { follow } => crate::audit::dump_events(follow),
+            Debug::SuBroker => crate::su_broker::serve(),
+            Debug::SuBench {
+                count,
+                cold,
+                command,
+            } => crate::su_broker::bench(count, &command, cold),
             Debug::Test => assets::ensure_binaries(false),
         },
 
@@ -421,6 +473,18 @@ pub fn run() -> Result<()> {
             use crate::cli::kpm_cmd::Kpm;
             match command {
                 Kpm::Load { path, args } => crate::kpm::kpm_load(path.to_str().unwrap(), args.as_deref()),
+                Kpm::LoadBatch { modules } => {
+                    let items: Vec<_> = modules
+                        .iter()
+                        .map(|m| match m.split_once(':') {
+                            Some((path, args)) => (PathBuf::from(path), Some(args.to_string())),
+                            None => (PathBuf::from(m), None),
+                        })
+                        .collect();
+                    let (ok, ng) = crate::kpm::kpm_load_batch(&items)?;
+                    println!("loaded: {ok}, failed: {ng}");
+                    Ok(())
+                }
                 Kpm::Unload { name } => crate::kpm::kpm_unload(&name),
                 Kpm::Num => crate::kpm::kpm_num().map(|_| ()),
                 Kpm::List => crate::kpm::kpm_list(),
@@ -431,6 +495,7 @@ pub fn run() -> Result<()> {
                     Ok(())
                 }
                 Kpm::Version => crate::kpm::kpm_version_loader(),
+                Kpm::Watch => crate::kpm::run_kpm_watcher(),
             }
         }
     };
@@ -0,0 +1,241 @@
+use anyhow::{Context, Result, bail, ensure};
+use memchr::memmem;
+use std::{
+    collections::BTreeMap,
+    fs::File,
+    io::{BufWriter, Write},
+    path::Path,
+};
+
+const NEWC_MAGIC: &[u8] = b"070701";
+const NEWC_CRC_MAGIC: &[u8] = b"070702";
+const HEADER_SIZE: usize = 110;
+const TRAILER: &str = "TRAILER!!!";
+const S_IFREG: u32 = 0o100000;
+// magiskboot numbers inodes from here too
+const FIRST_INODE: u32 = 300000;
+
+// same markers as `magiskboot cpio test`
+const OTHER_PATCHED: &[&str] = &[
+    "sbin/launch_daemonsu.sh",
+    "sbin/su",
+    "init.xposed.rc",
+    "boot/sbin/launch_daemonsu.sh",
+];
+const MAGISK_PATCHED: &[&str] = &[
+    ".backup/.magisk",
+    "init.magisk.rc",
+    "overlay/init.magisk.rc",
+];
+
+struct Entry {
+    mode: u32,
+    uid: u32,
+    gid: u32,
+    rdevmajor: u32,
+    rdevminor: u32,
+    data: Vec<u8>,
+}
+
+/// An uncompressed newc ramdisk held in memory, so a whole batch of
+/// `magiskboot cpio` style edits costs one read and one write.
+#[derive(Default)]
+pub struct Cpio {
+    entries: BTreeMap<String, Entry>,
+    modified: bool,
+}
+
+fn align4(n: usize) -> usize {
+    (n + 3) & !3
+}
+
+fn norm_name(name: &str) -> String {
+    name.trim_start_matches("./").trim_matches('/').to_string()
+}
+
+fn hex_field(header: &[u8], index: usize) -> Result<u32> {
+    let start = 6 + index * 8;
+    let field = std::str::from_utf8(&header[start..start + 8])?;
+    u32::from_str_radix(field, 16).with_context(|| format!("bad cpio header field {field:?}"))
+}
+
+impl Cpio {
+    /// Load `path`, or start empty if it does not exist like magiskboot does.
+    pub fn load(path: impl AsRef<Path>) -> Result<Self> {
+        let path = path.as_ref();
+        if !path.exists() {
+            return Ok(Self::default());
+        }
+        let data = std::fs::read(path).with_context(|| format!("read {}", path.display()))?;
+        Self::parse(&data).with_context(|| format!("parse {}", path.display()))
+    }
+
+    fn parse(data: &[u8]) -> Result<Self> {
+        let mut cpio = Self::default();
+        let mut pos = 0;
+        while pos + HEADER_SIZE <= data.len() {
+            let header = &data[pos..pos + HEADER_SIZE];
+            ensure!(
+                &header[..6] == NEWC_MAGIC || &header[..6] == NEWC_CRC_MAGIC,
+                "bad cpio magic at {pos}"
+            );
+            let mode = hex_field(header, 1)?;
+            let uid = hex_field(header, 2)?;
+            let gid = hex_field(header, 3)?;
+            let file_size = hex_field(header, 6)? as usize;
+            let rdevmajor = hex_field(header, 9)?;
+            let rdevminor = hex_field(header, 10)?;
+            let name_size = hex_field(header, 11)? as usize;
+
+            let name_start = pos + HEADER_SIZE;
+            let data_start = align4(name_start + name_size);
+            let data_end = data_start + file_size;
+            ensure!(
+                name_size > 0 && data_end <= data.len(),
+                "truncated cpio entry at {pos}"
+            );
+            let name = &data[name_start..name_start + name_size - 1];
+            let name = std::str::from_utf8(name)?;
+            pos = align4(data_end);
+
+            // ramdisks can be several archives back to back, each with its
+            // own trailer and zero padding; keep going like magiskboot does
+            if name == TRAILER {
+                let next = data
+                    .get(pos..)
+                    .and_then(|rest| memmem::find(rest, NEWC_MAGIC));
+                match next {
+                    Some(next) => {
+                        pos += next;
+                        continue;
+                    }
+                    None => break,
+                }
+            }
+            if name == "." || name == ".." {
+                continue;
+            }
+            cpio.entries.insert(
+                norm_name(name),
+                Entry {
+                    mode,
+                    uid,
+                    gid,
+                    rdevmajor,
+                    rdevminor,
+                    data: data[data_start..data_end].to_vec(),
+                },
+            );
+        }
+        Ok(cpio)
+    }
+
+    pub fn is_modified(&self) -> bool {
+        self.modified
+    }
+
+    pub fn exists(&self, name: &str) -> bool {
+        self.entries.contains_key(&norm_name(name))
+    }
+
+    pub fn get(&self, name: &str) -> Option<&[u8]> {
+        self.entries
+            .get(&norm_name(name))
+            .map(|e| e.data.as_slice())
+    }
+
+    /// Equivalent of `magiskboot cpio test` returning 1.
+    pub fn is_magisk_patched(&self) -> bool {
+        !OTHER_PATCHED.iter().any(|f| self.exists(f))
+            && MAGISK_PATCHED.iter().any(|f| self.exists(f))
+    }
+
+    pub fn add(&mut self, mode: u32, name: &str, data: Vec<u8>) {
+        self.entries.insert(
+            norm_name(name),
+            Entry {
+                mode: S_IFREG | (mode & 0o7777),
+                uid: 0,
+                gid: 0,
+                rdevmajor: 0,
+                rdevminor: 0,
+                data,
+            },
+        );
+        self.modified = true;
+    }
+
+    pub fn add_file(&mut self, mode: u32, name: &str, src: impl AsRef<Path>) -> Result<()> {
+        let src = src.as_ref();
+        let data = std::fs::read(src).with_context(|| format!("read {}", src.display()))?;
+        self.add(mode, name, data);
+        Ok(())
+    }
+
+    pub fn rm(&mut self, name: &str) {
+        if self.entries.remove(&norm_name(name)).is_some() {
+            self.modified = true;
+        }
+    }
+
+    pub fn mv(&mut self, from: &str, to: &str) -> Result<()> {
+        let Some(entry) = self.entries.remove(&norm_name(from)) else {
+            bail!("cpio entry {from} not found");
+        };
+        self.entries.insert(norm_name(to), entry);
+        self.modified = true;
+        Ok(())
+    }
+
+    pub fn dump(&self, path: impl AsRef<Path>) -> Result<()> {
+        let path = path.as_ref();
+        let mut out = BufWriter::new(
+            File::create(path).with_context(|| format!("create {}", path.display()))?,
+        );
+        let mut written = 0;
+        let mut inode = FIRST_INODE;
+        for (name, entry) in &self.entries {
+            written += write_entry(&mut out, inode, name, entry)?;
+            inode += 1;
+        }
+        let trailer = Entry {
+            mode: 0o755,
+            uid: 0,
+            gid: 0,
+            rdevmajor: 0,
+            rdevminor: 0,
+            data: Vec::new(),
+        };
+        written += write_entry(&mut out, inode, TRAILER, &trailer)?;
+        out.flush()?;
+        log::info!("cpio: wrote {} ({written} bytes)", path.display());
+        Ok(())
+    }
+}
+
+fn write_entry(out: &mut impl Write, inode: u32, name: &str, entry: &Entry) -> Result<usize> {
+    let data = &entry.data;
+    let header = format!(
+        "070701{inode:08x}{:08x}{:08x}{:08x}{:08x}{:08x}{:08x}{:08x}{:08x}{:08x}{:08x}{:08x}{:08x}",
+        entry.mode,
+        entry.uid,
+        entry.gid,
+        1, // nlink
+        0, // mtime
+        data.len(),
+        0, // devmajor
+        0, // devminor
+        entry.rdevmajor,
+        entry.rdevminor,
+        name.len() + 1,
+        0, // check
+    );
+    let name_end = HEADER_SIZE + name.len() + 1;
+    let padding = [0u8; 4];
+    out.write_all(header.as_bytes())?;
+    out.write_all(name.as_bytes())?;
+    out.write_all(&padding[..align4(name_end) - name_end + 1])?;
+    out.write_all(data)?;
+    out.write_all(&padding[..align4(data.len()) - data.len()])?;
+    Ok(align4(name_end) + align4(data.len()))
+}
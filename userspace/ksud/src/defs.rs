@@ -4,11 +4,18 @@ pub const ADB_DIR: &str = "/data/adb/";
 pub const WORKING_DIR: &str = concatcp!(ADB_DIR, "ksu/");
 pub const BINARY_DIR: &str = concatcp!(WORKING_DIR, "bin/");
 pub const LOG_DIR: &str = concatcp!(WORKING_DIR, "log/");
+pub const BOOTLOG_DIR: &str = concatcp!(LOG_DIR, "bootlog/");
+pub const BOOTLOG_OLD_DIR: &str = concatcp!(LOG_DIR, "bootlog.old/");
 
 pub const PROFILE_DIR: &str = concatcp!(WORKING_DIR, "profile/");
 pub const PROFILE_SELINUX_DIR: &str = concatcp!(PROFILE_DIR, "selinux/");
 pub const PROFILE_TEMPLATE_DIR: &str = concatcp!(PROFILE_DIR, "templates/");
 
+pub const SEPOLICY_CACHE_DIR: &str = concatcp!(WORKING_DIR, "sepolicy_cache/");
+pub const MODULE_INDEX_PATH: &str = concatcp!(WORKING_DIR, ".module_index");
+pub const MODULE_SIZES_PATH: &str = concatcp!(WORKING_DIR, ".module_sizes");
+pub const SCRIPT_CONFIG_PATH: &str = concatcp!(WORKING_DIR, ".script_config");
+
 pub const KSURC_PATH: &str = concatcp!(WORKING_DIR, ".ksurc");
 pub const KSU_MOUNT_SOURCE: &str = "KSU";
 pub const DAEMON_PATH: &str = concatcp!(ADB_DIR, "ksud");
@@ -37,6 +44,7 @@ pub const VERSION_NAME: &str = include_str!(concat!(env!("OUT_DIR"), "/VERSION_N
 pub const KSU_BACKUP_DIR: &str = WORKING_DIR;
 pub const KSU_BACKUP_FILE_PREFIX: &str = "ksu_backup_";
 pub const BACKUP_FILENAME: &str = "stock_image.sha1";
+pub const KSU_BACKUP_CHUNK_DIR: &str = concatcp!(KSU_BACKUP_DIR, "backup_chunks/");
 
 pub const NO_TMPFS_PATH: &str = concatcp!(WORKING_DIR, ".notmpfs");
 pub const NO_MOUNT_PATH: &str = concatcp!(WORKING_DIR, ".nomount");
@@ -0,0 +1,164 @@
+use anyhow::{Context, Result, ensure};
+use sha1::{Digest, Sha1};
+use std::{
+    alloc::{Layout, alloc_zeroed, dealloc, handle_alloc_error},
+    fs::{File, OpenOptions},
+    io::{Seek, SeekFrom},
+    ops::{Deref, DerefMut},
+    os::{
+        fd::AsRawFd,
+        unix::fs::{FileExt, OpenOptionsExt},
+    },
+    path::Path,
+    ptr::NonNull,
+};
+
+// O_DIRECT wants page aligned buffers, offsets and lengths
+const ALIGN: usize = 4096;
+const BLOCK_SIZE: usize = 1 << 20;
+
+pub struct FlashStats {
+    pub written: u64,
+    pub skipped: u64,
+}
+
+struct AlignedBuf {
+    ptr: NonNull<u8>,
+    layout: Layout,
+}
+
+impl AlignedBuf {
+    fn new(len: usize) -> Self {
+        let layout = Layout::from_size_align(len, ALIGN).expect("bad buffer layout");
+        // SAFETY: layout has a non-zero size.
+        let ptr = unsafe { alloc_zeroed(layout) };
+        let Some(ptr) = NonNull::new(ptr) else {
+            handle_alloc_error(layout)
+        };
+        Self { ptr, layout }
+    }
+}
+
+impl Deref for AlignedBuf {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        // SAFETY: ptr owns layout.size() initialized bytes.
+        unsafe { std::slice::from_raw_parts(self.ptr.as_ptr(), self.layout.size()) }
+    }
+}
+
+impl DerefMut for AlignedBuf {
+    fn deref_mut(&mut self) -> &mut [u8] {
+        // SAFETY: as above, and we hold the only reference.
+        unsafe { std::slice::from_raw_parts_mut(self.ptr.as_ptr(), self.layout.size()) }
+    }
+}
+
+impl Drop for AlignedBuf {
+    fn drop(&mut self) {
+        // SAFETY: allocated in new() with the same layout.
+        unsafe { dealloc(self.ptr.as_ptr(), self.layout) };
+    }
+}
+
+fn align_up(n: usize) -> usize {
+    n.div_ceil(ALIGN) * ALIGN
+}
+
+fn open_device(device: &Path) -> Result<File> {
+    let direct = OpenOptions::new()
+        .read(true)
+        .write(true)
+        .custom_flags(libc::O_DIRECT)
+        .open(device);
+    match direct {
+        Ok(file) => Ok(file),
+        // not every block driver supports O_DIRECT
+        Err(e) if e.raw_os_error() == Some(libc::EINVAL) => {
+            log::warn!("{} does not support O_DIRECT", device.display());
+            Ok(OpenOptions::new().read(true).write(true).open(device)?)
+        }
+        Err(e) => Err(e).with_context(|| format!("open {}", device.display())),
+    }
+}
+
+/// Write `image` to the start of `device`, skipping every page that already
+/// holds the same bytes, then fsync and verify the result by re-hashing it
+/// from the device.
+pub fn flash_image(image: &Path, device: &Path) -> Result<FlashStats> {
+    let image_file = File::open(image).with_context(|| format!("open {}", image.display()))?;
+    let size = image_file.metadata()?.len();
+    let mut dev = open_device(device)?;
+    let dev_size = dev.seek(SeekFrom::End(0))?;
+    ensure!(
+        size <= dev_size,
+        "image is larger than {} ({size} > {dev_size})",
+        device.display()
+    );
+
+    let mut img = vec![0u8; BLOCK_SIZE];
+    let mut cur = AlignedBuf::new(BLOCK_SIZE);
+    let mut expected = Sha1::new();
+    let mut stats = FlashStats {
+        written: 0,
+        skipped: 0,
+    };
+
+    let mut offset = 0u64;
+    while offset < size {
+        let n = (size - offset).min(BLOCK_SIZE as u64) as usize;
+        // the last span is rounded up to a page and keeps the device's tail
+        let span = (align_up(n) as u64).min(dev_size - offset) as usize;
+        image_file.read_exact_at(&mut img[..n], offset)?;
+        dev.read_exact_at(&mut cur[..span], offset)?;
+        expected.update(&img[..n]);
+
+        let mut page = 0;
+        while page < n {
+            let end = (page + ALIGN).min(n);
+            if img[page..end] == cur[page..end] {
+                stats.skipped += (end - page) as u64;
+                page = end;
+                continue;
+            }
+
+            // coalesce consecutive changed pages into one write
+            let start = page;
+            while page < n {
+                let end = (page + ALIGN).min(n);
+                if img[page..end] == cur[page..end] {
+                    break;
+                }
+                page = end;
+            }
+            cur[start..page].copy_from_slice(&img[start..page]);
+            let write_end = if page == n { span } else { page };
+            dev.write_all_at(&cur[start..write_end], offset + start as u64)?;
+            stats.written += (page - start) as u64;
+        }
+        offset += n as u64;
+    }
+    dev.sync_all()?;
+
+    // make sure the verify pass reads the media, not the page cache
+    // SAFETY: plain advice on a valid fd.
+    unsafe { libc::posix_fadvise(dev.as_raw_fd(), 0, 0, libc::POSIX_FADV_DONTNEED) };
+
+    let mut actual = Sha1::new();
+    let mut offset = 0u64;
+    while offset < size {
+        let n = (size - offset).min(BLOCK_SIZE as u64) as usize;
+        let span = (align_up(n) as u64).min(dev_size - offset) as usize;
+        dev.read_exact_at(&mut cur[..span], offset)?;
+        actual.update(&cur[..n]);
+        offset += n as u64;
+    }
+    ensure!(
+        expected.finalize() == actual.finalize(),
+        "verify {} failed after flashing",
+        device.display()
+    );
+
+    Ok(stats)
+}
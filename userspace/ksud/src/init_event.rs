@@ -14,9 +14,9 @@ pub fn on_post_data_fs() -> Result<()> {
     utils::umask(0);
 
     #[cfg(unix)]
-    let _ = catch_bootlog("logcat", vec!["logcat"]);
-    #[cfg(unix)]
-    let _ = catch_bootlog("dmesg", vec!["dmesg", "-w"]);
+    if let Err(e) = crate::bootlog::start() {
+        warn!("Failed to start bootlog capture: {e:#}");
+    }
 
     if utils::has_magisk() {
         warn!("Magisk detected, skip post-fs-data!");
@@ -34,7 +34,7 @@ pub fn on_post_data_fs() -> Result<()> {
         }
     }
 
-    assets::ensure_binaries(true).with_context(|| "Failed to extract bin assets")?;
+    assets::ensure_boot_binaries().with_context(|| "Failed to extract bin assets")?;
 
     // Start UID scanner daemon with highest priority
     uid_scanner::start_uid_scanner_daemon()?;
@@ -72,6 +72,10 @@ pub fn on_post_data_fs() -> Result<()> {
         warn!("apply root profile sepolicy failed: {e}");
     }
 
+    if let Err(e) = crate::sepolicy::prune_rule_cache() {
+        warn!("prune sepolicy cache failed: {e}");
+    }
+
     #[cfg(target_arch = "aarch64")]
     if let Err(e) = kpm::start_kpm_watcher() {
         warn!("KPM: Failed to start KPM watcher: {}", e);
@@ -97,8 +101,7 @@ pub fn on_post_data_fs() -> Result<()> {
         info!("no tmpfs requested");
     }
 
-    // exec modules post-fs-data scripts
-    // TODO: Add timeout
+    // exec modules post-fs-data scripts, bounded by the script limits
     if let Err(e) = crate::module::exec_stage_script("post-fs-data", true) {
         warn!("exec post-fs-data scripts failed: {e}");
     }
@@ -179,6 +182,10 @@ pub fn on_services() -> Result<()> {
     info!("on_services triggered!");
     run_stage("service", false);
 
+    if let Err(e) = crate::rpc::start() {
+        warn!("Failed to start ksud daemon: {e:#}");
+    }
+
     Ok(())
 }
 
@@ -190,41 +197,3 @@ pub fn on_boot_completed() -> Result<()> {
 
     Ok(())
 }
-
-#[cfg(unix)]
-fn catch_bootlog(logname: &str, command: Vec<&str>) -> Result<()> {
-    use std::os::unix::process::CommandExt;
-    use std::process::Stdio;
-
-    let logdir = Path::new(defs::LOG_DIR);
-    utils::ensure_dir_exists(logdir)?;
-    let bootlog = logdir.join(format!("{logname}.log"));
-    let oldbootlog = logdir.join(format!("{logname}.old.log"));
-
-    if bootlog.exists() {
-        std::fs::rename(&bootlog, oldbootlog)?;
-    }
-
-    let bootlog = std::fs::File::create(bootlog)?;
-
-    let mut args = vec!["-s", "9", "30s"];
-    args.extend_from_slice(&command);
-    // timeout -s 9 30s logcat > boot.log
-    let result = unsafe {
-        std::process::Command::new("timeout")
-            .process_group(0)
-            .pre_exec(|| {
-                utils::switch_cgroups();
-                Ok(())
-            })
-            .args(args)
-            .stdout(Stdio::from(bootlog))
-            .spawn()
-    };
-
-    if let Err(e) = result {
-        warn!("Failed to start logcat: {e:#}");
-    }
-
-    Ok(())
-}
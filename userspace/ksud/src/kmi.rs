@@ -0,0 +1,212 @@
+use anyhow::{Context, Result, bail, ensure};
+use flate2::read::GzDecoder;
+use memchr::memmem;
+use regex_lite::Regex;
+use std::{fs::File, io::Read, os::fd::AsRawFd, path::Path, ptr, sync::LazyLock};
+
+const BANNER: &[u8] = b"Linux version ";
+// longest banner we expect, also the overlap kept between stream windows
+const MAX_BANNER: usize = 1024;
+const WINDOW: usize = 4 << 20;
+
+const GZIP_MAGIC: &[u8] = &[0x1f, 0x8b];
+const LZ4_LEGACY_MAGIC: u32 = 0x184c2102;
+
+static KMI_RE: LazyLock<Regex> =
+    LazyLock::new(|| Regex::new(r"(?:.* )?(\d+\.\d+)(?:\S+)?(android\d+)").unwrap());
+
+/// Read-only private mapping of a whole file.
+struct Mapping {
+    addr: *mut libc::c_void,
+    len: usize,
+}
+
+impl Mapping {
+    fn new(file: &File) -> Result<Self> {
+        let len = file.metadata()?.len() as usize;
+        ensure!(len > 0, "empty kernel image");
+        // SAFETY: fresh read-only mapping of an fd we hold, checked below.
+        let addr = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        if addr == libc::MAP_FAILED {
+            bail!("mmap kernel: {}", std::io::Error::last_os_error());
+        }
+        // SAFETY: addr/len describe the mapping we just created.
+        unsafe { libc::madvise(addr, len, libc::MADV_SEQUENTIAL) };
+        Ok(Self { addr, len })
+    }
+
+    fn data(&self) -> &[u8] {
+        // SAFETY: the mapping stays valid until drop.
+        unsafe { std::slice::from_raw_parts(self.addr as *const u8, self.len) }
+    }
+}
+
+impl Drop for Mapping {
+    fn drop(&mut self) {
+        // SAFETY: addr/len come from a successful mmap.
+        unsafe { libc::munmap(self.addr, self.len) };
+    }
+}
+
+fn kmi_from_banner(banner: &[u8]) -> Option<String> {
+    let banner = std::str::from_utf8(banner).ok()?;
+    let caps = KMI_RE.captures(banner)?;
+    Some(format!(
+        "{}-{}",
+        caps.get(2)?.as_str(),
+        caps.get(1)?.as_str()
+    ))
+}
+
+/// Find the KMI in the first complete `Linux version` banner of `data`.
+/// Only the candidates found by memmem ever reach the regex. A banner
+/// running into the end of `data` is ignored unless `at_end`, the next
+/// window of a stream will see it whole.
+fn scan_banner(data: &[u8], at_end: bool) -> Option<String> {
+    for start in memmem::find_iter(data, BANNER) {
+        let rest = &data[start..data.len().min(start + MAX_BANNER)];
+        let banner = match memchr::memchr2(0, b'\n', rest) {
+            Some(end) => &rest[..end],
+            None if at_end || rest.len() == MAX_BANNER => rest,
+            None => continue,
+        };
+        if let Some(kmi) = kmi_from_banner(banner) {
+            return Some(kmi);
+        }
+    }
+    None
+}
+
+// Fallback for kernels without a regular banner: every printable
+// NUL-terminated string, as parse_kmi_from_kernel used to do.
+fn scan_strings(data: &[u8]) -> Option<String> {
+    data.split(|&b| b == 0)
+        .filter(|s| s.iter().all(|&c| c.is_ascii_graphic() || c == b' '))
+        .find_map(kmi_from_banner)
+}
+
+fn scan_stream(mut reader: impl Read) -> Result<Option<String>> {
+    let mut buffer = vec![0u8; WINDOW + MAX_BANNER];
+    let mut kept = 0;
+    loop {
+        let mut end = kept;
+        while end < buffer.len() {
+            let n = reader.read(&mut buffer[end..])?;
+            if n == 0 {
+                break;
+            }
+            end += n;
+        }
+        let at_end = end < buffer.len();
+        if let Some(kmi) = scan_banner(&buffer[..end], at_end) {
+            return Ok(Some(kmi));
+        }
+        if at_end {
+            return Ok(None);
+        }
+        // keep the tail so a banner split across windows is still seen
+        buffer.copy_within(end - MAX_BANNER..end, 0);
+        kept = MAX_BANNER;
+    }
+}
+
+// One block of the lz4 legacy format used by Image.lz4, appended to `dst`.
+fn lz4_block(src: &[u8], dst: &mut Vec<u8>) -> Result<()> {
+    fn length(src: &[u8], i: &mut usize, mut len: usize) -> Result<usize> {
+        loop {
+            let Some(&b) = src.get(*i) else {
+                bail!("truncated lz4 block");
+            };
+            *i += 1;
+            len += b as usize;
+            if b != 255 {
+                return Ok(len);
+            }
+        }
+    }
+
+    let mut i = 0;
+    while i < src.len() {
+        let token = src[i];
+        i += 1;
+        let mut literals = (token >> 4) as usize;
+        if literals == 15 {
+            literals = length(src, &mut i, literals)?;
+        }
+        ensure!(i + literals <= src.len(), "truncated lz4 literals");
+        dst.extend_from_slice(&src[i..i + literals]);
+        i += literals;
+        if i == src.len() {
+            break;
+        }
+
+        ensure!(i + 2 <= src.len(), "truncated lz4 offset");
+        let offset = u16::from_le_bytes([src[i], src[i + 1]]) as usize;
+        i += 2;
+        ensure!(offset != 0 && offset <= dst.len(), "bad lz4 offset");
+        let mut matched = (token & 15) as usize;
+        if matched == 15 {
+            matched = length(src, &mut i, matched)?;
+        }
+        // byte by byte, the match may overlap what it produces
+        let start = dst.len() - offset;
+        for k in 0..matched + 4 {
+            dst.push(dst[start + k]);
+        }
+    }
+    Ok(())
+}
+
+fn scan_lz4_legacy(data: &[u8]) -> Result<Option<String>> {
+    let mut pos = 4;
+    let mut out = Vec::with_capacity(8 << 20);
+    while pos + 4 <= data.len() {
+        let size = u32::from_le_bytes(data[pos..pos + 4].try_into()?);
+        pos += 4;
+        if size == LZ4_LEGACY_MAGIC {
+            continue;
+        }
+        // the kernel build appends the uncompressed size after the last block
+        let block = pos
+            .checked_add(size as usize)
+            .and_then(|end| data.get(pos..end));
+        let Some(block) = block else {
+            break;
+        };
+        pos += block.len();
+
+        // blocks are independent, so the previous tail only serves as overlap
+        let keep = out.len().min(MAX_BANNER);
+        out.drain(..out.len() - keep);
+        lz4_block(block, &mut out)?;
+        if let Some(kmi) = scan_banner(&out, false) {
+            return Ok(Some(kmi));
+        }
+    }
+    Ok(scan_banner(&out, true))
+}
+
+/// Get the KMI of a raw, gzip or lz4 compressed kernel image. Compressed
+/// kernels are only decompressed up to the banner.
+pub fn scan_kernel(kernel: &Path) -> Result<Option<String>> {
+    let file = File::open(kernel).with_context(|| format!("open {}", kernel.display()))?;
+    let map = Mapping::new(&file)?;
+    let data = map.data();
+
+    if data.starts_with(GZIP_MAGIC) {
+        return scan_stream(GzDecoder::new(data));
+    }
+    if data.starts_with(&LZ4_LEGACY_MAGIC.to_le_bytes()) {
+        return scan_lz4_legacy(data);
+    }
+    Ok(scan_banner(data, true).or_else(|| scan_strings(data)))
+}
@@ -2,11 +2,15 @@ use anyhow::{anyhow, bail, Result};
 use libc::{c_int, c_ulong, prctl};
 use notify::{RecursiveMode, Watcher};
 use std::{
+    collections::HashMap,
     ffi::{CStr, CString, OsStr},
     path::{Path, PathBuf},
-    os::unix::fs::PermissionsExt,
+    os::unix::{fs::PermissionsExt, process::CommandExt},
     fs, 
+    process::{Command, Stdio},
     ptr,
+    sync::mpsc,
+    time::Duration,
 };
 
 pub const KPM_DIR: &str = "/data/adb/kpm";
@@ -20,6 +24,22 @@ const SUKISU_KPM_LIST:   c_int = 31;
 const SUKISU_KPM_INFO:   c_int = 32;
 const SUKISU_KPM_CONTROL:c_int = 33;
 const SUKISU_KPM_VERSION:c_int = 34;
+const SUKISU_KPM_LOAD_BATCH:c_int = 35;
+
+/// Max entries accepted by one `SUKISU_KPM_LOAD_BATCH` call.
+const KPM_LOAD_BATCH_MAX: usize = 64;
+
+/// Quiet period the watcher waits for before acting on a burst of events.
+const KPM_WATCH_DEBOUNCE: Duration = Duration::from_millis(500);
+
+/// Mirrors `struct sukisu_kpm_load_entry` in kernel/kpm/kpm.h.
+#[repr(C)]
+struct KpmLoadEntry {
+    path: u64,
+    args: u64,
+    result: i32,
+    reserved: u32,
+}
 
 /// Convert raw kernel return code to `Result`.
 #[inline(always)]
@@ -63,16 +83,20 @@ pub fn kpm_unload(name: &str) -> Result<()> {
 }
 
 /// Return loaded module count.
-pub fn kpm_num() -> Result<i32> {
+pub fn kpm_count() -> Result<i32> {
     let mut rc = -1;
     unsafe { prctl(KSU_OPTIONS, SUKISU_KPM_NUM, 0, 0, &mut rc as *mut _ as c_ulong) };
-    let n = check_out(rc)?;
+    check_out(rc)
+}
+
+pub fn kpm_num() -> Result<i32> {
+    let n = kpm_count()?;
     println!("{n}");
     Ok(n)
 }
 
-/// Print name list of loaded modules.
-pub fn kpm_list() -> Result<()> {
+/// Name list of loaded modules.
+pub fn kpm_names() -> Result<String> {
     let mut buf = vec![0u8; 1024];
     let mut rc = -1;
     unsafe {
@@ -85,12 +109,17 @@ pub fn kpm_list() -> Result<()> {
         );
     }
     check_out(rc)?;
-    print!("{}", buf2str(&buf));
+    Ok(buf2str(&buf))
+}
+
+/// Print name list of loaded modules.
+pub fn kpm_list() -> Result<()> {
+    print!("{}", kpm_names()?);
     Ok(())
 }
 
-/// Print single module info.
-pub fn kpm_info(name: &str) -> Result<()> {
+/// Single module info.
+pub fn kpm_module_info(name: &str) -> Result<String> {
     let name_c = CString::new(name)?;
     let mut buf = vec![0u8; 256];
     let mut rc = -1;
@@ -104,7 +133,12 @@ pub fn kpm_info(name: &str) -> Result<()> {
         );
     }
     check_out(rc)?;
-    println!("{}", buf2str(&buf));
+    Ok(buf2str(&buf))
+}
+
+/// Print single module info.
+pub fn kpm_info(name: &str) -> Result<()> {
+    println!("{}", kpm_module_info(name)?);
     Ok(())
 }
 
@@ -125,8 +159,8 @@ pub fn kpm_control(name: &str, args: &str) -> Result<i32> {
     check_out(rc).map(|v| v as i32)
 }
 
-/// Print loader version string.
-pub fn kpm_version_loader() -> Result<()> {
+/// Loader version string.
+pub fn kpm_loader_version() -> Result<String> {
     let mut buf = vec![0u8; 1024];
     let mut rc = -1;
     unsafe {
@@ -139,7 +173,12 @@ pub fn kpm_version_loader() -> Result<()> {
         );
     }
     check_out(rc)?;
-    print!("{}", buf2str(&buf));
+    Ok(buf2str(&buf))
+}
+
+/// Print loader version string.
+pub fn kpm_version_loader() -> Result<()> {
+    print!("{}", kpm_loader_version()?);
     Ok(())
 }
 
@@ -176,6 +215,9 @@ pub fn ensure_kpm_dir() -> Result<()> {
 }
 
 /// Start file watcher for hot-(un)load.
+///
+/// The watcher has to outlive post-fs-data, so it runs as a detached
+/// `ksud kpm watch` process.
 pub fn start_kpm_watcher() -> Result<()> {
     check_kpm_version()?; // bails if loader too old
     ensure_kpm_dir()?;
@@ -185,29 +227,114 @@ pub fn start_kpm_watcher() -> Result<()> {
         return Ok(());
     }
 
-    let mut watcher = notify::recommended_watcher(|res: Result<_, _>| match res {
-        Ok(evt) => handle_kpm_event(evt),
+    let mut cmd = Command::new(crate::defs::DAEMON_PATH);
+    cmd.args(["kpm", "watch"])
+        .stdin(Stdio::null())
+        .stdout(Stdio::null())
+        .stderr(Stdio::null())
+        .current_dir("/");
+    unsafe {
+        cmd.pre_exec(|| {
+            libc::setsid();
+            Ok(())
+        });
+    }
+    let child = cmd.spawn()?;
+    log::info!("KPM: watcher started with pid: {}", child.id());
+    Ok(())
+}
+
+/// Watch `/data/adb/kpm` and hot-(un)load modules; never returns on success.
+///
+/// Events are debounced so a file being copied in several writes is only
+/// loaded once: created or modified files are (re)loaded, removed files are
+/// unloaded.
+pub fn run_kpm_watcher() -> Result<()> {
+    ensure_kpm_dir()?;
+
+    let (tx, rx) = mpsc::channel();
+    let mut watcher = notify::recommended_watcher(move |res: Result<notify::Event, _>| match res {
+        Ok(evt) => {
+            let _ = tx.send(evt);
+        }
         Err(e) => log::error!("KPM: watcher error: {e:?}"),
     })?;
     watcher.watch(Path::new(KPM_DIR), RecursiveMode::NonRecursive)?;
     log::info!("KPM: watcher active on {KPM_DIR}");
-    Ok(())
+
+    while let Ok(evt) = rx.recv() {
+        let mut pending = HashMap::new();
+        collect_kpm_event(&mut pending, evt);
+        while let Ok(evt) = rx.recv_timeout(KPM_WATCH_DEBOUNCE) {
+            collect_kpm_event(&mut pending, evt);
+        }
+        apply_kpm_events(pending);
+    }
+
+    bail!("KPM: watcher channel closed")
 }
 
-fn handle_kpm_event(evt: notify::Event) {
-    if let notify::EventKind::Create(_) = evt.kind {
-        for p in evt.paths {
-            if p.extension() == Some(OsStr::new("kpm")) && load_kpm(&p).is_err() {
-                log::warn!("KPM: failed to load {}", p.display());
-            }
+#[derive(Clone, Copy, Debug, PartialEq)]
+enum KpmChange {
+    Load,
+    Reload,
+    Unload,
+}
+
+/// Fold one event into `pending`; the last event for a path wins, except
+/// that a create followed by modifies is still a plain load.
+fn collect_kpm_event(pending: &mut HashMap<PathBuf, KpmChange>, evt: notify::Event) {
+    use notify::EventKind;
+
+    let change = match evt.kind {
+        EventKind::Create(_) => KpmChange::Load,
+        EventKind::Modify(_) => KpmChange::Reload,
+        EventKind::Remove(_) => KpmChange::Unload,
+        _ => return,
+    };
+    for p in evt.paths {
+        if p.extension() != Some(OsStr::new("kpm")) {
+            continue;
         }
+        let change = match (pending.get(&p), change) {
+            (Some(KpmChange::Load), KpmChange::Reload) => KpmChange::Load,
+            _ => change,
+        };
+        pending.insert(p, change);
     }
 }
 
-/// Load single `.kpm` file.
-pub fn load_kpm(path: &Path) -> Result<()> {
-    let s = path.to_str().ok_or_else(|| anyhow!("bad path"))?;
-    kpm_load(s, None)
+fn apply_kpm_events(pending: HashMap<PathBuf, KpmChange>) {
+    let mut to_load = Vec::new();
+    for (p, change) in pending {
+        let Some(name) = p.file_stem().and_then(|s| s.to_str()) else {
+            continue;
+        };
+        // a rename shows up as a modify, so trust the file system over the event
+        let change = if p.is_file() {
+            change
+        } else {
+            KpmChange::Unload
+        };
+        match change {
+            KpmChange::Load => to_load.push((p, None)),
+            KpmChange::Reload => {
+                if let Err(e) = kpm_unload(name) {
+                    log::info!("KPM: {name} was not loaded before reload: {e}");
+                }
+                to_load.push((p, None));
+            }
+            KpmChange::Unload => match kpm_unload(name) {
+                Ok(_) => log::info!("KPM: unloaded {name}"),
+                Err(e) => log::warn!("KPM: unload {name} failed: {e}"),
+            },
+        }
+    }
+    if !to_load.is_empty() {
+        if let Err(e) = kpm_load_batch(&to_load) {
+            log::warn!("KPM: hot load failed: {e}");
+        }
+    }
 }
 
 /// Unload module and delete file.
@@ -254,6 +381,123 @@ pub fn remove_all_kpms() -> Result<()> {
     Ok(())
 }
 
+/// Read a `.kpm` and check it is an aarch64 ELF before handing it to the kernel.
+fn verify_kpm(path: &Path) -> Result<()> {
+    const EM_AARCH64: u16 = 183;
+
+    let data = fs::read(path)?;
+    if data.len() < 20 || &data[..4] != b"\x7fELF" {
+        bail!("not an ELF file");
+    }
+    if data[4] != 2 || data[5] != 1 {
+        bail!("not a 64-bit little-endian ELF");
+    }
+    let machine = u16::from_le_bytes([data[18], data[19]]);
+    if machine != EM_AARCH64 {
+        bail!("unsupported machine: {machine}");
+    }
+    Ok(())
+}
+
+/// Load several `.kpm`s with one kernel round-trip.
+///
+/// Files are read and verified in parallel first (which also warms the page
+/// cache for the kernel side); only the ones that pass are sent to the
+/// kernel. Falls back to one `kpm_load` per file on kernels without
+/// `SUKISU_KPM_LOAD_BATCH`. Returns `(loaded, failed)`.
+pub fn kpm_load_batch(items: &[(PathBuf, Option<String>)]) -> Result<(usize, usize)> {
+    let verified: Vec<Result<()>> = std::thread::scope(|s| {
+        let handles: Vec<_> = items
+            .iter()
+            .map(|(p, _)| s.spawn(move || verify_kpm(p)))
+            .collect();
+        handles
+            .into_iter()
+            .map(|h| h.join().unwrap_or_else(|_| Err(anyhow!("verify thread panicked"))))
+            .collect()
+    });
+
+    let mut failed = 0;
+    let mut valid = Vec::new();
+    for ((path, args), res) in items.iter().zip(verified) {
+        match res {
+            Ok(_) => valid.push((path, args)),
+            Err(e) => {
+                log::warn!("KPM: skip {}: {e}", path.display());
+                failed += 1;
+            }
+        }
+    }
+
+    let mut loaded = 0;
+    for chunk in valid.chunks(KPM_LOAD_BATCH_MAX) {
+        let paths = chunk
+            .iter()
+            .map(|(p, _)| {
+                let s = p.to_str().ok_or_else(|| anyhow!("bad path"))?;
+                Ok(CString::new(s)?)
+            })
+            .collect::<Result<Vec<_>>>()?;
+        let args = chunk
+            .iter()
+            .map(|(_, a)| a.as_deref().map(CString::new).transpose())
+            .collect::<Result<Vec<_>, _>>()?;
+        let mut entries: Vec<KpmLoadEntry> = paths
+            .iter()
+            .zip(&args)
+            .map(|(p, a)| KpmLoadEntry {
+                path: p.as_ptr() as u64,
+                args: a.as_ref().map_or(ptr::null(), |s| s.as_ptr()) as u64,
+                result: -libc::EINVAL,
+                reserved: 0,
+            })
+            .collect();
+
+        // old kernels accept the command code but never touch `rc`
+        let mut rc: c_int = -libc::ENOSYS;
+        // SAFETY: `entries` and the CStrings it points into outlive the prctl.
+        unsafe {
+            prctl(
+                KSU_OPTIONS,
+                SUKISU_KPM_LOAD_BATCH,
+                entries.as_mut_ptr() as c_ulong,
+                entries.len() as c_ulong,
+                &mut rc as *mut c_int as c_ulong,
+            );
+        }
+
+        if rc == -libc::ENOSYS {
+            log::info!("KPM: batch load unsupported, loading one by one");
+            for (path, args) in chunk {
+                match kpm_load(path.to_str().unwrap_or_default(), args.as_deref()) {
+                    Ok(_) => loaded += 1,
+                    Err(e) => {
+                        log::warn!("KPM: load {} failed: {e}", path.display());
+                        failed += 1;
+                    }
+                }
+            }
+            continue;
+        }
+        check_out(rc)?;
+
+        for ((path, _), entry) in chunk.iter().zip(&entries) {
+            if entry.result < 0 {
+                log::warn!(
+                    "KPM: load {} failed: {}",
+                    path.display(),
+                    std::io::Error::from_raw_os_error(-entry.result)
+                );
+                failed += 1;
+            } else {
+                loaded += 1;
+            }
+        }
+    }
+
+    Ok((loaded, failed))
+}
+
 /// Bulk-load existing `.kpm`s at boot.
 pub fn load_kpm_modules() -> Result<()> {
     check_kpm_version()?;
@@ -262,19 +506,15 @@ pub fn load_kpm_modules() -> Result<()> {
     if !dir.is_dir() {
         return Ok(());
     }
-    let (mut ok, mut ng) = (0, 0);
+    let mut items = Vec::new();
     for entry in fs::read_dir(dir)? {
         let p = entry?.path();
         if p.extension() == Some(OsStr::new("kpm")) {
-            match load_kpm(&p) {
-                Ok(_) => ok += 1,
-                Err(e) => {
-                    log::warn!("KPM: load {} failed: {e}", p.display());
-                    ng += 1;
-                }
-            }
+            items.push((p, None));
         }
     }
+    items.sort();
+    let (ok, ng) = kpm_load_batch(&items)?;
     log::info!("KPM: bulk-load done – ok: {ok}, failed: {ng}");
     Ok(())
 }
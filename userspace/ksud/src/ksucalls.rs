@@ -1,3 +1,7 @@
+/// First prctl argument of every KernelSU call. The kernel writes it back
+/// through the result pointer when it handled the call.
+pub const KSU_OPTIONS: libc::c_int = 0xdeadbeef_u32 as libc::c_int;
+
 const EVENT_POST_FS_DATA: u64 = 1;
 const EVENT_BOOT_COMPLETED: u64 = 2;
 const EVENT_MODULE_MOUNTED: u64 = 3;
@@ -30,6 +34,98 @@ pub fn check_kernel_safemode() -> bool {
     false
 }
 
+#[cfg(any(target_os = "linux", target_os = "android"))]
+pub fn uid_granted_root(uid: u32) -> bool {
+    const CMD_UID_GRANTED_ROOT: libc::c_int = 12;
+
+    let mut allow = false;
+    let mut rc: u32 = 0;
+    // SAFETY: both out pointers live through the prctl.
+    unsafe {
+        libc::prctl(
+            KSU_OPTIONS,
+            CMD_UID_GRANTED_ROOT,
+            uid as libc::c_ulong,
+            &mut allow as *mut bool as libc::c_ulong,
+            &mut rc as *mut u32 as libc::c_ulong,
+        );
+    }
+    rc == KSU_OPTIONS as u32 && allow
+}
+
+#[cfg(not(any(target_os = "linux", target_os = "android")))]
+pub fn uid_granted_root(_uid: u32) -> bool {
+    false
+}
+
+/// Uids of the active managers, as tracked by the kernel.
+#[cfg(any(target_os = "linux", target_os = "android"))]
+pub fn manager_uids() -> Vec<u32> {
+    const CMD_GET_MANAGERS: libc::c_int = 104;
+
+    // mirrors `struct manager_list_info` in kernel/ksu.h
+    #[repr(C)]
+    #[derive(Clone, Copy, Default)]
+    struct Manager {
+        uid: u32,
+        _signature_index: libc::c_int,
+    }
+    #[repr(C)]
+    #[derive(Default)]
+    struct ManagerList {
+        count: libc::c_int,
+        managers: [Manager; 2],
+    }
+
+    let mut list = ManagerList::default();
+    let mut rc: u32 = 0;
+    // SAFETY: both out pointers live through the prctl.
+    unsafe {
+        libc::prctl(
+            KSU_OPTIONS,
+            CMD_GET_MANAGERS,
+            &mut list as *mut ManagerList as libc::c_ulong,
+            0,
+            &mut rc as *mut u32 as libc::c_ulong,
+        );
+    }
+    if rc != KSU_OPTIONS as u32 {
+        return Vec::new();
+    }
+    let count = (list.count.max(0) as usize).min(list.managers.len());
+    list.managers[..count].iter().map(|m| m.uid).collect()
+}
+
+#[cfg(not(any(target_os = "linux", target_os = "android")))]
+pub fn manager_uids() -> Vec<u32> {
+    Vec::new()
+}
+
+/// Ask the kernel to move us into init's mount namespace, which it keeps
+/// pinned since post-fs-data. Returns false on kernels without support.
+#[cfg(any(target_os = "linux", target_os = "android"))]
+pub fn enter_global_mnt_ns() -> bool {
+    const CMD_ENTER_GLOBAL_MNT_NS: libc::c_int = 107;
+
+    let mut rc: u32 = 0;
+    // SAFETY: the out pointer lives through the prctl.
+    unsafe {
+        libc::prctl(
+            KSU_OPTIONS,
+            CMD_ENTER_GLOBAL_MNT_NS,
+            0,
+            0,
+            &mut rc as *mut u32 as libc::c_ulong,
+        );
+    }
+    rc == KSU_OPTIONS as u32
+}
+
+#[cfg(not(any(target_os = "linux", target_os = "android")))]
+pub fn enter_global_mnt_ns() -> bool {
+    false
+}
+
 pub fn report_post_fs_data() {
     report_event(EVENT_POST_FS_DATA);
 }
@@ -1,23 +1,38 @@
 mod apk_sign;
 mod assets;
+mod audit;
+mod backup;
 mod boot_patch;
+mod bootlog;
 mod cli;
+mod cpio;
 mod debug;
 mod defs;
+mod flash;
 mod init_event;
+mod kmi;
 mod ksucalls;
 #[cfg(target_os = "android")]
 mod magic_mount;
 mod module;
 mod profile;
 mod restorecon;
+mod rpc;
 mod sepolicy;
 mod su;
+mod su_broker;
 mod utils;
+mod webui;
 mod uid_scanner;
+mod unzip;
 #[cfg(target_arch = "aarch64")]
 mod kpm;
 
 fn main() -> anyhow::Result<()> {
+    // the kernel executes su with argv[0] = "su" and replace it with us,
+    // go straight to the shell without the logger and clap start-up
+    if su::is_su_invocation() {
+        return su::root_shell();
+    }
     cli::run()
 }
@@ -4,6 +4,7 @@ use crate::{
     assets, defs, ksucalls,
     restorecon::{restore_syscon, setsyscon},
     sepolicy,
+    unzip::ModuleZip,
 };
 
 use anyhow::{Context, Result, anyhow, bail, ensure};
@@ -12,21 +13,30 @@ use is_executable::is_executable;
 use java_properties::PropertiesIter;
 use log::{info, warn};
 
+use jwalk::{Parallelism::Serial, WalkDir};
 use std::fs::{copy, rename};
 use std::{
     collections::HashMap,
     env::var as env_var,
-    fs::{File, Permissions, remove_dir_all, remove_file, set_permissions},
-    io::Cursor,
+    fs::{Permissions, remove_dir_all, remove_file, set_permissions},
+    hash::{Hash, Hasher},
+    io::{Cursor, Write},
+    num::NonZeroUsize,
     path::{Path, PathBuf},
-    process::Command,
-    str::FromStr,
+    process::{Child, Command},
+    sync::{
+        Mutex,
+        atomic::{AtomicUsize, Ordering},
+    },
+    time::{Duration, Instant},
 };
-use zip_extensions::zip_extract_file_to_memory;
 
 use crate::defs::{MODULE_DIR, MODULE_UPDATE_DIR, UPDATE_FILE_NAME};
 #[cfg(unix)]
-use std::os::unix::{prelude::PermissionsExt, process::CommandExt};
+use std::os::unix::{fs::MetadataExt, prelude::PermissionsExt, process::CommandExt};
+
+const MODULE_INDEX_VERSION: u64 = 1;
+const SCRIPT_POLL_INTERVAL: Duration = Duration::from_millis(10);
 
 const INSTALLER_CONTENT: &str = include_str!("./installer.sh");
 const INSTALL_MODULE_SCRIPT: &str = concatcp!(
@@ -141,7 +151,7 @@ pub fn load_sepolicy_rule() -> Result<()> {
         }
         info!("load policy: {}", &rule_file.display());
 
-        if sepolicy::apply_file(&rule_file).is_err() {
+        if sepolicy::apply_file_cached(&rule_file).is_err() {
             warn!("Failed to load sepolicy.rule for {}", &rule_file.display());
         }
         Ok(())
@@ -150,25 +160,23 @@ pub fn load_sepolicy_rule() -> Result<()> {
     Ok(())
 }
 
-fn exec_script<T: AsRef<Path>>(path: T, wait: bool) -> Result<()> {
-    info!("exec {}", path.as_ref().display());
-
-    let mut command = &mut Command::new(assets::BUSYBOX_PATH);
+fn script_command(path: &Path) -> Command {
+    let mut command = Command::new(assets::BUSYBOX_PATH);
     #[cfg(unix)]
     {
-        command = command.process_group(0);
-        command = unsafe {
+        command.process_group(0);
+        unsafe {
             command.pre_exec(|| {
                 // ignore the error?
                 switch_cgroups();
                 Ok(())
-            })
-        };
+            });
+        }
     }
-    command = command
-        .current_dir(path.as_ref().parent().unwrap())
+    command
+        .current_dir(path.parent().unwrap())
         .arg("sh")
-        .arg(path.as_ref())
+        .arg(path)
         .env("ASH_STANDALONE", "1")
         .env("KSU", "true")
         .env("KSU_SUKISU", "true")
@@ -184,7 +192,13 @@ fn exec_script<T: AsRef<Path>>(path: T, wait: bool) -> Result<()> {
                 defs::BINARY_DIR.trim_end_matches('/')
             ),
         );
+    command
+}
 
+fn exec_script<T: AsRef<Path>>(path: T, wait: bool) -> Result<()> {
+    info!("exec {}", path.as_ref().display());
+
+    let mut command = script_command(path.as_ref());
     let result = if wait {
         command.status().map(|_| ())
     } else {
@@ -193,16 +207,283 @@ fn exec_script<T: AsRef<Path>>(path: T, wait: bool) -> Result<()> {
     result.map_err(|err| anyhow!("Failed to exec {}: {}", path.as_ref().display(), err))
 }
 
+struct StageScript {
+    id: String,
+    path: PathBuf,
+    order: i64,
+    /// The module set `scriptOrder`, so it may share its group with others.
+    grouped: bool,
+}
+
+/// Limits for blocking stage scripts, overridable in `SCRIPT_CONFIG_PATH`.
+struct ScriptLimits {
+    /// Run scripts of modules without `scriptOrder` concurrently as well.
+    parallel: bool,
+    parallelism: usize,
+    /// Off unless configured: a script may use the whole stage budget, as
+    /// blocking scripts always could.
+    script_timeout: Option<Duration>,
+    stage_timeout: Duration,
+    kill_on_timeout: bool,
+}
+
+impl ScriptLimits {
+    fn load() -> Self {
+        let mut limits = Self {
+            parallel: false,
+            parallelism: std::thread::available_parallelism().map_or(4, NonZeroUsize::get),
+            script_timeout: None,
+            // init gives post-fs-data 40s from our exec before it moves on
+            // without us, post-mount has to fit in the same window
+            stage_timeout: Duration::from_secs(35),
+            kill_on_timeout: false,
+        };
+        let Ok(content) = std::fs::read(defs::SCRIPT_CONFIG_PATH) else {
+            return limits;
+        };
+        let result = PropertiesIter::new_with_encoding(Cursor::new(content), encoding_rs::UTF_8)
+            .read_into(|k, v| match k.as_str() {
+                "parallel" => limits.parallel = v == "true",
+                "parallelism" => {
+                    if let Ok(n) = v.parse::<usize>() {
+                        limits.parallelism = n.max(1);
+                    }
+                }
+                "script_timeout" => {
+                    if let Ok(secs) = v.parse::<u64>() {
+                        limits.script_timeout = (secs > 0).then(|| Duration::from_secs(secs));
+                    }
+                }
+                "stage_timeout" => {
+                    if let Ok(secs) = v.parse() {
+                        limits.stage_timeout = Duration::from_secs(secs);
+                    }
+                }
+                "kill_on_timeout" => limits.kill_on_timeout = v == "true",
+                _ => {}
+            });
+        if result.is_err() {
+            warn!("Failed to parse {}", defs::SCRIPT_CONFIG_PATH);
+        }
+        limits
+    }
+}
+
+/// `scriptOrder` in module.prop: lower runs first, equal orders run together.
+/// Modules without one run alone, in directory order, at order 0.
+fn module_script_order(module: &Path) -> Option<i64> {
+    let content = std::fs::read(module.join("module.prop")).ok()?;
+    let mut order = None;
+    let _ = PropertiesIter::new_with_encoding(Cursor::new(content), encoding_rs::UTF_8).read_into(
+        |k, v| {
+            if k == "scriptOrder" {
+                order = Some(v.trim().parse().unwrap_or(0));
+            }
+        },
+    );
+    order
+}
+
+/// How long this process has been running. init starts the stage by
+/// exec'ing us, so this is what the stage has already used up.
+fn process_age() -> Option<Duration> {
+    let stat = std::fs::read_to_string("/proc/self/stat").ok()?;
+    // comm may hold spaces, starttime is the 20th field after it
+    let start_ticks: u64 = stat
+        .rsplit_once(')')?
+        .1
+        .split_whitespace()
+        .nth(19)?
+        .parse()
+        .ok()?;
+    let ticks = unsafe { libc::sysconf(libc::_SC_CLK_TCK) };
+    if ticks <= 0 {
+        return None;
+    }
+    let mut now: libc::timespec = unsafe { std::mem::zeroed() };
+    if unsafe { libc::clock_gettime(libc::CLOCK_BOOTTIME, &mut now) } != 0 {
+        return None;
+    }
+    let start = Duration::from_millis(start_ticks * 1000 / ticks as u64);
+    Duration::new(now.tv_sec as u64, now.tv_nsec as u32).checked_sub(start)
+}
+
+fn stop_script(child: &mut Child, kill: bool) -> &'static str {
+    if !kill {
+        return "timeout, backgrounded";
+    }
+    // scripts run in their own process group, take their children down too
+    unsafe { libc::kill(-(child.id() as libc::pid_t), libc::SIGKILL) };
+    let _ = child.wait();
+    "timeout, killed"
+}
+
+fn script_report_entry(
+    script: &StageScript,
+    start: Duration,
+    duration: Duration,
+    status: &str,
+) -> serde_json::Value {
+    serde_json::json!({
+        "id": script.id,
+        "script": script.path,
+        "order": script.order,
+        "start_ms": start.as_millis() as u64,
+        "duration_ms": duration.as_millis() as u64,
+        "status": status,
+    })
+}
+
+fn write_script_report(stage: &str, total: Duration, scripts: Vec<serde_json::Value>) {
+    let report = serde_json::json!({
+        "stage": stage,
+        "total_ms": total.as_millis() as u64,
+        "scripts": scripts,
+    });
+    let path = Path::new(defs::LOG_DIR).join(format!("{stage}.scripts.json"));
+    let result = ensure_dir_exists(defs::LOG_DIR)
+        .and_then(|()| Ok(std::fs::write(&path, serde_json::to_vec_pretty(&report)?)?));
+    if let Err(e) = result {
+        warn!("Failed to write {}: {e}", path.display());
+    }
+}
+
+/// Run blocking stage scripts one `scriptOrder` group after another,
+/// without letting any of them hold the stage past what is left of its
+/// budget. Only modules that opted in share a group; the rest run serially.
+fn run_stage_scripts(stage: &str, mut scripts: Vec<StageScript>) {
+    let limits = ScriptLimits::load();
+    // stable sort, equal orders keep the module directory order
+    scripts.sort_by_key(|script| script.order);
+    let concurrent = |script: &StageScript| script.grouped || limits.parallel;
+
+    let stage_start = Instant::now();
+    let used = process_age().unwrap_or_default();
+    let stage_deadline = stage_start + limits.stage_timeout.saturating_sub(used);
+    info!("{stage} scripts: {used:?} of the stage budget already used");
+    let mut report = Vec::with_capacity(scripts.len());
+    let mut pending = scripts.into_iter().peekable();
+    let mut running: Vec<(StageScript, Child, Instant)> = Vec::new();
+
+    loop {
+        let now = Instant::now();
+
+        // all running scripts share one order, the next group waits for them
+        while running.len() < limits.parallelism && now < stage_deadline {
+            let Some(next) = pending.peek() else {
+                break;
+            };
+            if running
+                .first()
+                .is_some_and(|(r, ..)| !concurrent(r) || !concurrent(next) || r.order != next.order)
+            {
+                break;
+            }
+            let script = pending.next().unwrap();
+            info!("exec {}", script.path.display());
+            match script_command(&script.path).spawn() {
+                Ok(child) => running.push((script, child, now)),
+                Err(e) => {
+                    warn!("Failed to exec {}: {e}", script.path.display());
+                    report.push(script_report_entry(
+                        &script,
+                        now - stage_start,
+                        Duration::ZERO,
+                        "spawn failed",
+                    ));
+                }
+            }
+        }
+
+        if running.is_empty() && (pending.peek().is_none() || now >= stage_deadline) {
+            break;
+        }
+
+        let mut i = 0;
+        while i < running.len() {
+            let status = {
+                let (_, child, start) = &mut running[i];
+                match child.try_wait() {
+                    Ok(Some(status)) if status.success() => Some("ok".to_owned()),
+                    Ok(Some(status)) => Some(
+                        status
+                            .code()
+                            .map_or_else(|| "killed by signal".to_owned(), |c| format!("exit {c}")),
+                    ),
+                    Ok(None)
+                        if limits.script_timeout.is_some_and(|t| now - *start >= t)
+                            || now >= stage_deadline =>
+                    {
+                        Some(stop_script(child, limits.kill_on_timeout).to_owned())
+                    }
+                    Ok(None) => None,
+                    Err(e) => Some(format!("wait failed: {e}")),
+                }
+            };
+            let Some(status) = status else {
+                i += 1;
+                continue;
+            };
+            let (script, _, start) = running.swap_remove(i);
+            if status != "ok" {
+                warn!("{}: {status}", script.path.display());
+            }
+            report.push(script_report_entry(
+                &script,
+                start - stage_start,
+                now - start,
+                &status,
+            ));
+        }
+
+        std::thread::sleep(SCRIPT_POLL_INTERVAL);
+    }
+
+    // out of stage budget: start the rest anyway, but stop holding up boot
+    for script in pending {
+        let status = match exec_script(&script.path, false) {
+            Ok(()) => "late, backgrounded",
+            Err(_) => "spawn failed",
+        };
+        warn!("{}: {status}", script.path.display());
+        report.push(script_report_entry(
+            &script,
+            stage_start.elapsed(),
+            Duration::ZERO,
+            status,
+        ));
+    }
+
+    let total = stage_start.elapsed();
+    info!("{stage} scripts took {total:?}");
+    write_script_report(stage, total, report);
+}
+
 pub fn exec_stage_script(stage: &str, block: bool) -> Result<()> {
+    let mut scripts = Vec::new();
     foreach_active_module(|module| {
         let script_path = module.join(format!("{stage}.sh"));
         if !script_path.exists() {
             return Ok(());
         }
 
-        exec_script(&script_path, block)
+        if !block {
+            return exec_script(&script_path, false);
+        }
+        let order = module_script_order(module);
+        scripts.push(StageScript {
+            id: module.file_name().unwrap().to_string_lossy().to_string(),
+            order: order.unwrap_or(0),
+            grouped: order.is_some(),
+            path: script_path,
+        });
+        Ok(())
     })?;
 
+    if block {
+        run_stage_scripts(stage, scripts);
+    }
+
     Ok(())
 }
 
@@ -228,7 +509,15 @@ pub fn exec_common_scripts(dir: &str, wait: bool) -> Result<()> {
     Ok(())
 }
 
-pub fn load_system_prop() -> Result<()> {
+/// Merge every active module's system.prop, later modules overriding
+/// earlier ones. Keys and values are trimmed and comments dropped, the same
+/// as resetprop does when loading each file on its own. A file that can't
+/// be read is skipped with a warning rather than costing every module its
+/// props; invalid UTF-8 is decoded lossily.
+fn merge_system_props() -> Result<Vec<(String, String)>> {
+    let mut merged: Vec<(String, String)> = Vec::new();
+    let mut owners: HashMap<String, (usize, String)> = HashMap::new();
+
     foreach_active_module(|module| {
         let system_prop = module.join("system.prop");
         if !system_prop.exists() {
@@ -236,17 +525,67 @@ pub fn load_system_prop() -> Result<()> {
         }
         info!("load {} system.prop", module.display());
 
-        // resetprop -n --file system.prop
-        Command::new(assets::RESETPROP_PATH)
-            .arg("-n")
-            .arg("--file")
-            .arg(&system_prop)
-            .status()
-            .with_context(|| format!("Failed to exec {}", system_prop.display()))?;
-
+        let id = module.file_name().unwrap().to_string_lossy().to_string();
+        let content = match std::fs::read(&system_prop) {
+            Ok(content) => content,
+            Err(e) => {
+                warn!("Failed to read {}: {e}, skip", system_prop.display());
+                return Ok(());
+            }
+        };
+        for line in String::from_utf8_lossy(&content).lines() {
+            let line = line.trim();
+            if line.is_empty() || line.starts_with('#') {
+                continue;
+            }
+            let Some((key, value)) = line.split_once('=') else {
+                continue;
+            };
+            let (key, value) = (key.trim(), value.trim());
+            match owners.get_mut(key) {
+                Some((index, owner)) => {
+                    if merged[*index].1 != value {
+                        warn!("{key} from {owner} is overridden by {id}");
+                    }
+                    merged[*index].1 = value.to_owned();
+                    owner.clone_from(&id);
+                }
+                None => {
+                    owners.insert(key.to_owned(), (merged.len(), id.clone()));
+                    merged.push((key.to_owned(), value.to_owned()));
+                }
+            }
+        }
         Ok(())
     })?;
 
+    Ok(merged)
+}
+
+pub fn load_system_prop() -> Result<()> {
+    let props = merge_system_props()?;
+    if props.is_empty() {
+        return Ok(());
+    }
+
+    let mut merged = tempfile::Builder::new()
+        .prefix(".system.prop")
+        .tempfile_in(defs::WORKING_DIR)?;
+    for (key, value) in &props {
+        writeln!(merged, "{key}={value}")?;
+    }
+    merged.flush()?;
+    info!("load {} props from modules", props.len());
+
+    // resetprop -n --file system.prop, once for all modules
+    let status = Command::new(assets::RESETPROP_PATH)
+        .arg("-n")
+        .arg("--file")
+        .arg(merged.path())
+        .status()
+        .with_context(|| format!("Failed to exec {}", assets::RESETPROP_PATH))?;
+    ensure!(status.success(), "resetprop failed: {status}");
+
     Ok(())
 }
 
@@ -310,12 +649,10 @@ pub fn install_module(zip: &str) -> Result<()> {
         ensure_dir_exists(defs::WORKING_DIR).with_context(|| "Failed to create working dir")?;
         ensure_dir_exists(defs::BINARY_DIR).with_context(|| "Failed to create bin dir")?;
 
-        // read the module_id from zip, if failed it will return early.
-        let mut buffer: Vec<u8> = Vec::new();
-        let entry_path = PathBuf::from_str("module.prop")?;
-        let zip_path = PathBuf::from_str(zip)?;
-        let zip_path = zip_path.canonicalize()?;
-        zip_extract_file_to_memory(&zip_path, &entry_path, &mut buffer)?;
+        // parse the central directory once, then read the module_id from it.
+        // if failed it will return early.
+        let mut module_zip = ModuleZip::open(zip)?;
+        let buffer = module_zip.read_file("module.prop")?;
 
         let mut module_prop = HashMap::new();
         PropertiesIter::new_with_encoding(Cursor::new(buffer), encoding_rs::UTF_8).read_into(
@@ -330,7 +667,7 @@ pub fn install_module(zip: &str) -> Result<()> {
         };
         let module_id = module_id.trim();
 
-        let zip_uncompressed_size = get_zip_uncompressed_size(zip)?;
+        let zip_uncompressed_size = module_zip.uncompressed_size();
 
         info!(
             "zip uncompressed size: {}",
@@ -353,9 +690,18 @@ pub fn install_module(zip: &str) -> Result<()> {
 
         let do_install = || -> Result<()> {
             // unzip the image and move it to modules_update/<id> dir
-            let file = File::open(zip)?;
-            let mut archive = zip::ZipArchive::new(file)?;
-            archive.extract(&update_module_dir)?;
+            let stats = module_zip.extract(&update_module_dir)?;
+            info!(
+                "extracted {} files in {:?}, {}/s",
+                stats.files,
+                stats.elapsed,
+                humansize::format_size(stats.throughput(), humansize::DECIMAL)
+            );
+            println!(
+                "- Extracted {} files, {}/s",
+                stats.files,
+                humansize::format_size(stats.throughput(), humansize::DECIMAL)
+            );
 
             // set permission and selinux context for $MOD/system
             let module_system_dir = update_module_dir.join("system");
@@ -434,6 +780,122 @@ fn mark_all_modules(flag_file: &str) -> Result<()> {
     Ok(())
 }
 
+fn read_module_info(path: &Path, dir_id: &str) -> Option<HashMap<String, String>> {
+    info!("path: {}", path.display());
+    let module_prop = path.join("module.prop");
+    let content = std::fs::read(&module_prop);
+    let Ok(content) = content else {
+        warn!("Failed to read file: {}", module_prop.display());
+        return None;
+    };
+    let mut module_prop_map: HashMap<String, String> = HashMap::new();
+    let encoding = encoding_rs::UTF_8;
+    let result =
+        PropertiesIter::new_with_encoding(Cursor::new(content), encoding).read_into(|k, v| {
+            module_prop_map.insert(k, v);
+        });
+
+    module_prop_map.insert("dir_id".to_owned(), dir_id.to_owned());
+
+    if !module_prop_map.contains_key("id") || module_prop_map["id"].is_empty() {
+        info!("Use dir name as module id: {dir_id}");
+        module_prop_map.insert("id".to_owned(), dir_id.to_owned());
+    }
+
+    // Add enabled, update, remove flags
+    let enabled = !path.join(defs::DISABLE_FILE_NAME).exists();
+    let update = path.join(defs::UPDATE_FILE_NAME).exists();
+    let remove = path.join(defs::REMOVE_FILE_NAME).exists();
+    let web = path.join(defs::MODULE_WEB_DIR).exists();
+    let action = path.join(defs::MODULE_ACTION_SH).exists();
+
+    module_prop_map.insert("enabled".to_owned(), enabled.to_string());
+    module_prop_map.insert("update".to_owned(), update.to_string());
+    module_prop_map.insert("remove".to_owned(), remove.to_string());
+    module_prop_map.insert("web".to_owned(), web.to_string());
+    module_prop_map.insert("action".to_owned(), action.to_string());
+
+    if result.is_err() {
+        warn!("Failed to parse module.prop: {}", module_prop.display());
+        return None;
+    }
+    Some(module_prop_map)
+}
+
+/// Fingerprint of everything `read_module_info` looks at. The flag files
+/// all live directly in the module dir, so creating or removing one bumps
+/// its mtime; module.prop is stamped on its own since it may be rewritten
+/// in place.
+fn module_stamp(path: &Path) -> Option<Vec<u64>> {
+    let dir = std::fs::metadata(path).ok()?;
+    let prop = std::fs::metadata(path.join("module.prop")).ok()?;
+    Some(vec![
+        dir.ino(),
+        dir.mtime() as u64,
+        dir.mtime_nsec() as u64,
+        prop.ino(),
+        prop.mtime() as u64,
+        prop.mtime_nsec() as u64,
+        prop.size(),
+    ])
+}
+
+type ModuleIndex = HashMap<String, (Vec<u64>, HashMap<String, String>)>;
+
+fn load_module_index(root: &str) -> ModuleIndex {
+    let mut index = ModuleIndex::new();
+    let Ok(content) = std::fs::read(defs::MODULE_INDEX_PATH) else {
+        return index;
+    };
+    let Ok(json) = serde_json::from_slice::<serde_json::Value>(&content) else {
+        warn!("Ignore corrupted module index");
+        return index;
+    };
+    if json["version"] != MODULE_INDEX_VERSION || json["root"] != root {
+        return index;
+    }
+    let Some(modules) = json["modules"].as_object() else {
+        return index;
+    };
+    for (dir_id, entry) in modules {
+        let stamp = entry["stamp"].as_array().map(|a| {
+            a.iter()
+                .filter_map(serde_json::Value::as_u64)
+                .collect::<Vec<_>>()
+        });
+        let props = entry["props"].as_object().map(|o| {
+            o.iter()
+                .filter_map(|(k, v)| Some((k.clone(), v.as_str()?.to_owned())))
+                .collect::<HashMap<_, _>>()
+        });
+        if let (Some(stamp), Some(props)) = (stamp, props) {
+            index.insert(dir_id.clone(), (stamp, props));
+        }
+    }
+    index
+}
+
+fn store_module_index(root: &str, index: &ModuleIndex) -> Result<()> {
+    let modules: serde_json::Map<String, serde_json::Value> = index
+        .iter()
+        .map(|(dir_id, (stamp, props))| {
+            (
+                dir_id.clone(),
+                serde_json::json!({ "stamp": stamp, "props": props }),
+            )
+        })
+        .collect();
+    let json = serde_json::json!({
+        "version": MODULE_INDEX_VERSION,
+        "root": root,
+        "modules": modules,
+    });
+    let tmp = format!("{}.{}", defs::MODULE_INDEX_PATH, std::process::id());
+    std::fs::write(&tmp, serde_json::to_vec(&json)?)?;
+    rename(&tmp, defs::MODULE_INDEX_PATH)?;
+    Ok(())
+}
+
 fn _list_modules(path: &str) -> Vec<HashMap<String, String>> {
     // first check enabled modules
     let dir = std::fs::read_dir(path);
@@ -441,60 +903,215 @@ fn _list_modules(path: &str) -> Vec<HashMap<String, String>> {
         return Vec::new();
     };
 
+    let mut index = load_module_index(path);
+    let mut fresh = ModuleIndex::new();
+    let mut dirty = false;
     let mut modules: Vec<HashMap<String, String>> = Vec::new();
 
     for entry in dir.flatten() {
         let path = entry.path();
-        info!("path: {}", path.display());
-        let module_prop = path.join("module.prop");
-        if !module_prop.exists() {
-            continue;
-        }
-        let content = std::fs::read(&module_prop);
-        let Ok(content) = content else {
-            warn!("Failed to read file: {}", module_prop.display());
+        let Some(stamp) = module_stamp(&path) else {
             continue;
         };
-        let mut module_prop_map: HashMap<String, String> = HashMap::new();
-        let encoding = encoding_rs::UTF_8;
-        let result =
-            PropertiesIter::new_with_encoding(Cursor::new(content), encoding).read_into(|k, v| {
-                module_prop_map.insert(k, v);
-            });
-
         let dir_id = entry.file_name().to_string_lossy().to_string();
-        module_prop_map.insert("dir_id".to_owned(), dir_id.clone());
 
-        if !module_prop_map.contains_key("id") || module_prop_map["id"].is_empty() {
-            info!("Use dir name as module id: {dir_id}");
-            module_prop_map.insert("id".to_owned(), dir_id.clone());
+        let module_prop_map = match index.remove(&dir_id) {
+            Some((cached, props)) if cached == stamp => props,
+            _ => {
+                dirty = true;
+                let Some(props) = read_module_info(&path, &dir_id) else {
+                    continue;
+                };
+                props
+            }
+        };
+        modules.push(module_prop_map.clone());
+        fresh.insert(dir_id, (stamp, module_prop_map));
+    }
+
+    // anything left in the old index belongs to a removed module
+    if dirty || !index.is_empty() {
+        if let Err(e) = store_module_index(path, &fresh) {
+            warn!("Failed to store module index: {e}");
         }
+    }
 
-        // Add enabled, update, remove flags
-        let enabled = !path.join(defs::DISABLE_FILE_NAME).exists();
-        let update = path.join(defs::UPDATE_FILE_NAME).exists();
-        let remove = path.join(defs::REMOVE_FILE_NAME).exists();
-        let web = path.join(defs::MODULE_WEB_DIR).exists();
-        let action = path.join(defs::MODULE_ACTION_SH).exists();
+    modules
+}
 
-        module_prop_map.insert("enabled".to_owned(), enabled.to_string());
-        module_prop_map.insert("update".to_owned(), update.to_string());
-        module_prop_map.insert("remove".to_owned(), remove.to_string());
-        module_prop_map.insert("web".to_owned(), web.to_string());
-        module_prop_map.insert("action".to_owned(), action.to_string());
+pub fn installed_modules() -> Vec<HashMap<String, String>> {
+    _list_modules(defs::MODULE_DIR)
+}
 
-        if result.is_err() {
-            warn!("Failed to parse module.prop: {}", module_prop.display());
+pub fn list_modules(compact: bool) -> Result<()> {
+    let modules = installed_modules();
+    if compact {
+        println!("{}", serde_json::to_string(&modules)?);
+    } else {
+        println!("{}", serde_json::to_string_pretty(&modules)?);
+    }
+    Ok(())
+}
+
+/// Apparent size of everything below `path`, like `du -sb`.
+fn module_tree_size(path: &Path) -> u64 {
+    WalkDir::new(path)
+        .skip_hidden(false)
+        .parallelism(Serial)
+        .into_iter()
+        .flatten()
+        .filter_map(|entry| entry.metadata().ok())
+        .map(|metadata| metadata.len())
+        .sum()
+}
+
+fn load_module_sizes() -> HashMap<String, (Vec<u64>, u64)> {
+    let mut sizes = HashMap::new();
+    let Ok(content) = std::fs::read(defs::MODULE_SIZES_PATH) else {
+        return sizes;
+    };
+    let Ok(json) = serde_json::from_slice::<serde_json::Value>(&content) else {
+        return sizes;
+    };
+    let Some(modules) = json.as_object() else {
+        return sizes;
+    };
+    for (dir_id, entry) in modules {
+        let stamp = entry["stamp"].as_array().map(|a| {
+            a.iter()
+                .filter_map(serde_json::Value::as_u64)
+                .collect::<Vec<_>>()
+        });
+        if let (Some(stamp), Some(size)) = (stamp, entry["size"].as_u64()) {
+            sizes.insert(dir_id.clone(), (stamp, size));
+        }
+    }
+    sizes
+}
+
+/// Fingerprint of a module tree for the size cache: module.prop plus the
+/// inode and mtime of every directory. Adding, removing or renaming an
+/// entry anywhere bumps its parent's mtime, and only directories need a
+/// stat, so this stays much cheaper than the walk it saves. A file
+/// rewritten in place keeps the stamp; installs and updates replace the
+/// whole tree, so that only leaves a module's own data files stale.
+fn module_size_stamp(path: &Path) -> Option<Vec<u64>> {
+    let prop = std::fs::metadata(path.join("module.prop")).ok();
+    let mut dirs = Vec::new();
+    for entry in WalkDir::new(path)
+        .skip_hidden(false)
+        .parallelism(Serial)
+        .into_iter()
+        .flatten()
+    {
+        if !entry.file_type().is_dir() {
             continue;
         }
-        modules.push(module_prop_map);
+        let metadata = entry.metadata().ok()?;
+        dirs.push((
+            entry.path(),
+            metadata.ino(),
+            metadata.mtime(),
+            metadata.mtime_nsec(),
+        ));
     }
+    dirs.sort_unstable();
+
+    // the cache is only read back by the same ksud, so the std hasher is
+    // stable enough; a different one after an upgrade just means a re-walk
+    let mut hasher = std::collections::hash_map::DefaultHasher::new();
+    dirs.hash(&mut hasher);
+    let mut stamp = vec![dirs.len() as u64, hasher.finish()];
+    if let Some(prop) = prop {
+        stamp.extend([
+            prop.ino(),
+            prop.mtime() as u64,
+            prop.mtime_nsec() as u64,
+            prop.size(),
+        ]);
+    }
+    Some(stamp)
+}
 
-    modules
+/// Size of every module in bytes, by dir id.
+/// Sizes are cached against `module_size_stamp`; stamping and, where the
+/// stamp moved, walking run for several modules at a time.
+pub fn collect_module_sizes() -> Result<HashMap<String, u64>> {
+    let dir = std::fs::read_dir(defs::MODULE_DIR)?;
+    let cached = load_module_sizes();
+
+    let mut modules = Vec::new();
+    for entry in dir.flatten() {
+        if !entry.file_type().is_ok_and(|t| t.is_dir()) {
+            continue;
+        }
+        let dir_id = entry.file_name().to_string_lossy().to_string();
+        modules.push((dir_id, entry.path()));
+    }
+
+    let mut sizes: HashMap<String, (Vec<u64>, u64)> = HashMap::new();
+    let walks = AtomicUsize::new(0);
+    if !modules.is_empty() {
+        let workers = std::thread::available_parallelism()
+            .map_or(4, NonZeroUsize::get)
+            .min(modules.len());
+        let next = AtomicUsize::new(0);
+        let done = Mutex::new(Vec::with_capacity(modules.len()));
+        std::thread::scope(|scope| {
+            for _ in 0..workers {
+                scope.spawn(|| {
+                    loop {
+                        let i = next.fetch_add(1, Ordering::Relaxed);
+                        let Some((dir_id, path)) = modules.get(i) else {
+                            break;
+                        };
+                        let Some(stamp) = module_size_stamp(path) else {
+                            continue;
+                        };
+                        let size = match cached.get(dir_id) {
+                            Some((cached_stamp, size)) if *cached_stamp == stamp => *size,
+                            _ => {
+                                walks.fetch_add(1, Ordering::Relaxed);
+                                module_tree_size(path)
+                            }
+                        };
+                        done.lock().unwrap().push((dir_id.clone(), stamp, size));
+                    }
+                });
+            }
+        });
+        for (dir_id, stamp, size) in done.into_inner().unwrap() {
+            sizes.insert(dir_id, (stamp, size));
+        }
+    }
+
+    let dirty = walks.into_inner() > 0 || cached.len() != sizes.len();
+    if dirty {
+        let cache: serde_json::Map<String, serde_json::Value> = sizes
+            .iter()
+            .map(|(dir_id, (stamp, size))| {
+                (
+                    dir_id.clone(),
+                    serde_json::json!({ "stamp": stamp, "size": size }),
+                )
+            })
+            .collect();
+        let tmp = format!("{}.{}", defs::MODULE_SIZES_PATH, std::process::id());
+        let stored = std::fs::write(&tmp, serde_json::to_vec(&cache)?)
+            .and_then(|()| rename(&tmp, defs::MODULE_SIZES_PATH));
+        if let Err(e) = stored {
+            warn!("Failed to store module sizes: {e}");
+        }
+    }
+
+    Ok(sizes
+        .into_iter()
+        .map(|(dir_id, (_, size))| (dir_id, size))
+        .collect())
 }
 
-pub fn list_modules() -> Result<()> {
-    let modules = _list_modules(defs::MODULE_DIR);
-    println!("{}", serde_json::to_string_pretty(&modules)?);
+/// Print the size of every module as one json map of dir id to bytes.
+pub fn module_sizes() -> Result<()> {
+    println!("{}", serde_json::to_string(&collect_module_sizes()?)?);
     Ok(())
 }
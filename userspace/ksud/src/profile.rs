@@ -11,10 +11,13 @@ pub fn set_sepolicy(pkg: String, policy: String) -> Result<()> {
     Ok(())
 }
 
-pub fn get_sepolicy(pkg: String) -> Result<()> {
+pub fn read_sepolicy(pkg: &str) -> Result<String> {
     let policy_file = Path::new(defs::PROFILE_SELINUX_DIR).join(pkg);
-    let policy = std::fs::read_to_string(policy_file)?;
-    println!("{policy}");
+    Ok(std::fs::read_to_string(policy_file)?)
+}
+
+pub fn get_sepolicy(pkg: String) -> Result<()> {
+    println!("{}", read_sepolicy(&pkg)?);
     Ok(())
 }
 
@@ -26,10 +29,13 @@ pub fn set_template(id: String, template: String) -> Result<()> {
     Ok(())
 }
 
-pub fn get_template(id: String) -> Result<()> {
+pub fn read_template(id: &str) -> Result<String> {
     let template_file = Path::new(defs::PROFILE_TEMPLATE_DIR).join(id);
-    let template = std::fs::read_to_string(template_file)?;
-    println!("{template}");
+    Ok(std::fs::read_to_string(template_file)?)
+}
+
+pub fn get_template(id: String) -> Result<()> {
+    println!("{}", read_template(&id)?);
     Ok(())
 }
 
@@ -39,18 +45,26 @@ pub fn delete_template(id: String) -> Result<()> {
     Ok(())
 }
 
-pub fn list_templates() -> Result<()> {
+pub fn template_ids() -> Result<Vec<String>> {
     let templates = std::fs::read_dir(defs::PROFILE_TEMPLATE_DIR);
     let Ok(templates) = templates else {
-        return Ok(());
+        return Ok(Vec::new());
     };
+    let mut ids = Vec::new();
     for template in templates {
         let template = template?;
         let template = template.file_name();
         if let Some(template) = template.to_str() {
-            println!("{template}");
+            ids.push(template.to_string());
         };
     }
+    Ok(ids)
+}
+
+pub fn list_templates() -> Result<()> {
+    for id in template_ids()? {
+        println!("{id}");
+    }
     Ok(())
 }
 
@@ -69,7 +83,7 @@ pub fn apply_sepolies() -> Result<()> {
             continue;
         };
         let sepolicy = sepolicy.path();
-        if sepolicy::apply_file(&sepolicy).is_ok() {
+        if sepolicy::apply_file_cached(&sepolicy).is_ok() {
             log::info!("profile sepolicy applied: {sepolicy:?}");
         } else {
             log::info!("profile sepolicy apply failed: {sepolicy:?}");
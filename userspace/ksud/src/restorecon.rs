@@ -1,7 +1,12 @@
 use crate::defs;
-use anyhow::Result;
-use jwalk::{Parallelism::Serial, WalkDir};
-use std::path::Path;
+use anyhow::{Result, anyhow};
+use jwalk::WalkDir;
+use log::{info, warn};
+use std::{
+    os::unix::fs::MetadataExt,
+    path::{Path, PathBuf},
+    time::Instant,
+};
 
 #[cfg(any(target_os = "linux", target_os = "android"))]
 use anyhow::{Context, Ok};
@@ -13,6 +18,7 @@ pub const ADB_CON: &str = "u:object_r:adb_data_file:s0";
 pub const UNLABEL_CON: &str = "u:object_r:unlabeled:s0";
 
 const SELINUX_XATTR: &str = "security.selinux";
+const RESTORECON_STAMP_XATTR: &str = "trusted.ksu.restorecon";
 
 pub fn lsetfilecon<P: AsRef<Path>>(path: P, con: &str) -> Result<()> {
     #[cfg(any(target_os = "linux", target_os = "android"))]
@@ -52,25 +58,141 @@ pub fn lgetfilecon<P: AsRef<Path>>(path: P) -> Result<String> {
     unimplemented!()
 }
 
+#[cfg(any(target_os = "linux", target_os = "android"))]
+fn get_restorecon_stamp(path: &Path) -> Option<String> {
+    let stamp = extattr::lgetxattr(path, RESTORECON_STAMP_XATTR).ok()?;
+    String::from_utf8(stamp).ok()
+}
+
+#[cfg(any(target_os = "linux", target_os = "android"))]
+fn set_restorecon_stamp(path: &Path, stamp: &str) -> Result<()> {
+    lsetxattr(path, RESTORECON_STAMP_XATTR, stamp, XattrFlags::empty())
+        .with_context(|| format!("Failed to stamp {}", path.display()))?;
+    Ok(())
+}
+
+#[cfg(not(any(target_os = "linux", target_os = "android")))]
+fn get_restorecon_stamp(_path: &Path) -> Option<String> {
+    None
+}
+
+#[cfg(not(any(target_os = "linux", target_os = "android")))]
+fn set_restorecon_stamp(_path: &Path, _stamp: &str) -> Result<()> {
+    Ok(())
+}
+
+/// Every path of a tree, plus a stamp over its directories. Creating,
+/// removing or renaming an entry bumps its parent's mtime, so the stamp
+/// changes whenever some file in the tree may carry a new label.
+fn walk_tree(dir: &Path) -> (Vec<PathBuf>, String) {
+    let mut paths = Vec::new();
+    let mut dirs = Vec::new();
+    for dir_entry in WalkDir::new(dir).into_iter().flatten() {
+        let path = dir_entry.path();
+        if dir_entry.file_type().is_dir() {
+            if let Some(metadata) = dir_entry.metadata().ok() {
+                dirs.push(format!(
+                    "{}:{}:{}.{}",
+                    path.display(),
+                    metadata.ino(),
+                    metadata.mtime(),
+                    metadata.mtime_nsec()
+                ));
+            }
+        }
+        paths.push(path);
+    }
+    dirs.sort_unstable();
+    (paths, sha256::digest(dirs.join("\n")))
+}
+
+/// Run `f` over `paths` split across all cores, failing on the first error.
+fn par_for_each<F>(paths: &[PathBuf], f: F) -> Result<()>
+where
+    F: Fn(&Path) -> Result<()> + Sync,
+{
+    if paths.is_empty() {
+        return Ok(());
+    }
+    let workers = std::thread::available_parallelism()
+        .map_or(4, std::num::NonZeroUsize::get)
+        .min(paths.len());
+    let f = &f;
+    std::thread::scope(|scope| {
+        let handles: Vec<_> = paths
+            .chunks(paths.len().div_ceil(workers))
+            .map(|chunk| scope.spawn(move || chunk.iter().try_for_each(|path| f(path))))
+            .collect();
+        handles.into_iter().try_for_each(|handle| {
+            handle
+                .join()
+                .unwrap_or_else(|_| Err(anyhow!("restorecon worker panicked")))
+        })
+    })
+}
+
 pub fn restore_syscon<P: AsRef<Path>>(dir: P) -> Result<()> {
-    for dir_entry in WalkDir::new(dir).parallelism(Serial) {
-        if let Some(path) = dir_entry.ok().map(|dir_entry| dir_entry.path()) {
-            setsyscon(&path)?;
+    let paths: Vec<PathBuf> = WalkDir::new(dir)
+        .into_iter()
+        .flatten()
+        .map(|dir_entry| dir_entry.path())
+        .collect();
+    par_for_each(&paths, |path| setsyscon(path))
+}
+
+fn restore_module_con(path: &Path) -> Result<()> {
+    if let Result::Ok(con) = lgetfilecon(path) {
+        if con == ADB_CON || con == UNLABEL_CON || con.is_empty() {
+            lsetfilecon(path, SYSTEM_CON)?;
         }
     }
     Ok(())
 }
 
+/// Label one module tree, skipping it entirely when its stamp says nothing
+/// was added or moved since the last fully successful pass.
+fn restore_module_tree(module: &Path) -> Result<()> {
+    let start = Instant::now();
+    let (paths, stamp) = walk_tree(module);
+
+    if get_restorecon_stamp(module).as_deref() == Some(stamp.as_str()) {
+        info!(
+            "restorecon: {} unchanged, {} entries, {:?}",
+            module.display(),
+            paths.len(),
+            start.elapsed()
+        );
+        return Ok(());
+    }
+
+    par_for_each(&paths, restore_module_con)?;
+    if let Err(e) = set_restorecon_stamp(module, &stamp) {
+        warn!("{e}");
+    }
+    info!(
+        "restorecon: {} labeled {} entries, {:?}",
+        module.display(),
+        paths.len(),
+        start.elapsed()
+    );
+    Ok(())
+}
+
 fn restore_modules_con<P: AsRef<Path>>(dir: P) -> Result<()> {
-    for dir_entry in WalkDir::new(dir).parallelism(Serial) {
-        if let Some(path) = dir_entry.ok().map(|dir_entry| dir_entry.path()) {
-            if let Result::Ok(con) = lgetfilecon(&path) {
-                if con == ADB_CON || con == UNLABEL_CON || con.is_empty() {
-                    lsetfilecon(&path, SYSTEM_CON)?;
-                }
-            }
+    let dir = dir.as_ref();
+    let start = Instant::now();
+
+    restore_module_con(dir)?;
+    for entry in std::fs::read_dir(dir)?.flatten() {
+        let path = entry.path();
+        if entry.file_type().is_ok_and(|t| t.is_dir()) {
+            restore_module_tree(&path)?;
+        } else {
+            restore_module_con(&path)?;
         }
     }
+
+    info!("restorecon: {} took {:?}", dir.display(), start.elapsed());
     Ok(())
 }
 
@@ -0,0 +1,224 @@
+use anyhow::{Context, Result, bail};
+use rustix::{
+    fd::{AsFd, OwnedFd},
+    net::{
+        AddressFamily, SocketAddrUnix, SocketFlags, SocketType, accept_with, bind_unix, listen,
+        socket_with, sockopt,
+    },
+};
+use serde_json::{Value, json};
+use std::{
+    io::{BufRead, BufReader, Write},
+    os::unix::net::UnixStream,
+    process::{Command, Stdio},
+};
+
+use crate::{defs, ksucalls, module, profile, su_broker, webui};
+
+// abstract, so it needs no file on /data and vanishes with the daemon
+const SOCKET_NAME: &[u8] = b"ksud_rpc";
+// the one socket type the manager's domains may connect to, from
+// kernel/selinux/rules.c; other su sockets stay out of their reach
+const SOCKET_CONTEXT: &str = "u:object_r:ksud_socket:s0";
+const SOCKCREATE: &str = "/proc/thread-self/attr/sockcreate";
+
+// One JSON object per line in both directions:
+//   -> {"id": 1, "method": "module.list", "params": {...}}
+//   <- {"id": 1, "result": ...} or {"id": 1, "error": "..."}
+// A response may carry one fd as SCM_RIGHTS, sent with its line.
+
+fn param<'a>(params: &'a Value, name: &str) -> Result<&'a str> {
+    params[name]
+        .as_str()
+        .with_context(|| format!("missing string param {name}"))
+}
+
+fn done(result: Result<()>) -> Result<Value> {
+    result.map(|()| Value::Bool(true))
+}
+
+fn dispatch(method: &str, params: &Value, fd: &mut Option<OwnedFd>) -> Result<Value> {
+    match method {
+        "version" => Ok(json!({
+            "code": defs::VERSION_CODE.trim(),
+            "name": defs::VERSION_NAME.trim(),
+        })),
+
+        "module.list" => Ok(serde_json::to_value(module::installed_modules())?),
+        "module.sizes" => Ok(serde_json::to_value(module::collect_module_sizes()?)?),
+        "module.enable" => done(module::enable_module(param(params, "id")?)),
+        "module.disable" => done(module::disable_module(param(params, "id")?)),
+        "module.uninstall" => done(module::uninstall_module(param(params, "id")?)),
+        "module.restore" => done(module::restore_uninstall_module(param(params, "id")?)),
+
+        "profile.get_sepolicy" => Ok(profile::read_sepolicy(param(params, "package")?)?.into()),
+        "profile.set_sepolicy" => done(profile::set_sepolicy(
+            param(params, "package")?.to_string(),
+            param(params, "policy")?.to_string(),
+        )),
+        "profile.list_templates" => Ok(profile::template_ids()?.into()),
+        "profile.get_template" => Ok(profile::read_template(param(params, "id")?)?.into()),
+        "profile.set_template" => done(profile::set_template(
+            param(params, "id")?.to_string(),
+            param(params, "template")?.to_string(),
+        )),
+        "profile.delete_template" => {
+            done(profile::delete_template(param(params, "id")?.to_string()))
+        }
+
+        "webui.open" => {
+            // Accept-Encoding of the WebView's request, no variants without it
+            let accept: Vec<String> = params["encodings"]
+                .as_array()
+                .map(|a| {
+                    a.iter()
+                        .filter_map(|e| Some(e.as_str()?.to_owned()))
+                        .collect()
+                })
+                .unwrap_or_default();
+            let (info, file) =
+                webui::open(param(params, "module")?, param(params, "path")?, &accept)?;
+            *fd = Some(file.into());
+            Ok(info)
+        }
+
+        #[cfg(target_arch = "aarch64")]
+        "kpm.list" => Ok(crate::kpm::kpm_names()?.into()),
+        #[cfg(target_arch = "aarch64")]
+        "kpm.num" => Ok(crate::kpm::kpm_count()?.into()),
+        #[cfg(target_arch = "aarch64")]
+        "kpm.info" => Ok(crate::kpm::kpm_module_info(param(params, "name")?)?.into()),
+        #[cfg(target_arch = "aarch64")]
+        "kpm.version" => Ok(crate::kpm::kpm_loader_version()?.into()),
+        #[cfg(target_arch = "aarch64")]
+        "kpm.control" => Ok(crate::kpm::kpm_control(
+            param(params, "name")?,
+            params["args"].as_str().unwrap_or_default(),
+        )?
+        .into()),
+
+        _ => bail!("unknown method {method}"),
+    }
+}
+
+fn handle_request(line: &str, fd: &mut Option<OwnedFd>) -> Value {
+    let request: Value = match serde_json::from_str(line) {
+        Ok(request) => request,
+        Err(e) => return json!({ "id": null, "error": format!("bad request: {e}") }),
+    };
+    let id = request["id"].clone();
+    let Some(method) = request["method"].as_str() else {
+        return json!({ "id": id, "error": "missing method" });
+    };
+    match dispatch(method, &request["params"], fd) {
+        Ok(result) => json!({ "id": id, "result": result }),
+        Err(e) => json!({ "id": id, "error": format!("{e:#}") }),
+    }
+}
+
+fn serve_client(stream: UnixStream) -> Result<()> {
+    let mut writer = stream.try_clone()?;
+    for line in BufReader::new(stream).lines() {
+        let line = line?;
+        if line.trim().is_empty() {
+            continue;
+        }
+        let mut fd = None;
+        let mut response = serde_json::to_vec(&handle_request(&line, &mut fd))?;
+        response.push(b'\n');
+        match fd {
+            Some(fd) => su_broker::send_with_fds(&writer, &response, &[fd.as_fd()])?,
+            None => writer.write_all(&response)?,
+        }
+    }
+    Ok(())
+}
+
+/// Root callers must be su, the manager must be in an app domain; a uid
+/// alone can be borrowed by anything running as it.
+fn authorized(uid: u32, context: &str) -> bool {
+    let domain = su_broker::context_type(context);
+    if uid == 0 {
+        return domain == "su";
+    }
+    // re-read every time, the manager may have been reinstalled meanwhile
+    domain.starts_with("untrusted_app") && ksucalls::manager_uids().contains(&uid)
+}
+
+/// Create the listening socket as `SOCKET_CONTEXT`, the way
+/// setsockcreatecon() does. Without our rules loaded it falls back to the
+/// daemon's own context, which only root callers can reach.
+fn listener_socket() -> Result<OwnedFd> {
+    if let Err(e) = std::fs::write(SOCKCREATE, SOCKET_CONTEXT) {
+        log::warn!("rpc: label socket {SOCKET_CONTEXT}: {e}");
+    }
+    let listener = socket_with(
+        AddressFamily::UNIX,
+        SocketType::STREAM,
+        SocketFlags::CLOEXEC,
+        None,
+    );
+    // back to the default for every later socket of this thread; an empty
+    // write never reaches the kernel, a lone newline clears it
+    let _ = std::fs::write(SOCKCREATE, "\n");
+    Ok(listener?)
+}
+
+/// Answer the manager's queries over a unix socket, one thread per
+/// connection, so screens load without spawning ksud for every call.
+pub fn run() -> Result<()> {
+    let listener = listener_socket()?;
+    let addr = SocketAddrUnix::new_abstract_name(SOCKET_NAME)?;
+    bind_unix(&listener, &addr).context("ksud daemon already running?")?;
+    listen(&listener, 16)?;
+    log::info!("rpc: listening");
+
+    loop {
+        let conn = accept_with(&listener, SocketFlags::CLOEXEC)?;
+        let uid = match sockopt::get_socket_peercred(&conn) {
+            Ok(cred) => cred.uid.as_raw(),
+            Err(e) => {
+                log::warn!("rpc: peer credentials: {e}");
+                continue;
+            }
+        };
+        let context = match su_broker::peer_context(&conn) {
+            Ok(context) => context,
+            Err(e) => {
+                log::warn!("rpc: peer context: {e}");
+                continue;
+            }
+        };
+        if !authorized(uid, &context) {
+            log::warn!("rpc: rejected uid {uid} in {context}");
+            continue;
+        }
+        let stream = UnixStream::from(conn);
+        std::thread::spawn(move || {
+            if let Err(e) = serve_client(stream) {
+                log::warn!("rpc: client {uid}: {e}");
+            }
+        });
+    }
+}
+
+/// Start the daemon in the background.
+pub fn start() -> Result<()> {
+    use std::os::unix::process::CommandExt;
+
+    let mut cmd = Command::new(defs::DAEMON_PATH);
+    cmd.arg("daemon")
+        .stdin(Stdio::null())
+        .stdout(Stdio::null())
+        .stderr(Stdio::null())
+        .current_dir("/");
+    unsafe {
+        cmd.pre_exec(|| {
+            libc::setsid();
+            Ok(())
+        });
+    }
+    let child = cmd.spawn()?;
+    log::info!("rpc: daemon started with pid: {}", child.id());
+    Ok(())
+}
@@ -7,7 +7,15 @@ use nom::{
     character::complete::{space0, space1},
     combinator::map,
 };
-use std::{ffi, path::Path, vec};
+use std::{
+    collections::HashSet,
+    ffi,
+    path::{Path, PathBuf},
+    sync::Mutex,
+    vec,
+};
+
+use crate::defs;
 
 type SeObject<'a> = Vec<&'a str>;
 
@@ -675,8 +683,8 @@ fn to_c_ptr(pol: &PolicyObject) -> *const ffi::c_char {
     }
 }
 
-impl From<AtomicStatement> for FfiPolicy {
-    fn from(policy: AtomicStatement) -> FfiPolicy {
+impl From<&AtomicStatement> for FfiPolicy {
+    fn from(policy: &AtomicStatement) -> FfiPolicy {
         FfiPolicy {
             cmd: policy.cmd,
             subcmd: policy.subcmd,
@@ -695,7 +703,7 @@ impl From<AtomicStatement> for FfiPolicy {
 fn apply_one_rule<'a>(statement: &'a PolicyStatement<'a>, strict: bool) -> Result<()> {
     let policies: Vec<AtomicStatement> = statement.try_into()?;
 
-    for policy in policies {
+    for policy in &policies {
         if !rustix::process::ksu_set_policy(&FfiPolicy::from(policy)) {
             log::warn!("apply rule: {statement:?} failed.");
             if strict {
@@ -712,6 +720,222 @@ fn apply_one_rule<'a>(_statement: &'a PolicyStatement<'a>, _strict: bool) -> Res
     unimplemented!()
 }
 
+#[cfg(any(target_os = "linux", target_os = "android"))]
+fn apply_atomic_rules(policies: &[AtomicStatement]) {
+    for policy in policies {
+        if !rustix::process::ksu_set_policy(&FfiPolicy::from(policy)) {
+            log::warn!("apply rule: {policy:?} failed.");
+        }
+    }
+}
+
+#[cfg(not(any(target_os = "linux", target_os = "android")))]
+fn apply_atomic_rules(_policies: &[AtomicStatement]) {
+    unimplemented!()
+}
+
+////////////////////////////////////////////////////////////////
+///  precompiled rule cache
+///////////////////////////////////////////////////////////////
+
+// Parsed and expanded rules are stored in SEPOLICY_CACHE_DIR/<sha256 of source>,
+// so an updated module (or profile) simply misses the cache.
+const CACHE_MAGIC: &[u8; 4] = b"KSEP";
+const CACHE_VERSION: u32 = 1;
+
+const OBJ_NONE: u8 = 0;
+const OBJ_ALL: u8 = 1;
+const OBJ_ONE: u8 = 2;
+
+// cache keys used during this run, everything else is pruned by `prune_rule_cache`
+static CACHE_USED: Mutex<Vec<String>> = Mutex::new(Vec::new());
+
+fn take<'a>(buf: &mut &'a [u8], n: usize) -> Result<&'a [u8]> {
+    anyhow::ensure!(buf.len() >= n, "truncated sepolicy cache");
+    let (head, tail) = buf.split_at(n);
+    *buf = tail;
+    Ok(head)
+}
+
+fn take_u32(buf: &mut &[u8]) -> Result<u32> {
+    let bytes = take(buf, 4)?;
+    Ok(u32::from_le_bytes(bytes.try_into()?))
+}
+
+impl PolicyObject {
+    fn encode(&self, out: &mut Vec<u8>) {
+        match self {
+            PolicyObject::None => out.push(OBJ_NONE),
+            PolicyObject::All => out.push(OBJ_ALL),
+            PolicyObject::One(s) => {
+                let len = s.iter().position(|&c| c == 0).unwrap_or(SEPOLICY_MAX_LEN);
+                out.push(OBJ_ONE);
+                out.push(len as u8);
+                out.extend_from_slice(&s[..len]);
+            }
+        }
+    }
+
+    fn decode(buf: &mut &[u8]) -> Result<Self> {
+        match take(buf, 1)?[0] {
+            OBJ_NONE => Ok(PolicyObject::None),
+            OBJ_ALL => Ok(PolicyObject::All),
+            OBJ_ONE => {
+                let len = take(buf, 1)?[0] as usize;
+                anyhow::ensure!(len <= SEPOLICY_MAX_LEN, "policy object too long");
+                let mut s = [0u8; SEPOLICY_MAX_LEN];
+                s[..len].copy_from_slice(take(buf, len)?);
+                Ok(PolicyObject::One(s))
+            }
+            tag => bail!("bad policy object tag: {tag}"),
+        }
+    }
+}
+
+impl AtomicStatement {
+    fn encode(&self, out: &mut Vec<u8>) {
+        out.extend_from_slice(&self.cmd.to_le_bytes());
+        out.extend_from_slice(&self.subcmd.to_le_bytes());
+        for obj in [
+            &self.sepol1,
+            &self.sepol2,
+            &self.sepol3,
+            &self.sepol4,
+            &self.sepol5,
+            &self.sepol6,
+            &self.sepol7,
+        ] {
+            obj.encode(out);
+        }
+    }
+
+    fn decode(buf: &mut &[u8]) -> Result<Self> {
+        Ok(AtomicStatement::new(
+            take_u32(buf)?,
+            take_u32(buf)?,
+            PolicyObject::decode(buf)?,
+            PolicyObject::decode(buf)?,
+            PolicyObject::decode(buf)?,
+            PolicyObject::decode(buf)?,
+            PolicyObject::decode(buf)?,
+            PolicyObject::decode(buf)?,
+            PolicyObject::decode(buf)?,
+        ))
+    }
+}
+
+fn encode_rules(rules: &[AtomicStatement]) -> Vec<u8> {
+    let mut out = Vec::with_capacity(12 + rules.len() * 32);
+    out.extend_from_slice(CACHE_MAGIC);
+    out.extend_from_slice(&CACHE_VERSION.to_le_bytes());
+    out.extend_from_slice(&(rules.len() as u32).to_le_bytes());
+    for rule in rules {
+        rule.encode(&mut out);
+    }
+    out
+}
+
+fn decode_rules(mut buf: &[u8]) -> Result<Vec<AtomicStatement>> {
+    anyhow::ensure!(
+        take(&mut buf, 4)? == CACHE_MAGIC,
+        "bad sepolicy cache magic"
+    );
+    anyhow::ensure!(
+        take_u32(&mut buf)? == CACHE_VERSION,
+        "sepolicy cache version mismatch"
+    );
+    let count = take_u32(&mut buf)? as usize;
+    let mut rules = Vec::with_capacity(count);
+    for _ in 0..count {
+        rules.push(AtomicStatement::decode(&mut buf)?);
+    }
+    anyhow::ensure!(buf.is_empty(), "trailing data in sepolicy cache");
+    Ok(rules)
+}
+
+fn compile_rules(input: &str) -> Result<Vec<AtomicStatement>> {
+    let mut rules = vec![];
+    for statement in parse_sepolicy(input.trim(), false)? {
+        let atomic: Vec<AtomicStatement> = (&statement).try_into()?;
+        rules.extend(atomic);
+    }
+    Ok(rules)
+}
+
+fn load_cached_rules(cache_file: &Path) -> Option<Vec<AtomicStatement>> {
+    let blob = std::fs::read(cache_file).ok()?;
+    match decode_rules(&blob) {
+        Ok(rules) => Some(rules),
+        Err(e) => {
+            log::warn!("invalid sepolicy cache {}: {e}", cache_file.display());
+            None
+        }
+    }
+}
+
+fn store_cached_rules(cache_file: &Path, rules: &[AtomicStatement]) -> Result<()> {
+    crate::utils::ensure_dir_exists(defs::SEPOLICY_CACHE_DIR)?;
+    let tmp = cache_file.with_extension("tmp");
+    std::fs::write(&tmp, encode_rules(rules))?;
+    std::fs::rename(&tmp, cache_file)?;
+    Ok(())
+}
+
+/// Like `apply_file`, but reuses the precompiled rules of an unchanged file.
+pub fn apply_file_cached<P: AsRef<Path>>(path: P) -> Result<()> {
+    let path = path.as_ref();
+    let content = std::fs::read(path)?;
+    let key = sha256::digest(&content);
+    let cache_file = Path::new(defs::SEPOLICY_CACHE_DIR).join(&key);
+
+    let rules = match load_cached_rules(&cache_file) {
+        Some(rules) => {
+            log::info!("sepolicy cache hit: {}", path.display());
+            rules
+        }
+        None => {
+            let input = String::from_utf8(content)?;
+            let Ok(rules) = compile_rules(&input) else {
+                // keep the old partial-apply behaviour for invalid files, uncached
+                return live_patch(&input);
+            };
+            if let Err(e) = store_cached_rules(&cache_file, &rules) {
+                log::warn!("failed to cache sepolicy {}: {e}", path.display());
+            }
+            rules
+        }
+    };
+
+    if let Ok(mut used) = CACHE_USED.lock() {
+        used.push(key);
+    }
+    apply_atomic_rules(&rules);
+    Ok(())
+}
+
+/// Remove cached rule sets not used by `apply_file_cached` in this run.
+pub fn prune_rule_cache() -> Result<()> {
+    let dir = Path::new(defs::SEPOLICY_CACHE_DIR);
+    if !dir.is_dir() {
+        return Ok(());
+    }
+    let used: HashSet<String> = CACHE_USED
+        .lock()
+        .map(|used| used.iter().cloned().collect())
+        .unwrap_or_default();
+    for entry in std::fs::read_dir(dir)?.flatten() {
+        let name = entry.file_name();
+        if used.contains(name.to_string_lossy().as_ref()) {
+            continue;
+        }
+        let path: PathBuf = entry.path();
+        if let Err(e) = std::fs::remove_file(&path) {
+            log::warn!("failed to remove {}: {e}", path.display());
+        }
+    }
+    Ok(())
+}
+
 pub fn live_patch(policy: &str) -> Result<()> {
     let result = parse_sepolicy(policy.trim(), false)?;
     for statement in result {
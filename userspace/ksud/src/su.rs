@@ -25,7 +25,7 @@ pub fn grant_root(global_mnt: bool) -> Result<()> {
     let command = unsafe {
         command.pre_exec(move || {
             if global_mnt {
-                let _ = utils::switch_mnt_ns(1);
+                let _ = utils::switch_global_mnt_ns();
             }
             Result::Ok(())
         })
@@ -41,6 +41,12 @@ pub fn grant_root(_global_mnt: bool) -> Result<()> {
     unimplemented!("grant_root is only available on android");
 }
 
+pub fn is_su_invocation() -> bool {
+    env::args_os()
+        .next()
+        .is_some_and(|arg0| arg0 == "su" || arg0 == "/system/bin/su")
+}
+
 fn print_usage(program: &str, opts: Options) {
     let brief = format!("KernelSU\n\nUsage: {program} [options] [-] [user [argument...]]");
     print!("{}", opts.usage(&brief));
@@ -214,6 +220,21 @@ pub fn root_shell() -> Result<()> {
         }
     }
 
+    // hand plain `su -c` over to a warm broker worker when asked to, the
+    // full path below stays the fallback if none is listening
+    let plain_command = !is_login
+        && !preserve_env
+        && !matches.opt_present("s")
+        && gid.is_none()
+        && free_idx >= matches.free.len();
+    if plain_command && env::var_os("KSU_SU_BROKER").is_some() {
+        if let Some(cmd) = matches.opt_str("c") {
+            if let Result::Ok(code) = crate::su_broker::exec(&cmd, mount_master) {
+                std::process::exit(code);
+            }
+        }
+    }
+
     // if there is no gid provided, use uid.
     let gid = gid.unwrap_or(uid);
     // https://github.com/topjohnwu/Magisk/blob/master/native/src/su/su_daemon.cpp#L408
@@ -262,7 +283,7 @@ pub fn root_shell() -> Result<()> {
             // switch to global mount namespace
             #[cfg(any(target_os = "linux", target_os = "android"))]
             if mount_master {
-                let _ = utils::switch_mnt_ns(1);
+                let _ = utils::switch_global_mnt_ns();
             }
 
             set_identity(uid, gid, &groups);
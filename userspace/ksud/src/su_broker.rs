@@ -0,0 +1,655 @@
+use anyhow::{Context, Result, bail, ensure};
+use rustix::{
+    fd::{AsFd, AsRawFd, BorrowedFd, OwnedFd},
+    fs::{Mode, OFlags},
+    net::{
+        AddressFamily, RecvAncillaryBuffer, RecvAncillaryMessage, RecvFlags, SendAncillaryBuffer,
+        SendAncillaryMessage, SendFlags, SocketAddrUnix, SocketFlags, SocketType, accept_with,
+        bind_unix, connect_unix, listen, recv, recvmsg, send, sendmsg, socket_with, socketpair,
+        sockopt,
+    },
+    thread::{
+        CapabilityFlags, CapabilitySets, Gid, Uid, set_capabilities, set_keep_capabilities,
+        set_thread_groups, set_thread_res_gid, set_thread_res_uid,
+    },
+};
+use std::{
+    collections::HashMap,
+    ffi::{OsStr, OsString},
+    fs::File,
+    io::{IoSlice, IoSliceMut},
+    os::unix::{
+        ffi::OsStrExt,
+        fs::MetadataExt,
+        process::{CommandExt, ExitStatusExt},
+    },
+    process::{Child, Command, ExitStatus, Stdio},
+    time::{Duration, Instant},
+};
+
+use crate::{defs, ksucalls, utils};
+
+const SOCKET_NAME: &[u8] = b"ksu_su_broker";
+const MAX_REQUEST: usize = 64 * 1024;
+const FLAG_MOUNT_MASTER: u32 = 1;
+// clients send their request right after connecting
+const RECV_TIMEOUT: Duration = Duration::from_millis(500);
+// the only domain served, see `serve`
+const SU_DOMAIN: &str = "su";
+
+// request: u32 flags, u32 length of the environment, the environment as
+// NUL-terminated KEY=VALUE entries, then the command. stdin, stdout, stderr
+// and the client's working directory are attached.
+// reply: the i32 exit status once the command has finished
+
+fn socket_addr() -> Result<SocketAddrUnix> {
+    Ok(SocketAddrUnix::new_abstract_name(SOCKET_NAME)?)
+}
+
+fn seqpacket() -> Result<OwnedFd> {
+    Ok(socket_with(
+        AddressFamily::UNIX,
+        SocketType::SEQPACKET,
+        SocketFlags::CLOEXEC,
+        None,
+    )?)
+}
+
+pub fn send_with_fds(socket: &impl AsFd, payload: &[u8], fds: &[BorrowedFd<'_>]) -> Result<()> {
+    let mut space = [0u8; rustix::cmsg_space!(ScmRights(5))];
+    let mut control = SendAncillaryBuffer::new(&mut space);
+    ensure!(
+        control.push(SendAncillaryMessage::ScmRights(fds)),
+        "too many fds"
+    );
+    sendmsg(
+        socket,
+        &[IoSlice::new(payload)],
+        &mut control,
+        SendFlags::NOSIGNAL,
+    )?;
+    Ok(())
+}
+
+fn recv_with_fds(socket: &OwnedFd, buffer: &mut [u8]) -> Result<(usize, Vec<OwnedFd>)> {
+    let mut space = [0u8; rustix::cmsg_space!(ScmRights(5))];
+    let mut control = RecvAncillaryBuffer::new(&mut space);
+    let msg = recvmsg(
+        socket,
+        &mut [IoSliceMut::new(buffer)],
+        &mut control,
+        RecvFlags::CMSG_CLOEXEC,
+    )?;
+    let mut fds = Vec::new();
+    for message in control.drain() {
+        if let RecvAncillaryMessage::ScmRights(rights) = message {
+            fds.extend(rights);
+        }
+    }
+    // RecvFlags has no CTRUNC, check the raw bits
+    let truncated = (libc::MSG_TRUNC | libc::MSG_CTRUNC) as u32;
+    ensure!(msg.flags.bits() & truncated == 0, "request too large");
+    Ok((msg.bytes, fds))
+}
+
+fn mnt_ns_id(pid: i32) -> Result<u64> {
+    Ok(std::fs::metadata(format!("/proc/{pid}/ns/mnt"))?.ino())
+}
+
+/// SELinux context of the process that connected `socket`, as the kernel
+/// labelled it at connect time.
+pub fn peer_context(socket: &impl AsFd) -> Result<String> {
+    let mut buffer = [0u8; 256];
+    let mut len = buffer.len() as libc::socklen_t;
+    // SAFETY: buffer and len describe a valid, writable buffer.
+    let ret = unsafe {
+        libc::getsockopt(
+            socket.as_fd().as_raw_fd(),
+            libc::SOL_SOCKET,
+            libc::SO_PEERSEC,
+            buffer.as_mut_ptr().cast(),
+            &mut len,
+        )
+    };
+    ensure!(ret == 0, "SO_PEERSEC: {}", std::io::Error::last_os_error());
+    let context = &buffer[..(len as usize).min(buffer.len())];
+    let context = context.split(|&b| b == 0).next().unwrap_or_default();
+    Ok(String::from_utf8(context.to_vec())?)
+}
+
+/// The type field of `u:r:type:s0`.
+pub fn context_type(context: &str) -> &str {
+    context.split(':').nth(2).unwrap_or_default()
+}
+
+/// Everything a root profile decides about a su process. Workers are keyed
+/// on it and take it on verbatim, so a request never runs with more than
+/// the `su` that sent it would have had.
+#[derive(Clone, PartialEq, Eq, Hash)]
+struct PeerCred {
+    // real, effective, saved
+    uids: [u32; 3],
+    gids: [u32; 3],
+    groups: Vec<u32>,
+    // inheritable, permitted, effective, bounding
+    caps: [u64; 4],
+    context: String,
+}
+
+fn status_ids<const N: usize>(value: &str) -> Result<[u32; N]> {
+    let ids = value
+        .split_whitespace()
+        .take(N)
+        .map(str::parse)
+        .collect::<Result<Vec<u32>, _>>()?;
+    ids.try_into()
+        .map_err(|_| anyhow::anyhow!("short id list {value:?}"))
+}
+
+fn peer_cred(pid: i32, context: String) -> Result<PeerCred> {
+    let status = std::fs::read_to_string(format!("/proc/{pid}/status"))?;
+    let mut cred = PeerCred {
+        uids: [0; 3],
+        gids: [0; 3],
+        groups: Vec::new(),
+        caps: [0; 4],
+        context,
+    };
+    let mut seen = 0;
+    for line in status.lines() {
+        let Some((key, value)) = line.split_once(':') else {
+            continue;
+        };
+        let cap = || u64::from_str_radix(value.trim(), 16);
+        match key {
+            "Uid" => cred.uids = status_ids(value)?,
+            "Gid" => cred.gids = status_ids(value)?,
+            "Groups" => {
+                cred.groups = value
+                    .split_whitespace()
+                    .map(str::parse)
+                    .collect::<Result<_, _>>()?
+            }
+            "CapInh" => cred.caps[0] = cap()?,
+            "CapPrm" => cred.caps[1] = cap()?,
+            "CapEff" => cred.caps[2] = cap()?,
+            "CapBnd" => cred.caps[3] = cap()?,
+            _ => continue,
+        }
+        seen += 1;
+    }
+    ensure!(seen == 7, "incomplete /proc/{pid}/status");
+    Ok(cred)
+}
+
+/// Drop to `cred`: bounding set first while CAP_SETPCAP is still ours,
+/// then ids, then the capability sets the ids change would have cleared.
+fn apply_cred(cred: &PeerCred) -> Result<()> {
+    let last_cap: u32 = std::fs::read_to_string("/proc/sys/kernel/cap_last_cap")?
+        .trim()
+        .parse()?;
+    for cap in 0..=last_cap.min(63) {
+        if cred.caps[3] & (1 << cap) == 0 {
+            // SAFETY: plain prctl on the calling thread.
+            let ret = unsafe { libc::prctl(libc::PR_CAPBSET_DROP, cap as libc::c_ulong, 0, 0, 0) };
+            ensure!(
+                ret == 0,
+                "drop cap {cap}: {}",
+                std::io::Error::last_os_error()
+            );
+        }
+    }
+
+    set_keep_capabilities(true)?;
+    // SAFETY: the ids come from the kernel, not from the request.
+    let groups: Vec<Gid> = cred
+        .groups
+        .iter()
+        .map(|&g| unsafe { Gid::from_raw(g) })
+        .collect();
+    set_thread_groups(&groups)?;
+    let [rgid, egid, sgid] = cred.gids.map(|g| unsafe { Gid::from_raw(g) });
+    set_thread_res_gid(rgid, egid, sgid)?;
+    let [ruid, euid, suid] = cred.uids.map(|u| unsafe { Uid::from_raw(u) });
+    set_thread_res_uid(ruid, euid, suid)?;
+    set_keep_capabilities(false)?;
+
+    let [inheritable, permitted, effective, _] = cred.caps;
+    set_capabilities(
+        None,
+        CapabilitySets {
+            // the kernel raises a few extra effective caps for ksud itself,
+            // they are dropped on exec and can't be set beyond permitted
+            effective: CapabilityFlags::from_bits_retain(effective & permitted),
+            permitted: CapabilityFlags::from_bits_retain(permitted),
+            inheritable: CapabilityFlags::from_bits_retain(inheritable),
+        },
+    )?;
+    Ok(())
+}
+
+struct Request {
+    command: String,
+    env: Vec<(OsString, OsString)>,
+    // stdin, stdout, stderr and the working directory
+    fds: [OwnedFd; 4],
+}
+
+fn parse_request(buffer: &[u8], fds: Vec<OwnedFd>) -> Result<Request> {
+    ensure!(buffer.len() >= 8, "short request");
+    let Ok(fds) = <[OwnedFd; 4]>::try_from(fds) else {
+        bail!("request must carry stdin, stdout, stderr and cwd");
+    };
+    let env_len = u32::from_le_bytes(buffer[4..8].try_into()?) as usize;
+    let Some(env) = buffer.get(8..8 + env_len) else {
+        bail!("short request");
+    };
+    let env = env
+        .split(|&b| b == 0)
+        .filter_map(|entry| {
+            let eq = entry.iter().position(|&b| b == b'=')?;
+            Some((
+                OsStr::from_bytes(&entry[..eq]).to_owned(),
+                OsStr::from_bytes(&entry[eq + 1..]).to_owned(),
+            ))
+        })
+        .collect();
+    Ok(Request {
+        command: String::from_utf8(buffer[8 + env_len..].to_vec())?,
+        env,
+        fds,
+    })
+}
+
+/// Wait for `child`, taking its whole session down if the client hangs up
+/// first: nobody is left to read its output or its exit status.
+fn wait_or_hangup(conn: &OwnedFd, child: &mut Child) -> std::io::Result<ExitStatus> {
+    let (done_read, done_write) = rustix::pipe::pipe_with(rustix::pipe::PipeFlags::CLOEXEC)?;
+    let session = child.id() as libc::pid_t;
+    std::thread::scope(|scope| {
+        scope.spawn(|| {
+            let mut fds = [
+                libc::pollfd {
+                    fd: conn.as_raw_fd(),
+                    events: libc::POLLRDHUP,
+                    revents: 0,
+                },
+                libc::pollfd {
+                    fd: done_read.as_raw_fd(),
+                    events: libc::POLLIN,
+                    revents: 0,
+                },
+            ];
+            loop {
+                // SAFETY: fds is a valid pollfd array for the whole call.
+                let ret = unsafe { libc::poll(fds.as_mut_ptr(), fds.len() as _, -1) };
+                if ret >= 0
+                    || std::io::Error::last_os_error().kind() != std::io::ErrorKind::Interrupted
+                {
+                    break;
+                }
+            }
+            if fds[1].revents == 0 && fds[0].revents != 0 {
+                log::warn!("su broker: client hung up, killing session {session}");
+                // SAFETY: plain kill of the session the command leads.
+                unsafe { libc::kill(-session, libc::SIGKILL) };
+            }
+        });
+        let status = child.wait();
+        drop(done_write);
+        status
+    })
+}
+
+fn run_request(conn: OwnedFd, request: Request, user_env: &[(&str, String)]) {
+    let Request { command, env, fds } = request;
+    let [stdin, stdout, stderr, cwd] = fds;
+
+    // what the regular su path adds to the caller's environment
+    let mut path = env
+        .iter()
+        .find(|(key, _)| key == "PATH")
+        .map_or_else(Vec::new, |(_, value)| {
+            std::env::split_paths(value).collect()
+        });
+    let bin = std::path::PathBuf::from(defs::BINARY_DIR.trim_end_matches('/'));
+    if !path.contains(&bin) {
+        path.push(bin);
+    }
+    let set_rc =
+        std::path::Path::new(defs::KSURC_PATH).exists() && !env.iter().any(|(key, _)| key == "ENV");
+
+    let mut shell = Command::new("/system/bin/sh");
+    shell
+        .arg("-c")
+        .arg(&command)
+        .env_clear()
+        .envs(env)
+        .envs(user_env.iter().cloned())
+        .stdin(Stdio::from(stdin))
+        .stdout(Stdio::from(stdout))
+        .stderr(Stdio::from(stderr));
+    if let Ok(path) = std::env::join_paths(path) {
+        shell.env("PATH", path);
+    }
+    if set_rc {
+        shell.env("ENV", defs::KSURC_PATH);
+    }
+    let cwd = cwd.as_raw_fd();
+    // SAFETY: fchdir and setsid are async-signal-safe. The command gets its
+    // own session so a hangup can kill everything it started.
+    unsafe {
+        shell.pre_exec(move || {
+            if libc::fchdir(cwd) != 0 || libc::setsid() < 0 {
+                return Err(std::io::Error::last_os_error());
+            }
+            Ok(())
+        })
+    };
+
+    let status = shell
+        .spawn()
+        .and_then(|mut child| wait_or_hangup(&conn, &mut child));
+    let code = match status {
+        Ok(status) => status
+            .code()
+            .unwrap_or_else(|| 128 + status.signal().unwrap_or(0)),
+        Err(e) => {
+            log::warn!("su broker: spawn failed: {e}");
+            127
+        }
+    };
+    let _ = send(&conn, &code.to_le_bytes(), SendFlags::NOSIGNAL);
+}
+
+// A warm process living in one mount namespace with one client's
+// credentials. It only ever gets requests the broker has already
+// authorized, together with the client connection to answer on.
+fn worker_main(channel: OwnedFd, ns_pid: i32, cred: &PeerCred) -> ! {
+    // setns refuses multithreaded callers, so switch before any thread exists
+    let switched = if ns_pid == 1 {
+        utils::switch_global_mnt_ns()
+    } else {
+        utils::switch_mnt_ns(ns_pid)
+    };
+    if let Err(e) = switched {
+        log::error!("su broker: switch mount namespace of {ns_pid}: {e}");
+        std::process::exit(1);
+    }
+    utils::umask(0o22);
+    utils::switch_cgroups();
+    // set like the regular su path does for the target user; getpwuid is
+    // not thread safe, so look it up once here
+    let mut user_env = vec![("SHELL", "/system/bin/sh".to_owned())];
+    // SAFETY: still single threaded, the entry is copied out right away.
+    if let Some(pw) = unsafe { libc::getpwuid(cred.uids[1]).as_ref() } {
+        let home = unsafe { std::ffi::CStr::from_ptr(pw.pw_dir) };
+        let name = unsafe { std::ffi::CStr::from_ptr(pw.pw_name) };
+        let name = name.to_string_lossy().into_owned();
+        user_env.push(("HOME", home.to_string_lossy().into_owned()));
+        user_env.push(("USER", name.clone()));
+        user_env.push(("LOGNAME", name));
+    }
+    // last, everything above may need more than the client has
+    if let Err(e) = apply_cred(cred) {
+        log::error!("su broker: take on client credentials: {e}");
+        std::process::exit(1);
+    }
+
+    let mut buffer = vec![0u8; MAX_REQUEST];
+    loop {
+        let (len, mut fds) = match recv_with_fds(&channel, &mut buffer) {
+            Ok((0, _)) => std::process::exit(0),
+            Ok(msg) => msg,
+            Err(e) => {
+                log::warn!("su broker worker: {e}");
+                continue;
+            }
+        };
+        if fds.len() != 5 {
+            continue;
+        }
+        let conn = fds.remove(0);
+        let request = match parse_request(&buffer[..len], fds) {
+            Ok(request) => request,
+            Err(e) => {
+                log::warn!("su broker worker: {e}");
+                continue;
+            }
+        };
+        let user_env = user_env.clone();
+        std::thread::spawn(move || run_request(conn, request, &user_env));
+    }
+}
+
+fn spawn_worker(listener: &OwnedFd, ns_pid: i32, cred: &PeerCred) -> Result<OwnedFd> {
+    let (ours, theirs) = socketpair(
+        AddressFamily::UNIX,
+        SocketType::SEQPACKET,
+        SocketFlags::CLOEXEC,
+        None,
+    )?;
+    // SAFETY: the broker is single threaded, the child never returns.
+    match unsafe { libc::fork() } {
+        -1 => bail!("fork: {}", std::io::Error::last_os_error()),
+        0 => {
+            // SAFETY: the child must not keep accepting on the broker's socket.
+            unsafe { libc::close(listener.as_raw_fd()) };
+            drop(ours);
+            worker_main(theirs, ns_pid, cred)
+        }
+        _ => Ok(ours),
+    }
+}
+
+fn authorized(uid: u32, context: &str) -> bool {
+    // anything else, app domains included, takes the regular su path
+    context_type(context) == SU_DOMAIN && (uid == 0 || ksucalls::uid_granted_root(uid))
+}
+
+/// Serve `su -c` style requests from root-granted clients in the su domain,
+/// keeping one warm worker per (client credentials, mount namespace).
+pub fn serve() -> Result<()> {
+    let listener = seqpacket()?;
+    bind_unix(&listener, &socket_addr()?).context("su broker already running?")?;
+    listen(&listener, 64)?;
+    log::info!("su broker: listening");
+
+    let global_ns = mnt_ns_id(1)?;
+    let mut workers: HashMap<(PeerCred, u64), OwnedFd> = HashMap::new();
+    let mut buffer = vec![0u8; MAX_REQUEST];
+    loop {
+        // reap workers that exited, their entries fail on the next send
+        // SAFETY: non-blocking waitpid on any child.
+        while unsafe { libc::waitpid(-1, std::ptr::null_mut(), libc::WNOHANG) } > 0 {}
+
+        let conn = accept_with(&listener, SocketFlags::CLOEXEC)?;
+        // requests are read on this one thread, a client that connects and
+        // sends nothing must not hold up everyone else
+        if let Err(e) =
+            sockopt::set_socket_timeout(&conn, sockopt::Timeout::Recv, Some(RECV_TIMEOUT))
+        {
+            log::warn!("su broker: receive timeout: {e}");
+            continue;
+        }
+        let cred = match sockopt::get_socket_peercred(&conn) {
+            Ok(cred) => cred,
+            Err(e) => {
+                log::warn!("su broker: peer credentials: {e}");
+                continue;
+            }
+        };
+        let uid = cred.uid.as_raw();
+        let pid = cred.pid.as_raw_nonzero().get();
+        let context = match peer_context(&conn) {
+            Ok(context) => context,
+            Err(e) => {
+                log::warn!("su broker: peer context: {e}");
+                continue;
+            }
+        };
+        if !authorized(uid, &context) {
+            log::warn!("su broker: rejected uid {uid} in {context}");
+            continue;
+        }
+        // SO_PEERCRED only has the effective ids, the rest of the profile
+        // is read from /proc; a recycled pid would not match the socket
+        let peer = match peer_cred(pid, context) {
+            Ok(peer) if peer.uids[1] == uid && peer.gids[1] == cred.gid.as_raw() => peer,
+            Ok(_) => {
+                log::warn!("su broker: pid {pid} changed credentials");
+                continue;
+            }
+            Err(e) => {
+                log::warn!("su broker: credentials of {pid}: {e}");
+                continue;
+            }
+        };
+
+        let (len, fds) = match recv_with_fds(&conn, &mut buffer) {
+            Ok(msg) => msg,
+            Err(e) => {
+                log::warn!("su broker: {e}");
+                continue;
+            }
+        };
+        if len < 8 || fds.len() != 4 {
+            continue;
+        }
+        let flags = u32::from_le_bytes(buffer[..4].try_into()?);
+        let ns_pid = if flags & FLAG_MOUNT_MASTER != 0 {
+            1
+        } else {
+            pid
+        };
+        let ns = if ns_pid == 1 {
+            global_ns
+        } else {
+            match mnt_ns_id(ns_pid) {
+                Ok(ns) => ns,
+                Err(_) => continue,
+            }
+        };
+
+        let mut passed: Vec<BorrowedFd<'_>> = vec![conn.as_fd()];
+        passed.extend(fds.iter().map(AsFd::as_fd));
+        let payload = &buffer[..len];
+        let key = (peer, ns);
+        let sent = workers
+            .get(&key)
+            .is_some_and(|worker| send_with_fds(worker, payload, &passed).is_ok());
+        if !sent {
+            let worker = match spawn_worker(&listener, ns_pid, &key.0) {
+                Ok(worker) => worker,
+                Err(e) => {
+                    log::error!("su broker: {e}");
+                    continue;
+                }
+            };
+            if let Err(e) = send_with_fds(&worker, payload, &passed) {
+                log::error!("su broker: {e}");
+                continue;
+            }
+            workers.insert(key, worker);
+        }
+    }
+}
+
+/// Run `command` through the broker with the given stdio, in our working
+/// directory and environment, returning its exit status. Fails fast if no
+/// broker is listening.
+pub fn exec_with(command: &str, mount_master: bool, stdio: [BorrowedFd<'_>; 3]) -> Result<i32> {
+    let mut env = Vec::new();
+    for (key, value) in std::env::vars_os() {
+        env.extend_from_slice(key.as_bytes());
+        env.push(b'=');
+        env.extend_from_slice(value.as_bytes());
+        env.push(0);
+    }
+    let flags = if mount_master { FLAG_MOUNT_MASTER } else { 0 };
+    let mut payload = flags.to_le_bytes().to_vec();
+    payload.extend_from_slice(&(env.len() as u32).to_le_bytes());
+    payload.extend_from_slice(&env);
+    payload.extend_from_slice(command.as_bytes());
+    ensure!(payload.len() <= MAX_REQUEST, "command too long");
+
+    let cwd = rustix::fs::open(
+        ".",
+        OFlags::PATH | OFlags::DIRECTORY | OFlags::CLOEXEC,
+        Mode::empty(),
+    )?;
+    let socket = seqpacket()?;
+    connect_unix(&socket, &socket_addr()?)?;
+    let [stdin, stdout, stderr] = stdio;
+    send_with_fds(&socket, &payload, &[stdin, stdout, stderr, cwd.as_fd()])?;
+
+    let mut code = [0u8; 4];
+    let n = recv(&socket, &mut code, RecvFlags::empty())?;
+    ensure!(n == code.len(), "su broker closed the connection");
+    Ok(i32::from_le_bytes(code))
+}
+
+pub fn exec(command: &str, mount_master: bool) -> Result<i32> {
+    let stdio = [
+        rustix::stdio::stdin(),
+        rustix::stdio::stdout(),
+        rustix::stdio::stderr(),
+    ];
+    exec_with(command, mount_master, stdio)
+}
+
+fn report(mode: &str, mut samples: Vec<Duration>) {
+    samples.sort();
+    let total: Duration = samples.iter().sum();
+    let pick = |q: f64| samples[((samples.len() - 1) as f64 * q) as usize];
+    println!(
+        "{mode:>6}: {} runs, avg {:?}, p50 {:?}, p99 {:?}",
+        samples.len(),
+        total / samples.len() as u32,
+        pick(0.5),
+        pick(0.99)
+    );
+}
+
+fn drop_caches() -> Result<()> {
+    // SAFETY: plain syscall without arguments.
+    unsafe { libc::sync() };
+    std::fs::write("/proc/sys/vm/drop_caches", "3")?;
+    Ok(())
+}
+
+/// Compare `su -c` against the broker for the same command. With `cold`
+/// the page cache is dropped before every `su`, so each run pays for
+/// loading ksud again like the first `su` after boot does.
+pub fn bench(count: usize, command: &str, cold: bool) -> Result<()> {
+    ensure!(count > 0, "count must be positive");
+    let null = File::options().read(true).write(true).open("/dev/null")?;
+
+    let mut su = Vec::with_capacity(count);
+    for _ in 0..count {
+        if cold {
+            drop_caches()?;
+        }
+        let start = Instant::now();
+        Command::new("su")
+            .args(["-c", command])
+            .stdin(Stdio::null())
+            .stdout(Stdio::null())
+            .stderr(Stdio::null())
+            .status()?;
+        su.push(start.elapsed());
+    }
+    report("su", su);
+
+    let mut broker = Vec::with_capacity(count);
+    for _ in 0..count {
+        let start = Instant::now();
+        if exec_with(command, false, [null.as_fd(), null.as_fd(), null.as_fd()]).is_err() {
+            println!("broker: not running, start it with `ksud debug su-broker`");
+            return Ok(());
+        }
+        broker.push(start.elapsed());
+    }
+    report("broker", broker);
+    Ok(())
+}
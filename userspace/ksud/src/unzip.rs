@@ -0,0 +1,334 @@
+use anyhow::{Context, Result, bail};
+use rustix::{
+    fs::{FallocateFlags, copy_file_range, fallocate},
+    io::Errno,
+};
+use std::{
+    fs::{File, Permissions, create_dir_all, set_permissions},
+    io::{self, Read, Seek, SeekFrom},
+    num::NonZeroUsize,
+    os::unix::fs::{FileExt, PermissionsExt, symlink},
+    path::{Path, PathBuf},
+    sync::{
+        Arc, Mutex,
+        atomic::{AtomicBool, AtomicUsize, Ordering},
+    },
+    time::{Duration, Instant},
+};
+use zip::{CompressionMethod, ZipArchive};
+
+const COPY_CHUNK: usize = 1 << 20;
+
+/// Positioned reader over a shared fd, so every worker gets its own cursor
+/// into the archive without reopening it or parsing it again.
+#[derive(Clone)]
+struct SharedFile {
+    file: Arc<File>,
+    pos: u64,
+    len: u64,
+}
+
+impl Read for SharedFile {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let n = self.file.read_at(buf, self.pos)?;
+        self.pos += n as u64;
+        Ok(n)
+    }
+}
+
+impl Seek for SharedFile {
+    fn seek(&mut self, pos: SeekFrom) -> io::Result<u64> {
+        let pos = match pos {
+            SeekFrom::Start(offset) => Some(offset),
+            SeekFrom::End(offset) => self.len.checked_add_signed(offset),
+            SeekFrom::Current(offset) => self.pos.checked_add_signed(offset),
+        };
+        self.pos = pos.ok_or_else(|| io::Error::from(io::ErrorKind::InvalidInput))?;
+        Ok(self.pos)
+    }
+}
+
+enum EntryKind {
+    Dir,
+    Symlink,
+    File,
+    // stored with no encryption header, raw bytes are the file content
+    Stored { data_start: u64, crc32: u32 },
+}
+
+struct Entry {
+    index: usize,
+    path: PathBuf,
+    size: u64,
+    mode: Option<u32>,
+    kind: EntryKind,
+}
+
+pub struct ExtractStats {
+    pub files: usize,
+    pub bytes: u64,
+    pub elapsed: Duration,
+}
+
+impl ExtractStats {
+    pub fn throughput(&self) -> u64 {
+        let secs = self.elapsed.as_secs_f64();
+        if secs > 0.0 {
+            (self.bytes as f64 / secs) as u64
+        } else {
+            self.bytes
+        }
+    }
+}
+
+/// A module zip whose central directory has been read and checked once.
+pub struct ModuleZip {
+    file: Arc<File>,
+    archive: ZipArchive<SharedFile>,
+    entries: Vec<Entry>,
+}
+
+impl ModuleZip {
+    pub fn open(path: impl AsRef<Path>) -> Result<Self> {
+        let path = path.as_ref();
+        let file = File::open(path).with_context(|| format!("open {}", path.display()))?;
+        let len = file.metadata()?.len();
+        let file = Arc::new(file);
+        let mut archive = ZipArchive::new(SharedFile {
+            file: file.clone(),
+            pos: 0,
+            len,
+        })
+        .with_context(|| format!("invalid zip {}", path.display()))?;
+
+        let mut entries = Vec::with_capacity(archive.len());
+        for index in 0..archive.len() {
+            let entry = archive.by_index_raw(index)?;
+            let Some(name) = entry.enclosed_name() else {
+                bail!("unsafe path in zip: {}", entry.name());
+            };
+            let kind = if entry.is_dir() {
+                EntryKind::Dir
+            } else if entry.is_symlink() {
+                EntryKind::Symlink
+            } else if entry.compression() == CompressionMethod::Stored
+                && entry.compressed_size() == entry.size()
+            {
+                EntryKind::Stored {
+                    data_start: entry.data_start(),
+                    crc32: entry.crc32(),
+                }
+            } else {
+                EntryKind::File
+            };
+            if let EntryKind::Stored { data_start, .. } = kind {
+                if data_start
+                    .checked_add(entry.size())
+                    .is_none_or(|end| end > len)
+                {
+                    bail!("truncated zip entry: {}", entry.name());
+                }
+            }
+            entries.push(Entry {
+                index,
+                path: name,
+                size: entry.size(),
+                mode: entry.unix_mode(),
+                kind,
+            });
+        }
+
+        Ok(Self {
+            file,
+            archive,
+            entries,
+        })
+    }
+
+    pub fn uncompressed_size(&self) -> u64 {
+        self.entries.iter().map(|e| e.size).sum()
+    }
+
+    pub fn read_file(&mut self, name: &str) -> Result<Vec<u8>> {
+        let mut entry = self
+            .archive
+            .by_name(name)
+            .with_context(|| format!("{name} not found in zip"))?;
+        let mut buffer = Vec::with_capacity(entry.size() as usize);
+        entry.read_to_end(&mut buffer)?;
+        Ok(buffer)
+    }
+
+    /// Extract every entry below `dest`, largest files first across all
+    /// cores. Deflated entries are CRC-checked by the zip reader, stored
+    /// ones are copied in the kernel and then checked against the archive
+    /// range, which the copy has just pulled into the page cache.
+    pub fn extract(&self, dest: &Path) -> Result<ExtractStats> {
+        let start = Instant::now();
+
+        // directories first, so workers never race on creating parents
+        create_dir_all(dest)?;
+        for entry in &self.entries {
+            let target = dest.join(&entry.path);
+            match entry.kind {
+                EntryKind::Dir => create_dir_all(&target)?,
+                _ => {
+                    if let Some(parent) = target.parent() {
+                        create_dir_all(parent)?;
+                    }
+                }
+            }
+        }
+
+        let mut pending: Vec<&Entry> = self
+            .entries
+            .iter()
+            .filter(|e| !matches!(e.kind, EntryKind::Dir))
+            .collect();
+        pending.sort_unstable_by_key(|e| std::cmp::Reverse(e.size));
+
+        if !pending.is_empty() {
+            let workers = std::thread::available_parallelism()
+                .map_or(4, NonZeroUsize::get)
+                .min(pending.len());
+            let next = AtomicUsize::new(0);
+            let failed = AtomicBool::new(false);
+            let error = Mutex::new(None);
+            std::thread::scope(|scope| {
+                for _ in 0..workers {
+                    scope.spawn(|| {
+                        let mut archive = self.archive.clone();
+                        while !failed.load(Ordering::Relaxed) {
+                            let i = next.fetch_add(1, Ordering::Relaxed);
+                            let Some(entry) = pending.get(i) else {
+                                break;
+                            };
+                            if let Err(e) = self.extract_entry(&mut archive, entry, dest) {
+                                failed.store(true, Ordering::Relaxed);
+                                let mut error = error.lock().unwrap();
+                                if error.is_none() {
+                                    *error = Some(
+                                        e.context(format!("extract {}", entry.path.display())),
+                                    );
+                                }
+                            }
+                        }
+                    });
+                }
+            });
+            if let Some(e) = error.into_inner().unwrap() {
+                return Err(e);
+            }
+        }
+
+        // apply directory modes last, a read-only dir would block its children
+        for entry in &self.entries {
+            if let (EntryKind::Dir, Some(mode)) = (&entry.kind, entry.mode) {
+                set_permissions(
+                    dest.join(&entry.path),
+                    Permissions::from_mode(mode & 0o7777),
+                )?;
+            }
+        }
+
+        Ok(ExtractStats {
+            files: pending.len(),
+            bytes: self.uncompressed_size(),
+            elapsed: start.elapsed(),
+        })
+    }
+
+    fn extract_entry(
+        &self,
+        archive: &mut ZipArchive<SharedFile>,
+        entry: &Entry,
+        dest: &Path,
+    ) -> Result<()> {
+        let target = dest.join(&entry.path);
+
+        if let EntryKind::Symlink = entry.kind {
+            let mut link = String::new();
+            archive.by_index(entry.index)?.read_to_string(&mut link)?;
+            symlink(link, &target)?;
+            return Ok(());
+        }
+
+        let mut out = File::create(&target)?;
+        if entry.size > 0 {
+            // best effort, not every filesystem supports it
+            let _ = fallocate(&out, FallocateFlags::empty(), 0, entry.size);
+        }
+
+        match entry.kind {
+            EntryKind::Stored { data_start, crc32 } => {
+                copy_range(&self.file, data_start, &out, entry.size)?;
+                let actual = crc32_range(&self.file, data_start, entry.size)?;
+                if actual != crc32 {
+                    bail!("crc32 mismatch: {actual:08x} != {crc32:08x}");
+                }
+            }
+            _ => {
+                let mut reader = archive.by_index(entry.index)?;
+                let copied = io::copy(&mut reader, &mut out)?;
+                if copied != entry.size {
+                    bail!("size mismatch: {copied} != {}", entry.size);
+                }
+            }
+        }
+
+        if let Some(mode) = entry.mode {
+            set_permissions(&target, Permissions::from_mode(mode & 0o7777))?;
+        }
+        Ok(())
+    }
+}
+
+fn copy_range(src: &File, offset: u64, dst: &File, len: u64) -> Result<()> {
+    let mut off_in = offset;
+    let mut off_out = 0;
+    while off_out < len {
+        let chunk = (len - off_out).min(1 << 30) as usize;
+        match copy_file_range(src, Some(&mut off_in), dst, Some(&mut off_out), chunk) {
+            Ok(0) => bail!("unexpected end of zip"),
+            Ok(_) => {}
+            // cross-filesystem before 5.3, or unsupported by the filesystem
+            Err(Errno::XDEV | Errno::NOSYS | Errno::INVAL | Errno::OPNOTSUPP) => {
+                return copy_range_buffered(src, off_in, dst, off_out, len - off_out);
+            }
+            Err(e) => return Err(e.into()),
+        }
+    }
+    Ok(())
+}
+
+fn crc32_range(src: &File, mut offset: u64, mut len: u64) -> Result<u32> {
+    let mut hasher = crc32fast::Hasher::new();
+    let mut buffer = vec![0u8; COPY_CHUNK.min(len as usize)];
+    while len > 0 {
+        let chunk = &mut buffer[..COPY_CHUNK.min(len as usize)];
+        src.read_exact_at(chunk, offset)?;
+        hasher.update(chunk);
+        offset += chunk.len() as u64;
+        len -= chunk.len() as u64;
+    }
+    Ok(hasher.finalize())
+}
+
+fn copy_range_buffered(
+    src: &File,
+    mut off_in: u64,
+    dst: &File,
+    mut off_out: u64,
+    mut len: u64,
+) -> Result<()> {
+    let mut buffer = vec![0u8; COPY_CHUNK.min(len as usize)];
+    while len > 0 {
+        let chunk = &mut buffer[..COPY_CHUNK.min(len as usize)];
+        src.read_exact_at(chunk, off_in)?;
+        dst.write_all_at(chunk, off_out)?;
+        off_in += chunk.len() as u64;
+        off_out += chunk.len() as u64;
+        len -= chunk.len() as u64;
+    }
+    Ok(())
+}
@@ -113,14 +113,6 @@ pub fn is_safe_mode() -> bool {
     safemode
 }
 
-pub fn get_zip_uncompressed_size(zip_path: &str) -> Result<u64> {
-    let mut zip = zip::ZipArchive::new(std::fs::File::open(zip_path)?)?;
-    let total: u64 = (0..zip.len())
-        .map(|i| zip.by_index(i).unwrap().size())
-        .sum();
-    Ok(total)
-}
-
 #[cfg(any(target_os = "linux", target_os = "android"))]
 pub fn switch_mnt_ns(pid: i32) -> Result<()> {
     use rustix::{
@@ -137,6 +129,29 @@ pub fn switch_mnt_ns(pid: i32) -> Result<()> {
     Ok(())
 }
 
+#[cfg(any(target_os = "linux", target_os = "android"))]
+fn mnt_ns_of(pid: &str) -> Result<(u64, u64)> {
+    use std::os::unix::fs::MetadataExt;
+    let metadata = fs::metadata(format!("/proc/{pid}/ns/mnt"))?;
+    Ok((metadata.dev(), metadata.ino()))
+}
+
+/// Enter init's mount namespace, through the kernel's pinned namespace
+/// when it has one, otherwise via procfs. The prctl only queues the setns
+/// for its return to userspace and can't report how that went, so the
+/// result is checked against init and procfs is tried when it differs.
+#[cfg(any(target_os = "linux", target_os = "android"))]
+pub fn switch_global_mnt_ns() -> Result<()> {
+    let current_dir = std::env::current_dir();
+    if !ksucalls::enter_global_mnt_ns() || mnt_ns_of("self")? != mnt_ns_of("1")? {
+        return switch_mnt_ns(1);
+    }
+    if let std::result::Result::Ok(current_dir) = current_dir {
+        let _ = std::env::set_current_dir(current_dir);
+    }
+    Ok(())
+}
+
 fn switch_cgroup(grp: &str, pid: u32) {
     let path = Path::new(grp).join("cgroup.procs");
     if !path.exists() {
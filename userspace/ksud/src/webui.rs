@@ -0,0 +1,139 @@
+use anyhow::{Result, bail, ensure};
+use serde_json::{Value, json};
+use std::{
+    collections::HashMap,
+    fs::File,
+    os::unix::{fs::MetadataExt, io::AsRawFd},
+    path::{Path, PathBuf},
+    sync::Mutex,
+};
+
+use crate::defs;
+
+// resolved requests remembered by the daemon, cleared wholesale when full
+const CACHE_ENTRIES: usize = 1024;
+
+// precompressed siblings, preferred over the plain file in this order
+const VARIANTS: &[(&str, &str)] = &[(".br", "br"), (".gz", "gzip")];
+
+#[derive(Clone)]
+struct Resolved {
+    path: PathBuf,
+    encoding: Option<&'static str>,
+    mtime: (i64, i64),
+}
+
+// module, path and the encodings the request accepts
+type Cache = HashMap<(String, String, Vec<String>), Resolved>;
+
+static CACHE: Mutex<Option<Cache>> = Mutex::new(None);
+
+fn with_cache<T>(f: impl FnOnce(&mut Cache) -> T) -> T {
+    let mut cache = CACHE.lock().unwrap_or_else(|e| e.into_inner());
+    f(cache.get_or_insert_with(HashMap::new))
+}
+
+// (mtime, size) of an opened regular file
+fn stat(file: &File) -> Result<((i64, i64), u64)> {
+    let meta = file.metadata()?;
+    ensure!(meta.is_file(), "not a regular file");
+    Ok(((meta.mtime(), meta.mtime_nsec()), meta.len()))
+}
+
+fn webroot(module: &str) -> Result<PathBuf> {
+    if module.is_empty() || module.contains('/') || module == "." || module == ".." {
+        bail!("invalid module id {module}");
+    }
+    Ok(Path::new(defs::MODULE_DIR)
+        .join(module)
+        .join(defs::MODULE_WEB_DIR)
+        .canonicalize()?)
+}
+
+// `name` opened, if it exists and resolves to somewhere inside the webroot
+fn open_child(root: &Path, name: &str) -> Option<(PathBuf, File)> {
+    let path = root.join(name).canonicalize().ok()?;
+    if !path.starts_with(root) {
+        return None;
+    }
+    let file = File::open(&path).ok()?;
+    Some((path, file))
+}
+
+// where `file` really is, whatever was swapped in since its path was resolved
+fn opened_inside(root: &Path, file: &File) -> bool {
+    std::fs::read_link(format!("/proc/self/fd/{}", file.as_raw_fd()))
+        .is_ok_and(|path| path.starts_with(root))
+}
+
+fn resolve(module: &str, path: &str, accept: &[String]) -> Result<(Resolved, File)> {
+    let root = webroot(module)?;
+    let relative = path.trim_start_matches('/');
+    let precompressed = VARIANTS
+        .iter()
+        .any(|(suffix, _)| relative.ends_with(suffix));
+    if !precompressed {
+        for (suffix, encoding) in VARIANTS {
+            if !accept.iter().any(|a| a == encoding) {
+                continue;
+            }
+            let Some((path, file)) = open_child(&root, &format!("{relative}{suffix}")) else {
+                continue;
+            };
+            if let Ok((mtime, _)) = stat(&file) {
+                let encoding = Some(*encoding);
+                let resolved = Resolved {
+                    path,
+                    encoding,
+                    mtime,
+                };
+                return Ok((resolved, file));
+            }
+        }
+    }
+    let Some((path, file)) = open_child(&root, relative) else {
+        bail!("{relative} not found under the webroot of {module}");
+    };
+    let (mtime, _) = stat(&file)?;
+    let resolved = Resolved {
+        path,
+        encoding: None,
+        mtime,
+    };
+    Ok((resolved, file))
+}
+
+/// Open `path` under the webroot of `module` for the manager's WebUI,
+/// serving a `.br` or `.gz` sibling as-is when there is one and the
+/// request `accept`s its encoding. Lookups are cached and reused for as
+/// long as the resolved file's mtime holds and it is still in the webroot.
+pub fn open(module: &str, path: &str, accept: &[String]) -> Result<(Value, File)> {
+    let mut accept = accept.to_vec();
+    accept.sort_unstable();
+    accept.dedup();
+    let key = (module.to_string(), path.to_string(), accept);
+
+    if let Some(hit) = with_cache(|cache| cache.get(&key).cloned()) {
+        let root = webroot(module)?;
+        if let Ok(file) = File::open(&hit.path) {
+            if let Ok((mtime, size)) = stat(&file) {
+                // a directory on the way may have become a symlink since
+                if mtime == hit.mtime && opened_inside(&root, &file) {
+                    return Ok((json!({ "encoding": hit.encoding, "size": size }), file));
+                }
+            }
+        }
+        with_cache(|cache| cache.remove(&key));
+    }
+
+    let (resolved, file) = resolve(module, path, &key.2)?;
+    let (_, size) = stat(&file)?;
+    let info = json!({ "encoding": resolved.encoding, "size": size });
+    with_cache(|cache| {
+        if cache.len() >= CACHE_ENTRIES {
+            cache.clear();
+        }
+        cache.insert(key, resolved);
+    });
+    Ok((info, file))
+}
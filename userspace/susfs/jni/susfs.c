@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
 
 #define KERNEL_SU_OPTION 0xDEADBEEF
 
@@ -15,6 +17,16 @@
 #define CMD_SUSFS_SHOW_SUS_SU_WORKING_MODE 0x555e4
 #define CMD_SUSFS_IS_SUS_SU_READY 0x555f0
 #define CMD_SUSFS_SUS_SU 0x60000
+#define CMD_SUSFS_ADD_SUS_PATH 0x55550
+#define CMD_SUSFS_ADD_SUS_PATH_LOOP 0x55553
+#define CMD_SUSFS_ADD_SUS_MOUNT 0x55560
+#define CMD_SUSFS_ADD_TRY_UMOUNT 0x55580
+
+#define SUSFS_MAX_LEN_PATHNAME 256
+#define BATCH_MAX_LINE (PATH_MAX + 64)
+// run_batch exit code when the kernel's SuSFS has no known struct layout,
+// callers then apply the entries one by one with the ksu_susfs binary
+#define BATCH_UNSUPPORTED 2
 
 // SUS_SU modes
 #define SUS_SU_DISABLED 0
@@ -24,13 +36,46 @@ struct st_sus_su {
     int mode;
 };
 
+struct st_susfs_sus_path {
+    unsigned long target_ino;
+    char target_pathname[SUSFS_MAX_LEN_PATHNAME];
+    unsigned int i_uid;
+};
+
+struct st_susfs_sus_mount {
+    char target_pathname[SUSFS_MAX_LEN_PATHNAME];
+    unsigned long target_dev;
+};
+
+struct st_susfs_try_umount {
+    char target_pathname[SUSFS_MAX_LEN_PATHNAME];
+    int mnt_mode;
+};
+
+// The kernel copies the structs above verbatim, so a batch may only be sent
+// to SuSFS versions whose layout they were checked against. Versions not
+// listed here get BATCH_UNSUPPORTED.
+enum batch_layout {
+    LAYOUT_UNKNOWN,
+    LAYOUT_V158,
+};
+
+static const struct {
+    const char* version;
+    enum batch_layout layout;
+} batch_layouts[] = {
+    {"v1.5.8", LAYOUT_V158},
+    {"v1.5.9", LAYOUT_V158},
+};
+
 // Function prototypes
 int enable_sus_su(int last_working_mode, int target_working_mode);
 int get_sus_su_working_mode(int* mode);
+int run_batch(FILE* in);
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <support|version|variant|features|sus_su <0|2|mode>>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <support|version|variant|features|sus_su <0|2|mode>|batch [file|-]>\n", argv[0]);
         return 1;
     }
 
@@ -111,6 +156,22 @@ int main(int argc, char* argv[]) {
             fprintf(stderr, "Invalid mode: %d\n", target_working_mode);
             return 1;
         }
+    } else if (argc <= 3 && strcmp(argv[1], "batch") == 0) {
+        FILE* in = stdin;
+        int ret;
+
+        if (argc == 3 && strcmp(argv[2], "-") != 0) {
+            in = fopen(argv[2], "r");
+            if (!in) {
+                perror(argv[2]);
+                return 1;
+            }
+        }
+        ret = run_batch(in);
+        if (in != stdin) {
+            fclose(in);
+        }
+        return ret;
     } else {
         fprintf(stderr, "Invalid argument: %s\n", argv[1]);
         return 1;
@@ -134,4 +195,136 @@ int get_sus_su_working_mode(int* mode) {
     int error = -1;
     prctl(KERNEL_SU_OPTION, CMD_SUSFS_SHOW_SUS_SU_WORKING_MODE, mode, NULL, &error);
     return error;
-}
\ No newline at end of file
+}
+// Batch operations, one per line, with the same names and arguments as the
+// ksu_susfs commands but unquoted:
+//   add_sus_path <path>
+//   add_sus_path_loop <path>
+//   add_sus_mount <path>
+//   add_try_umount <path> <mode>
+// Empty lines and lines starting with '#' are ignored.
+static int batch_sus_path(const char* path, int cmd) {
+    struct st_susfs_sus_path info = {0};
+    struct stat sb;
+    int error = -1;
+
+    if (stat(path, &sb)) {
+        printf("[-] %s not found, skip adding\n", path);
+        return 1;
+    }
+    strncpy(info.target_pathname, path, SUSFS_MAX_LEN_PATHNAME - 1);
+    info.target_ino = sb.st_ino;
+    info.i_uid = sb.st_uid;
+    prctl(KERNEL_SU_OPTION, cmd, &info, NULL, &error);
+    return error;
+}
+
+static int batch_sus_mount(const char* path) {
+    struct st_susfs_sus_mount info = {0};
+    struct stat sb;
+    int error = -1;
+
+    if (stat(path, &sb)) {
+        printf("[-] %s not found, skip adding\n", path);
+        return 1;
+    }
+    strncpy(info.target_pathname, path, SUSFS_MAX_LEN_PATHNAME - 1);
+    info.target_dev = sb.st_dev;
+    prctl(KERNEL_SU_OPTION, CMD_SUSFS_ADD_SUS_MOUNT, &info, NULL, &error);
+    return error;
+}
+
+static int batch_try_umount(char* args) {
+    struct st_susfs_try_umount info = {0};
+    char* mode = strrchr(args, ' ');
+    char* endptr;
+    int error = -1;
+
+    if (!mode) {
+        return -EINVAL;
+    }
+    *mode++ = '\0';
+    info.mnt_mode = strtol(mode, &endptr, 10);
+    if (*endptr != '\0') {
+        return -EINVAL;
+    }
+    strncpy(info.target_pathname, args, SUSFS_MAX_LEN_PATHNAME - 1);
+    prctl(KERNEL_SU_OPTION, CMD_SUSFS_ADD_TRY_UMOUNT, &info, NULL, &error);
+    return error;
+}
+
+static enum batch_layout detect_batch_layout(char* version, size_t size) {
+    int error = -1;
+    size_t i;
+
+    memset(version, 0, size);
+    prctl(KERNEL_SU_OPTION, CMD_SUSFS_SHOW_VERSION, version, NULL, &error);
+    if (error) {
+        return LAYOUT_UNKNOWN;
+    }
+    version[size - 1] = '\0';
+    for (i = 0; i < sizeof(batch_layouts) / sizeof(batch_layouts[0]); i++) {
+        if (strcmp(version, batch_layouts[i].version) == 0) {
+            return batch_layouts[i].layout;
+        }
+    }
+    return LAYOUT_UNKNOWN;
+}
+
+// Apply every operation read from in within this one process, instead of
+// one ksu_susfs process per entry. Returns non-zero if any entry failed, or
+// BATCH_UNSUPPORTED without applying anything on an unknown SuSFS version.
+int run_batch(FILE* in) {
+    char line[BATCH_MAX_LINE];
+    char version[16];
+    int lineno = 0, applied = 0, failed = 0;
+
+    if (detect_batch_layout(version, sizeof(version)) != LAYOUT_V158) {
+        fprintf(stderr, "[-] batch: SuSFS %s has no known layout, apply entries with ksu_susfs\n",
+                version[0] ? version : "(unknown)");
+        return BATCH_UNSUPPORTED;
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        char* op = line;
+        char* args;
+        int error;
+
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (op[0] == '\0' || op[0] == '#') {
+            continue;
+        }
+        args = strchr(op, ' ');
+        if (!args) {
+            fprintf(stderr, "[-] line %d: missing argument\n", lineno);
+            failed++;
+            continue;
+        }
+        *args++ = '\0';
+
+        if (strcmp(op, "add_sus_path") == 0) {
+            error = batch_sus_path(args, CMD_SUSFS_ADD_SUS_PATH);
+        } else if (strcmp(op, "add_sus_path_loop") == 0) {
+            error = batch_sus_path(args, CMD_SUSFS_ADD_SUS_PATH_LOOP);
+        } else if (strcmp(op, "add_sus_mount") == 0) {
+            error = batch_sus_mount(args);
+        } else if (strcmp(op, "add_try_umount") == 0) {
+            error = batch_try_umount(args);
+        } else {
+            fprintf(stderr, "[-] line %d: unknown operation %s\n", lineno, op);
+            failed++;
+            continue;
+        }
+
+        if (error) {
+            fprintf(stderr, "[-] line %d: %s %s failed: %d\n", lineno, op, args, error);
+            failed++;
+        } else {
+            applied++;
+        }
+    }
+
+    printf("[+] batch: %d applied, %d failed\n", applied, failed);
+    return failed ? 1 : 0;
+}